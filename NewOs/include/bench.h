@@ -0,0 +1,32 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Microbenchmarks timed with the TSC. Each sample times a batch of
+// calls, sized so a sample spans at least BENCH_SAMPLE_CYCLES, with
+// interrupts off; the cost of an empty call is subtracted. Results are
+// cycles per call.
+#define BENCH_SAMPLES       101
+#define BENCH_SAMPLE_CYCLES 20000
+#define BENCH_MAX_BATCH     65536
+
+typedef void (*bench_fn_t)(void);
+
+typedef struct {
+    uint32_t batch;   // Calls per sample
+    uint32_t min;
+    uint32_t median;
+    uint32_t p99;
+} bench_result_t;
+
+bool bench_measure(bench_fn_t fn, bench_result_t* result);
+
+// Built-in benchmarks of the kernel libraries
+uint32_t bench_count(void);
+const char* bench_name(uint32_t index);
+uint32_t bench_bytes(uint32_t index);
+bool bench_run(uint32_t index, bench_result_t* result);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Single-word bit scans. The scans compile to BSF/BSR, which every i386
+// has; POPCNT is used once bitops_init has found it in CPUID, with a
+// SWAR fallback before that or on older CPUs. Scans return 32 when no
+// bit is set.
+
+extern bool bitops_popcnt;
+
+void bitops_init(void);
+
+static inline uint32_t bit_popcount_soft(uint32_t value) {
+    value = value - ((value >> 1) & 0x55555555);
+    value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+    value = (value + (value >> 4)) & 0x0F0F0F0F;
+    return (value * 0x01010101) >> 24;
+}
+
+static inline uint32_t bit_popcount(uint32_t value) {
+    if (bitops_popcnt) {
+        uint32_t count;
+        __asm__("popcntl %1, %0" : "=r"(count) : "rm"(value) : "cc");
+        return count;
+    }
+    return bit_popcount_soft(value);
+}
+
+// Index of the lowest set bit
+static inline uint32_t bit_first_set(uint32_t value) {
+    return value != 0 ? (uint32_t)__builtin_ctz(value) : 32;
+}
+
+// Index of the highest set bit
+static inline uint32_t bit_last_set(uint32_t value) {
+    return value != 0 ? 31u - __builtin_clz(value) : 32;
+}
+
+static inline uint32_t bit_first_zero(uint32_t value) {
+    return bit_first_set(~value);
+}
+
+// Multi-word bitmaps of 32-bit words, bit n lives in word n / 32. Bits
+// past the size in the last word are ignored by the scans. Searches
+// return the bitmap size when nothing matches.
+#define BITMAP_WORDS(bits) (((bits) + 31) / 32)
+
+static inline void bitmap_set(uint32_t* map, uint32_t bit) {
+    map[bit >> 5] |= 1u << (bit & 31);
+}
+
+static inline void bitmap_clear(uint32_t* map, uint32_t bit) {
+    map[bit >> 5] &= ~(1u << (bit & 31));
+}
+
+static inline bool bitmap_test(const uint32_t* map, uint32_t bit) {
+    return (map[bit >> 5] & (1u << (bit & 31))) != 0;
+}
+
+// Atomic variants for bitmaps shared with interrupt handlers or other
+// CPUs; the test_and_* forms return the previous value of the bit
+static inline void bitmap_set_atomic(uint32_t* map, uint32_t bit) {
+    __asm__ volatile("lock btsl %1, %0" : "+m"(map[bit >> 5]) : "Ir"(bit & 31) : "cc", "memory");
+}
+
+static inline void bitmap_clear_atomic(uint32_t* map, uint32_t bit) {
+    __asm__ volatile("lock btrl %1, %0" : "+m"(map[bit >> 5]) : "Ir"(bit & 31) : "cc", "memory");
+}
+
+static inline bool bitmap_test_and_set_atomic(uint32_t* map, uint32_t bit) {
+    bool old;
+    __asm__ volatile("lock btsl %2, %0" : "+m"(map[bit >> 5]), "=@ccc"(old) : "Ir"(bit & 31) : "memory");
+    return old;
+}
+
+static inline bool bitmap_test_and_clear_atomic(uint32_t* map, uint32_t bit) {
+    bool old;
+    __asm__ volatile("lock btrl %2, %0" : "+m"(map[bit >> 5]), "=@ccc"(old) : "Ir"(bit & 31) : "memory");
+    return old;
+}
+
+void bitmap_set_range(uint32_t* map, uint32_t start, uint32_t count);
+void bitmap_clear_range(uint32_t* map, uint32_t start, uint32_t count);
+uint32_t bitmap_find_next_set(const uint32_t* map, uint32_t bits, uint32_t start);
+uint32_t bitmap_find_next_zero(const uint32_t* map, uint32_t bits, uint32_t start);
+uint32_t bitmap_count(const uint32_t* map, uint32_t bits);
+
+static inline uint32_t bitmap_find_first_set(const uint32_t* map, uint32_t bits) {
+    return bitmap_find_next_set(map, bits, 0);
+}
+
+static inline uint32_t bitmap_find_first_zero(const uint32_t* map, uint32_t bits) {
+    return bitmap_find_next_zero(map, bits, 0);
+}
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// CR0 bits
+#define CR0_MP 0x00000002
+#define CR0_EM 0x00000004
+#define CR0_TS 0x00000008
+#define CR0_WP 0x00010000
+#define CR0_PG 0x80000000
+
+// CR4 bits
+#define CR4_PSE        0x00000010
+#define CR4_OSFXSR     0x00000200
+#define CR4_OSXMMEXCPT 0x00000400
+
+// CPUID leaf 1 feature bits
+#define CPUID_EDX_PSE  0x00000008
+#define CPUID_EDX_TSC  0x00000010
+#define CPUID_EDX_FXSR 0x01000000
+#define CPUID_EDX_SSE  0x02000000
+#define CPUID_EDX_SSE2 0x04000000
+
+// CPUID leaf 1 ECX feature bits
+#define CPUID_ECX_SSE3   0x00000001
+#define CPUID_ECX_SSSE3  0x00000200
+#define CPUID_ECX_SSE4_2 0x00100000
+#define CPUID_ECX_POPCNT 0x00800000
+#define CPUID_ECX_RDRAND 0x40000000
+
+// CPUID leaf 7 EBX feature bits
+#define CPUID_7_EBX_RDSEED 0x00040000
+
+#define EFLAGS_IF 0x00000200
+#define EFLAGS_ID 0x00200000
+
+// Control registers
+static inline uint32_t cpu_read_cr0(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void cpu_write_cr0(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint32_t cpu_read_cr2(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint32_t cpu_read_cr3(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+static inline void cpu_write_cr3(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+static inline uint32_t cpu_read_cr4(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void cpu_write_cr4(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+// CPU identification
+static inline bool cpu_has_cpuid(void) {
+    uint32_t before, after;
+    __asm__ volatile(
+        "pushfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl %2, %1\n\t"
+        "pushl %1\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %1\n\t"
+        "popfl"
+        : "=&r"(before), "=&r"(after)
+        : "i"(EFLAGS_ID));
+    return ((before ^ after) & EFLAGS_ID) != 0;
+}
+
+static inline void cpu_cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(0));
+}
+
+// Check that all of the given CPUID leaf 1 EDX feature bits are set
+static inline bool cpu_has_feature_edx(uint32_t mask) {
+    if (!cpu_has_cpuid()) return false;
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+    return (edx & mask) == mask;
+}
+
+// Check that all of the given CPUID leaf 1 ECX feature bits are set
+static inline bool cpu_has_feature_ecx(uint32_t mask) {
+    if (!cpu_has_cpuid()) return false;
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+    return (ecx & mask) == mask;
+}
+
+// Check that all of the given CPUID leaf 7 EBX feature bits are set
+static inline bool cpu_has_feature_7_ebx(uint32_t mask) {
+    if (!cpu_has_cpuid()) return false;
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 7) return false;
+    cpu_cpuid(7, &eax, &ebx, &ecx, &edx);
+    return (ebx & mask) == mask;
+}
+
+// Time stamp counter
+static inline uint64_t cpu_rdtsc(void) {
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return (uint64_t)high << 32 | low;
+}
+
+// Disable interrupts, returning the previous EFLAGS for cpu_interrupts_restore
+static inline uint32_t cpu_interrupts_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void cpu_interrupts_restore(uint32_t flags) {
+    __asm__ volatile("pushl %0; popfl" : : "rm"(flags) : "memory", "cc");
+}
+
+
+static inline void cpu_interrupts_enable(void) {
+    __asm__ volatile("sti" : : : "memory");
+}
+
+static inline void cpu_interrupts_disable(void) {
+    __asm__ volatile("cli" : : : "memory");
+}
+
+// Enable interrupts and halt until the next one. STI takes effect after
+// the following instruction, so an interrupt pending since a CLI section
+// still wakes the HLT instead of being taken just before it.
+static inline void cpu_idle(void) {
+    __asm__ volatile("sti; hlt" : : : "memory");
+}
+
+// Hardware random numbers. Both can fail transiently when the entropy
+// source is drained, callers should retry a bounded number of times.
+static inline bool cpu_rdrand(uint32_t* value) {
+    uint8_t ok;
+    __asm__ volatile("rdrand %0; setc %1" : "=r"(*value), "=qm"(ok) : : "cc");
+    return ok;
+}
+
+static inline bool cpu_rdseed(uint32_t* value) {
+    uint8_t ok;
+    __asm__ volatile("rdseed %0; setc %1" : "=r"(*value), "=qm"(ok) : : "cc");
+    return ok;
+}
+
+// Allow SSE instructions: FPU present, fxsave/fxrstor and SIMD
+// exceptions enabled
+static inline void cpu_enable_sse(void) {
+    cpu_write_cr0((cpu_read_cr0() & ~CR0_EM) | CR0_MP);
+    cpu_write_cr4(cpu_read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+}
+
+// Whether SSE registers may be used, i.e. cpu_enable_sse has run
+static inline bool cpu_sse_enabled(void) {
+    return (cpu_read_cr4() & CR4_OSFXSR) != 0;
+}
+
+// Task switched flag: while set, the first FPU/SSE instruction raises
+// #NM so the FPU state can be switched lazily
+static inline void cpu_clts(void) {
+    __asm__ volatile("clts");
+}
+
+static inline void cpu_set_ts(void) {
+    cpu_write_cr0(cpu_read_cr0() | CR0_TS);
+}
+
+// FPU state save and restore. The FXSAVE area is 512 bytes and must be
+// 16-byte aligned; the FNSAVE area is 108 bytes.
+static inline void cpu_fxsave(void* area) {
+    __asm__ volatile("fxsave (%0)" : : "r"(area) : "memory");
+}
+
+static inline void cpu_fxrstor(const void* area) {
+    __asm__ volatile("fxrstor (%0)" : : "r"(area) : "memory");
+}
+
+static inline void cpu_fnsave(void* area) {
+    __asm__ volatile("fnsave (%0)" : : "r"(area) : "memory");
+}
+
+static inline void cpu_frstor(const void* area) {
+    __asm__ volatile("frstor (%0)" : : "r"(area) : "memory");
+}
+
+// Reset the FPU, and the SSE control register when SSE is enabled
+static inline void cpu_fpu_reset(bool sse) {
+    uint32_t mxcsr = 0x1F80;  // All exceptions masked, round to nearest
+    __asm__ volatile("fninit");
+    if (sse) __asm__ volatile("ldmxcsr %0" : : "m"(mxcsr));
+}
+
+// Port I/O
+static inline void cpu_outb(uint16_t port, uint8_t value) {
+    __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t cpu_inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+// TLB maintenance
+static inline void cpu_invlpg(uint32_t address) {
+    __asm__ volatile("invlpg (%0)" : : "r"(address) : "memory");
+}
+
+static inline void cpu_flush_tlb(void) {
+    cpu_write_cr3(cpu_read_cr3());
+}
+
+#endif /* CPU_H */
@@ -1,6 +1,18 @@
 #ifndef FS_H
 #define FS_H
 
+#include "kernel.h"
+
 void fs_init(void);
 
-#endif 
\ No newline at end of file
+// In-memory files; file_open and friends are declared in kernel.h
+file_t* file_create(const char* name, file_type_t type);
+bool file_seek(file_t* file, int64_t offset, file_seek_t whence);
+void file_get_info(file_t* file, file_info_t* info);
+bool file_set_permissions(file_t* file, uint32_t permissions);
+bool file_delete(const char* path);
+
+directory_t* directory_create(const char* name, directory_t* parent);
+void directory_list(directory_t* dir, directory_entry_t* entries, int* count);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Open-addressing hash map with linear probing over caller-provided
+// storage. Keys are opaque pointers interpreted by the hash and equals
+// callbacks; integer ids are stored directly in the key pointer. The map
+// never allocates, so size the entry array for the table it indexes:
+// capacity must be a power of two and larger than the entry limit.
+
+typedef uint32_t (*hash_map_hash_t)(const void* key);
+typedef bool (*hash_map_equals_t)(const void* a, const void* b);
+
+typedef struct {
+    const void* key;
+    void* value;
+    uint32_t hash;
+    bool used;
+} hash_map_entry_t;
+
+typedef struct {
+    hash_map_entry_t* entries;
+    uint32_t capacity;
+    uint32_t count;
+    hash_map_hash_t hash;
+    hash_map_equals_t equals;
+} hash_map_t;
+
+// Declare static storage for a map with room for max_entries keys at a
+// load factor of at most one half
+#define HASH_MAP_CAPACITY(max_entries) \
+    ((max_entries) <= 8 ? 16u : 1u << (33 - __builtin_clz((max_entries) - 1)))
+
+void hash_map_init(hash_map_t* map, hash_map_entry_t* entries, uint32_t capacity,
+                   hash_map_hash_t hash, hash_map_equals_t equals);
+void hash_map_clear(hash_map_t* map);
+void* hash_map_get(const hash_map_t* map, const void* key);
+bool hash_map_put(hash_map_t* map, const void* key, void* value);
+void* hash_map_remove(hash_map_t* map, const void* key);
+
+// Ready-made key types
+uint32_t hash_map_hash_id(const void* key);
+bool hash_map_equals_id(const void* a, const void* b);
+uint32_t hash_map_hash_string(const void* key);
+bool hash_map_equals_string(const void* a, const void* b);
+
+#define HASH_MAP_ID(id) ((const void*)(uintptr_t)(id))
+
+#endif
@@ -1,7 +1,28 @@
 #ifndef INTERRUPT_H
 #define INTERRUPT_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+// Nesting depth of exception and system call handlers, maintained by the
+// entry stubs. Handlers run on top of a thread whose FPU/SSE registers
+// may be live, so code that is reachable from them must not touch those
+// registers while the depth is non-zero.
+extern volatile uint32_t interrupt_depth;
+
+static inline bool interrupt_in_handler(void) {
+    return interrupt_depth != 0;
+}
+
+// Device IRQ lines of the 8259 PIC
+#define IRQ_TIMER 0
+
 void interrupt_init(void);
-int interrupt_is_enabled(void);
+void interrupt_enable(void);
+void interrupt_disable(void);
+bool interrupt_is_enabled(void);
+void interrupt_unmask_irq(uint32_t irq);
+void interrupt_mask_irq(uint32_t irq);
+void interrupt_end_of_irq(uint32_t irq);
 
 #endif 
\ No newline at end of file
@@ -29,6 +29,7 @@
 #define MAX_OPEN_FILES 64
 #define MAX_MOUNT_POINTS 16
 #define MAX_DIRECTORY_ENTRIES 256
+#define FILE_LAZY_THRESHOLD (64 * 1024)
 
 // Device management
 #define MAX_DEVICES 32
@@ -43,8 +44,15 @@
 #define MAX_IRQS 16
 #define MAX_ISRS 256
 
+// Shell
+#define MAX_COMMAND_LINE 256
+#define MAX_ARGS 32
+
 // System calls
 #define MAX_SYSCALLS 256
+#define SYSCALL_VECTOR 0x80
+#define SYS_BRK  1
+#define SYS_SBRK 2
 
 // Error codes
 typedef enum {
@@ -86,14 +94,15 @@ typedef enum {
 typedef struct {
     uint32_t tid;
     uint32_t pid;
-    uint32_t stack_ptr;
+    uint32_t stack_ptr;   // Saved stack pointer while switched out
     uint32_t stack_size;
     uint32_t priority;
     bool is_main;
+    void* fpu_state;      // Saved FPU/SSE registers, allocated on first use
 } thread_t;
 
 // Process structure
-typedef struct {
+typedef struct process {
     uint32_t pid;
     char name[MAX_NAME_LENGTH];
     process_state_t state;
@@ -102,13 +111,22 @@ typedef struct {
     uint32_t stack_size;
     uint32_t heap_ptr;
     uint32_t heap_size;
+    uint32_t page_directory;
     uint32_t parent_pid;
     uint32_t exit_code;
-    uint32_t cpu_time;
+    uint32_t cpu_time;        // Milliseconds
+    uint64_t cpu_time_ns;
+    uint64_t scheduled_at;    // time_get_current() when it last got the CPU
+    uint64_t slice_end;       // When its time slice runs out
+    uint64_t wake_at;         // Deadline while PROC_SLEEPING
     uint32_t memory_usage;
+    uint32_t minor_faults;
     void* entry_point;
     uint32_t creation_time;
     thread_t* thread;
+    struct process* run_next;  // Run queue links, valid while PROC_READY
+    struct process* run_prev;
+    struct process* sleep_next;  // Sleep queue link
 } process_t;
 
 // Process statistics structure
@@ -126,12 +144,15 @@ typedef struct {
 // Forward declaration
 typedef struct memory_block memory_block_t;
 
-// Memory block structure
+// Memory block structure. The payload follows the header directly; free
+// blocks also carry a footer pointing back at their header.
 struct memory_block {
-    uint32_t start;
     uint32_t size;
     bool is_free;
+    bool prev_free;
+    uint8_t size_class;
     memory_block_t* next;
+    memory_block_t* prev;
 };
 
 // File types
@@ -202,6 +223,7 @@ typedef struct {
     uint32_t accessed;
     uint32_t position;
     void* data;
+    uint32_t capacity;
     uint32_t access_time;
     uint32_t modification_time;
     uint32_t creation_time;
@@ -310,6 +332,7 @@ typedef struct {
 // Function declarations
 void kernel_init(void);
 void kernel_panic(const char* message);
+void terminal_writestring(const char* data);
 error_t process_create(const char* name, void* entry_point, uint32_t priority);
 error_t process_terminate(uint32_t pid);
 error_t thread_create(uint32_t pid, void* entry_point, uint32_t priority);
@@ -1,6 +1,191 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include "kernel.h"
+#include "multiboot.h"
+
+// Physical frame allocator: blocks of 2^0 .. 2^FRAME_MAX_ORDER frames
+#define FRAME_MAX_ORDER 10
+
+// Physical memory above this limit is not identity-mapped and not managed
+#define FRAME_DIRECT_LIMIT USER_HEAP_START
+
+// Page table entry flags
+#define PAGE_PRESENT       0x001
+#define PAGE_WRITABLE      0x002
+#define PAGE_USER          0x004
+#define PAGE_WRITE_THROUGH 0x008
+#define PAGE_CACHE_DISABLE 0x010
+#define PAGE_ACCESSED      0x020
+#define PAGE_DIRTY         0x040
+#define PAGE_LARGE         0x080
+#define PAGE_GLOBAL        0x100
+#define PAGE_FLAGS_MASK    0xFFF
+
+// Software-defined bit: read-only mapping of a frame shared after fork
+#define PAGE_COW           0x200
+
+// Address range whose mappings are private to each address space
+#define USER_SPACE_START USER_HEAP_START
+#define USER_SPACE_END   USER_HEAP_END
+
+static inline bool paging_is_user_address(uint32_t virt) {
+    return virt >= USER_SPACE_START && virt < USER_SPACE_END;
+}
+
+// PSE large pages, used for the kernel mappings when the CPU has them
+#define PAGE_LARGE_SIZE 0x400000
+#define PAGE_LARGE_MASK (~(PAGE_LARGE_SIZE - 1))
+
+// Range updates touching more pages than this reload CR3 instead of
+// issuing one invlpg per page
+#define PAGE_TLB_FLUSH_THRESHOLD 32
+
+// Page fault error code bits
+#define PAGE_FAULT_PRESENT 0x1
+#define PAGE_FAULT_WRITE   0x2
+#define PAGE_FAULT_USER    0x4
+
+// Address space handed out by vm_reserve. Regions hold every process
+// stack and every file buffer past FILE_LAZY_THRESHOLD, plus a few for
+// the benchmarks.
+#define VM_LAZY_START 0xD0000000
+#define VM_LAZY_END   0xF0000000
+#define MAX_VM_REGIONS (MAX_PROCESSES + MAX_OPEN_FILES + 16)
+
+// Reserved virtual region, backed on first touch
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t flags;
+    uint32_t committed;
+} vm_region_t;
+
+// Lazy allocation statistics
+typedef struct {
+    uint32_t reserved_bytes;
+    uint32_t committed_pages;
+    uint32_t minor_faults;
+} vm_stats_t;
+
+// Allocation tracing: recent events in a ring, live allocations in a
+// table keyed by address, and per-call-site totals
+#define MEMTRACE_RING_SIZE 256
+#define MEMTRACE_MAX_LIVE  1024
+#define MEMTRACE_MAX_SITES 64
+
+// One traced allocation or free
+typedef struct {
+    uint64_t timestamp;    // time_get_current() when recorded
+    void* ptr;
+    void* site;
+    uint32_t size;
+    bool is_free;
+} memtrace_event_t;
+
+// Live memory owned by one call site
+typedef struct {
+    void* site;
+    uint32_t live_bytes;
+    uint32_t live_count;
+    uint32_t total_count;
+    uint32_t oldest_age;   // Milliseconds since the oldest live one
+} memtrace_site_t;
+
+// Usable bytes in a page handed out by memory_alloc_page
+#define MEMORY_PAGE_USABLE (PAGE_SIZE - sizeof(memory_block_t))
+
+// Slab cache limits
+#define MAX_SLAB_CACHES 16
+
+// Slab cache statistics
+typedef struct {
+    uint32_t object_size;
+    uint32_t objects_per_slab;
+    uint32_t total_slabs;
+    uint32_t active_objects;
+    uint32_t total_allocs;
+    uint32_t total_frees;
+} slab_cache_stats_t;
+
+typedef struct slab slab_t;
+
+// Slab cache: fixed-size objects packed into dedicated heap pages
+typedef struct slab_cache {
+    char name[MAX_NAME_LENGTH];
+    uint32_t object_size;
+    uint32_t objects_per_slab;
+    void (*ctor)(void*);
+    slab_t* partial;
+    slab_t* full;
+    slab_t* empty;
+    slab_cache_stats_t stats;
+    bool in_use;
+} slab_cache_t;
+
 void memory_init(void);
+void memory_stats(size_t* total, size_t* used, size_t* free);
+uint32_t memory_fragmentation(void);
+bool memory_protect(void* addr, size_t size, uint32_t flags);
+bool memory_unprotect(void* addr, size_t size);
+void* memory_map(void* addr, size_t size, uint32_t flags);
+bool memory_unmap(void* addr, size_t size);
+
+// Physical frames
+void frame_init(const multiboot_info_t* info);
+uint32_t frame_alloc(uint32_t order);
+void frame_free(uint32_t address, uint32_t order);
+bool frame_is_used(uint32_t address);
+void frame_stats(uint32_t* total, uint32_t* free);
+uint32_t frame_memory_top(void);
+bool frame_share(uint32_t address);
+uint32_t frame_owners(uint32_t address);
+
+// Paging
+void paging_init(void);
+bool paging_map_range(uint32_t virt, uint32_t phys, uint32_t count, uint32_t flags);
+bool paging_unmap_range(uint32_t virt, uint32_t count);
+bool paging_protect_range(uint32_t virt, uint32_t count, uint32_t flags);
+uint32_t paging_get_physical(uint32_t virt);
+uint32_t paging_get_flags(uint32_t virt);
+uint32_t paging_create_directory(void);
+void paging_destroy_directory(uint32_t directory_address);
+void paging_switch_directory(uint32_t directory_address);
+bool paging_sync_kernel(uint32_t address);
+uint32_t paging_clone_directory(uint32_t directory_address);
+bool paging_handle_cow(uint32_t address, uint32_t error_code);
+bool paging_uses_large_pages(void);
+
+// Demand-zero virtual regions
+void* vm_reserve(size_t size, uint32_t flags);
+bool vm_reserve_at(uint32_t start, size_t size, uint32_t flags);
+bool vm_release(void* addr);
+bool vm_is_reserved(const void* addr);
+vm_region_t* vm_find_region(uint32_t address);
+bool vm_handle_fault(uint32_t address, uint32_t error_code);
+bool vm_map_zero_page(uint32_t address, uint32_t flags);
+void vm_get_stats(vm_stats_t* stats);
+
+// Allocation tracing
+void memtrace_enable(bool enable);
+bool memtrace_is_enabled(void);
+void memtrace_reset(void);
+void memtrace_record_alloc(void* ptr, size_t size, void* site);
+void memtrace_record_free(void* ptr);
+uint32_t memtrace_get_sites(memtrace_site_t* sites, uint32_t max);
+uint32_t memtrace_get_events(memtrace_event_t* events, uint32_t max);
+uint32_t memtrace_dropped(void);
+
+// Page-granular allocations, used by the slab layer
+void* memory_alloc_page(void);
+void memory_free_page(void* page);
+
+// Slab caches
+slab_cache_t* slab_cache_create(const char* name, size_t object_size, void (*ctor)(void*));
+void slab_cache_destroy(slab_cache_t* cache);
+void* slab_cache_alloc(slab_cache_t* cache);
+void slab_cache_free(slab_cache_t* cache, void* object);
+uint32_t slab_cache_shrink(slab_cache_t* cache);
+void slab_cache_get_stats(slab_cache_t* cache, slab_cache_stats_t* stats);
 
 #endif
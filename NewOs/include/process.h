@@ -1,7 +1,41 @@
 #ifndef PROCESS_H
 #define PROCESS_H
 
+#include "kernel.h"
+
+// Preemption. The timer only switches away from code running with a zero
+// count. Sections that change state shared between processes raise it,
+// and a preemption that came due meanwhile happens when it drops back.
+extern volatile uint32_t preempt_count;
+extern volatile bool preempt_pending;
+
+void process_preempt(void);
+
+static inline void preempt_disable(void) {
+    preempt_count++;
+    __asm__ volatile("" : : : "memory");
+}
+
+static inline void preempt_enable(void) {
+    __asm__ volatile("" : : : "memory");
+    if (--preempt_count == 0 && preempt_pending) process_preempt();
+}
+
 void process_init(void);
 void process_schedule(void);
+void process_exit(uint32_t exit_code);
+void process_handle_timer(uint64_t now);
+bool process_sleep_until(uint64_t deadline);
+void process_idle(void);
+process_t* process_pick_next(void);
+void process_set_state(process_t* process, process_state_t state);
+void process_set_priority(process_t* process, uint32_t priority);
+process_t* process_get_current(void);
+process_t* process_get_by_pid(uint32_t pid);
+void process_set_current(process_t* process);
+bool process_handle_heap_fault(uint32_t address, uint32_t error_code);
+void process_handle_fpu_fault(void);
+bool process_set_break(process_t* process, uint32_t address);
+error_t process_fork(process_t* parent, uint32_t* child_pid);
 
 #endif 
\ No newline at end of file
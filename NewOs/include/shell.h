@@ -15,6 +15,10 @@ void shell_command_pwd(void);
 void shell_command_echo(void);
 void shell_command_clear(void);
 void shell_command_exit(void);
+void shell_command_memstat(void);
+void shell_command_dmesg(void);
+void shell_command_config(void);
+void shell_command_bench(void);
 
 extern shell_t* current_shell;
 
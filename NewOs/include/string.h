@@ -2,8 +2,22 @@
 #define _STRING_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
+// Slice of a command line produced by the tokenizer
+typedef struct {
+    const char* start;
+    size_t length;
+    bool needs_unescape;    // Contains quotes or escapes to strip
+} string_token_t;
+
+typedef struct {
+    const char* position;
+} string_tokenizer_t;
+
+void string_init(void);
 void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
 void* memset(void* dest, int c, size_t n);
 int memcmp(const void* s1, const void* s2, size_t n);
 char* strcpy(char* dest, const char* src);
@@ -13,7 +27,14 @@ size_t strlen(const char* s);
 char* strcat(char* dest, const char* src);
 char* strncat(char* dest, const char* src, size_t n);
 char* strstr(const char* haystack, const char* needle);
+size_t strspn(const char* s, const char* accept);
+size_t strcspn(const char* s, const char* reject);
 char* strtok(char* str, const char* delim);
+char* strtok_r(char* str, const char* delim, char** saveptr);
+void string_tokenizer_init(string_tokenizer_t* tokenizer, const char* input);
+bool string_tokenizer_next(string_tokenizer_t* tokenizer, string_token_t* token);
+size_t string_token_unescape(const string_token_t* token, char* dest);
+int string_split_args(char* line, char** argv, int max_args);
 char* strrchr(const char* s, int c);
 
 #endif /* _STRING_H */ 
\ No newline at end of file
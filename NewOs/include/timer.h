@@ -0,0 +1,24 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// One-shot scheduler timer on PIT channel 0. Deadlines are
+// time_get_current nanoseconds; the timer only fires when a deadline has
+// been set, there is no periodic tick. The time slice is read from the
+// configuration key TIMER_QUANTUM_KEY, in milliseconds.
+#define TIMER_NEVER              0xFFFFFFFFFFFFFFFFull
+#define TIMER_QUANTUM_KEY        "sched.quantum_ms"
+#define TIMER_DEFAULT_QUANTUM_MS 10
+#define TIMER_MIN_QUANTUM_MS     1
+#define TIMER_MAX_QUANTUM_MS     1000
+
+void timer_init(void);
+bool timer_is_enabled(void);
+uint64_t timer_get_quantum(void);
+void timer_set_deadline(uint64_t deadline);
+bool timer_idle(uint64_t deadline);
+void timer_handle_expiry(void);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef UMALLOC_H
+#define UMALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// User-space allocator on top of the process heap (SYS_BRK/SYS_SBRK).
+// Each process has its own copy of the allocator state, nothing is
+// shared with the kernel heap.
+
+#define UMALLOC_MIN_SHIFT   4
+#define UMALLOC_CLASS_COUNT 9           // 16 bytes to 4 KiB
+#define UMALLOC_CHUNK_SIZE  (16 * 1024) // Heap growth step for small classes
+
+void* sbrk(intptr_t increment);
+int brk(void* address);
+
+void* umalloc(size_t size);
+void ufree(void* ptr);
+void* ucalloc(size_t count, size_t size);
+void* urealloc(void* ptr, size_t size);
+
+#endif
@@ -1,8 +1,208 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Time. time_get_current is a monotonic nanosecond clock, cheap enough
+// for hot paths; time_get_unix is wall-clock seconds.
+typedef struct {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+} date_time_t;
+
+void time_init(void);
+uint64_t time_get_current(void);
+uint32_t time_ns_to_ms(uint64_t ns);
+uint32_t time_get_tsc_khz(void);
+uint32_t time_get_unix(void);
+void time_sleep(uint64_t milliseconds);
+void time_get_date_time(date_time_t* date_time);
+
+// Logging. log_write only stores the format pointer and up to
+// LOG_MAX_ARGS raw 32-bit arguments in a ring, formatting is left to the
+// reader: the serial drain and the dmesg command. Formats take %d %i %u
+// %x %X %p %c %s and %% with an optional 0 flag and width. Since they
+// are formatted later, the format and any %s argument must outlive the
+// record, in practice string literals or static strings.
+#define LOG_RING_SIZE 512  // Records, a power of two
+#define LOG_MAX_ARGS  6
+
+typedef enum {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR
+} log_level_t;
+
+typedef struct {
+    uint64_t timestamp;  // TSC at the write, 0 without the TSC clock
+    uint32_t sequence;   // Index + 1 once the record is complete
+    const char* format;
+    uint8_t level;
+    uint8_t arg_count;
+    uint32_t args[LOG_MAX_ARGS];
+} log_record_t;
+
+// Read position of one consumer of the ring
+typedef struct {
+    uint32_t next;
+    uint32_t lost;  // Records overwritten before they were read
+} log_cursor_t;
+
 void log_init(void);
-void random_init(int seed);
-int time_get_current(void);
+void log_write(log_level_t level, const char* format, ...);
+void log_set_level(log_level_t level);
+void log_cursor_init(log_cursor_t* cursor);
+bool log_read(log_cursor_t* cursor, log_record_t* record);
+size_t log_format(const log_record_t* record, char* buffer, size_t size);
+void log_flush_serial(void);
+void debug_print(const char* format, ...);
+
+// xoshiro128** generator. Not for secrets: the output is predictable once
+// four consecutive values are known. Each CPU owns one state, so callers
+// never contend on it; components that want a reproducible sequence can
+// keep their own random_state_t.
+typedef struct {
+    uint32_t s[4];
+} random_state_t;
+
+void random_seed(random_state_t* state, uint32_t seed);
+uint32_t random_next(random_state_t* state);
+uint32_t random_next_bounded(random_state_t* state, uint32_t bound);
+
+// The current CPU's generator. random_init fills each state word from
+// hardware entropy (RDSEED, RDRAND or TSC jitter) and mixes seed in. Bounds are inclusive for
+// random_get_range and exclusive for random_get_bounded.
+void random_init(uint32_t seed);
+uint32_t random_get(void);
+uint32_t random_get_bounded(uint32_t bound);
+uint32_t random_get_range(uint32_t min, uint32_t max);
+
+// Checksums, *_update continues from a previous result (0 to start)
+uint32_t crc32(const void* data, size_t size);
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size);
+uint32_t crc32c(const void* data, size_t size);
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t size);
+uint16_t crc16(const void* data, size_t size);
+uint16_t crc16_update(uint16_t crc, const void* data, size_t size);
+
+// Incremental MurmurHash3 (x86_32) state
+typedef struct {
+    uint32_t hash;
+    uint32_t tail;
+    uint32_t tail_length;
+    uint32_t total_length;
+} murmur3_state_t;
+
+// Hashes
+uint32_t hash_fnv1a(const void* data, size_t size);
+uint32_t hash_fnv1a_update(uint32_t hash, const void* data, size_t size);
+uint32_t hash_murmur3(const void* data, size_t size);
+void hash_murmur3_init(murmur3_state_t* state, uint32_t seed);
+void hash_murmur3_update(murmur3_state_t* state, const void* data, size_t size);
+uint32_t hash_murmur3_final(const murmur3_state_t* state);
+
+// Base64 and hex codecs. Encoders NUL-terminate their output and return
+// its length. Decoders are strict: no whitespace, padding only at the end
+// and no stray bits in the last character; they return the decoded size
+// or CODEC_ERROR, in which case the output contents are unspecified.
+// codec_set_ssse3(false) forces the scalar loops, to compare the two.
+#define CODEC_ERROR ((size_t)-1)
+#define BASE64_ENCODED_SIZE(size) (((size) + 2) / 3 * 4 + 1)
+#define BASE64_DECODED_SIZE(length) ((length) / 4 * 3)
+
+size_t base64_encode(const void* data, size_t size, char* output);
+size_t base64_decode(const char* input, void* output);
+size_t hex_encode(const void* data, size_t size, char* output);
+size_t hex_decode(const char* input, void* output);
+bool codec_set_ssse3(bool enable);
+
+// Streaming base64: feed chunks of any size to *_update, which writes
+// only complete groups and holds the remainder in the state, then call
+// *_final. An update needs room for BASE64_ENCODED_SIZE(size) or
+// BASE64_DECODED_SIZE(length) + 3 bytes of output.
+typedef struct {
+    uint8_t pending[2];
+    uint32_t pending_length;
+} base64_encoder_t;
+
+typedef struct {
+    char pending[4];
+    uint32_t pending_length;
+    bool finished;  // Padding seen, no more input allowed
+    bool failed;
+} base64_decoder_t;
+
+void base64_encoder_init(base64_encoder_t* encoder);
+size_t base64_encode_update(base64_encoder_t* encoder, const void* data, size_t size, char* output);
+size_t base64_encode_final(base64_encoder_t* encoder, char* output);
+void base64_decoder_init(base64_decoder_t* decoder);
+size_t base64_decode_update(base64_decoder_t* decoder, const char* input, size_t length, void* output);
+bool base64_decode_final(const base64_decoder_t* decoder);
+
+// Configuration store of typed values under string keys. Hot paths can
+// keep the entry returned by config_intern, whose address never changes,
+// and read it with config_entry_int/config_entry_bool instead of looking
+// the key up each time. Missing keys and type mismatches read as the
+// fallback.
+#define CONFIG_MAX_ENTRIES 64
+#define CONFIG_MAX_KEY     31  // Characters, excluding the terminator
+#define CONFIG_MAX_STRING  63
+
+typedef enum {
+    CONFIG_NONE,
+    CONFIG_STRING,
+    CONFIG_INT,
+    CONFIG_BOOL
+} config_type_t;
+
+typedef struct {
+    char key[CONFIG_MAX_KEY + 1];
+    config_type_t type;
+    union {
+        int32_t number;
+        bool flag;
+        char string[CONFIG_MAX_STRING + 1];
+    } value;
+} config_entry_t;
+
+config_entry_t* config_intern(const char* key);
+const config_entry_t* config_get_entry(uint32_t index);
+const char* config_get_string(const char* key);
+int config_get_int(const char* key);
+bool config_get_bool(const char* key);
+bool config_set_string(const char* key, const char* value);
+bool config_set_int(const char* key, int value);
+bool config_set_bool(const char* key, bool value);
+
+// Binary snapshots; loading merges into the current values
+size_t config_save_buffer(void* buffer, size_t size);
+bool config_load_buffer(const void* buffer, size_t size);
+bool config_load(const char* filename);
+bool config_save(const char* filename);
+
+static inline int config_entry_int(const config_entry_t* entry, int fallback) {
+    return entry != NULL && entry->type == CONFIG_INT ? entry->value.number : fallback;
+}
+
+static inline bool config_entry_bool(const config_entry_t* entry, bool fallback) {
+    return entry != NULL && entry->type == CONFIG_BOOL ? entry->value.flag : fallback;
+}
+
+// MurmurHash3 finalizer, a good standalone mix for integer keys
+static inline uint32_t hash_mix32(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35;
+    hash ^= hash >> 16;
+    return hash;
+}
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,48 @@
+; Multiboot entry point for SimpleOS
+[BITS 32]
+
+MULTIBOOT_MAGIC     equ 0x1BADB002
+MULTIBOOT_ALIGN     equ 1 << 0          ; Align modules on page boundaries
+MULTIBOOT_MEMINFO   equ 1 << 1          ; Ask for the memory map
+MULTIBOOT_AOUT      equ 1 << 16         ; Load addresses are in the header
+MULTIBOOT_FLAGS     equ MULTIBOOT_ALIGN | MULTIBOOT_MEMINFO | MULTIBOOT_AOUT
+MULTIBOOT_CHECKSUM  equ -(MULTIBOOT_MAGIC + MULTIBOOT_FLAGS)
+
+STACK_SIZE          equ 16384
+
+extern kernel_main
+extern kernel_start
+extern kernel_data_end
+extern kernel_end
+
+global _start
+
+section .multiboot
+    jmp _start                  ; Entry when loaded by boot.asm
+align 4
+multiboot_header:
+    dd MULTIBOOT_MAGIC
+    dd MULTIBOOT_FLAGS
+    dd MULTIBOOT_CHECKSUM
+    dd multiboot_header         ; header_addr
+    dd kernel_start             ; load_addr
+    dd kernel_data_end          ; load_end_addr
+    dd kernel_end               ; bss_end_addr
+    dd _start                   ; entry_addr
+
+section .text
+_start:
+    cli
+    mov esp, stack_top
+    push ebx                    ; multiboot_info_t*
+    push eax                    ; Loader magic
+    call kernel_main
+.hang:
+    hlt
+    jmp .hang
+
+section .bss
+align 16
+stack_bottom:
+    resb STACK_SIZE
+stack_top:
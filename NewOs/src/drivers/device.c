@@ -1,14 +1,24 @@
 #include "../../include/device.h"
 #include "../../include/kernel.h"
+#include "../../include/memory.h"
+#include <hashmap.h>
 #include <string.h>
 
 // Device driver structures
 static device_t* device_table[MAX_DEVICES];
 static uint32_t next_device_id = 1;
+static slab_cache_t* device_cache = NULL;
+
+// Name index, keys point at device->name
+static hash_map_entry_t device_name_entries[HASH_MAP_CAPACITY(MAX_DEVICES)];
+static hash_map_t device_names;
 
 // Initialize device system
 void device_init(void) {
     memset(device_table, 0, sizeof(device_table));
+    hash_map_init(&device_names, device_name_entries, HASH_MAP_CAPACITY(MAX_DEVICES),
+                  hash_map_hash_string, hash_map_equals_string);
+    device_cache = slab_cache_create("device", sizeof(device_t), NULL);
 }
 
 // Register a device
@@ -24,7 +34,7 @@ device_t* device_register(const char* name, device_type_t type, void* driver_dat
     if (slot == -1) return NULL;
 
     // Allocate and initialize device
-    device_t* device = (device_t*)memory_alloc(sizeof(device_t));
+    device_t* device = (device_t*)slab_cache_alloc(device_cache);
     if (!device) return NULL;
 
     strncpy(device->name, name, 31);
@@ -38,7 +48,11 @@ device_t* device_register(const char* name, device_type_t type, void* driver_dat
     device->is_initialized = false;
     device->driver_data = driver_data;
 
+    // A duplicate name is only reachable by id, the first device keeps it
     device_table[slot] = device;
+    if (hash_map_get(&device_names, device->name) == NULL) {
+        hash_map_put(&device_names, device->name, device);
+    }
     return device;
 }
 
@@ -49,8 +63,20 @@ error_t device_unregister(uint32_t device_id) {
             if (device_table[i]->open_count > 0) {
                 return ERR_DEVICE_BUSY;
             }
-            memory_free(device_table[i]);
+            device_t* device = device_table[i];
             device_table[i] = NULL;
+
+            // Hand the name over to the next device registered under it
+            if (hash_map_get(&device_names, device->name) == device) {
+                hash_map_remove(&device_names, device->name);
+                for (int j = 0; j < MAX_DEVICES; j++) {
+                    if (device_table[j] != NULL && strcmp(device_table[j]->name, device->name) == 0) {
+                        hash_map_put(&device_names, device_table[j]->name, device_table[j]);
+                        break;
+                    }
+                }
+            }
+            slab_cache_free(device_cache, device);
             return ERR_NONE;
         }
     }
@@ -131,12 +157,8 @@ device_t* device_get_by_id(uint32_t id) {
 
 // Get device by name
 device_t* device_get_by_name(const char* name) {
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if (device_table[i] != NULL && strcmp(device_table[i]->name, name) == 0) {
-            return device_table[i];
-        }
-    }
-    return NULL;
+    if (name == NULL) return NULL;
+    return hash_map_get(&device_names, name);
 }
 
 // List devices
@@ -1,10 +1,14 @@
 #include "../include/kernel.h"
+#include <fs.h>
+#include <memory.h>
 #include <string.h>
+#include <utils.h>
 
 // File system structures
 static file_t* file_table[MAX_OPEN_FILES];
 static directory_t* root_directory = NULL;
 static uint32_t next_fd = 1;
+static slab_cache_t* file_cache = NULL;
 
 // Helper to get file_t* from fd
 static file_t* get_file_by_fd(uint32_t fd) {
@@ -16,9 +20,43 @@ static file_t* get_file_by_fd(uint32_t fd) {
     return NULL;
 }
 
+// Release a file's data buffer
+static void file_free_data(file_t* file) {
+    if (file->data == NULL) return;
+    if (!vm_release(file->data)) {
+        memory_free(file->data);
+    }
+    file->data = NULL;
+    file->capacity = 0;
+}
+
+// Grow a file's data buffer to hold at least needed bytes. Large buffers
+// are reserved lazily, so only the pages actually written get memory.
+static bool file_grow(file_t* file, uint32_t needed) {
+    uint32_t capacity = file->capacity * 2;
+    if (capacity < needed) capacity = needed;
+
+    void* new_data;
+    if (capacity >= FILE_LAZY_THRESHOLD) {
+        new_data = vm_reserve(capacity, PAGE_WRITABLE);
+    } else {
+        new_data = memory_alloc(capacity);
+    }
+    if (new_data == NULL) return false;
+
+    if (file->data) {
+        memcpy(new_data, file->data, file->size);
+        file_free_data(file);
+    }
+    file->data = new_data;
+    file->capacity = capacity;
+    return true;
+}
+
 // Initialize file system
 void fs_init(void) {
     memset(file_table, 0, sizeof(file_table));
+    file_cache = slab_cache_create("file", sizeof(file_t), NULL);
 
     // Create root directory
     root_directory = (directory_t*)memory_alloc(sizeof(directory_t));
@@ -45,7 +83,7 @@ file_t* file_create(const char* name, file_type_t type) {
     if (slot == -1) return NULL; // No free slots
 
     // Allocate file structure
-    file_t* file = (file_t*)memory_alloc(sizeof(file_t));
+    file_t* file = (file_t*)slab_cache_alloc(file_cache);
     if (file == NULL) return NULL;
 
     // Initialize file
@@ -58,10 +96,11 @@ file_t* file_create(const char* name, file_type_t type) {
     file->permissions = 0644; // rw-r--r--
     file->owner = 0; // root
     file->group = 0; // root
-    file->creation_time = 0; // TODO: Implement system time
-    file->modification_time = 0;
-    file->access_time = 0;
+    file->creation_time = time_get_unix();
+    file->modification_time = file->creation_time;
+    file->access_time = file->creation_time;
     file->data = NULL;
+    file->capacity = 0;
 
     // Add to file table
     file_table[slot] = file;
@@ -82,7 +121,7 @@ error_t file_open(const char* path, uint32_t flags) {
     if (slot == -1) return ERR_OUT_OF_MEMORY;
 
     // Allocate and initialize file_t
-    file_t* file = (file_t*)memory_alloc(sizeof(file_t));
+    file_t* file = (file_t*)slab_cache_alloc(file_cache);
     if (!file) return ERR_OUT_OF_MEMORY;
     file->fd = next_fd++;
     strncpy(file->name, path, MAX_FILENAME_LENGTH-1);
@@ -92,14 +131,15 @@ error_t file_open(const char* path, uint32_t flags) {
     file->permissions = flags; // Use flags to set permissions
     file->owner = 0;
     file->group = 0;
-    file->created = 0;
-    file->modified = 0;
-    file->accessed = 0;
+    file->created = time_get_unix();
+    file->modified = file->created;
+    file->accessed = file->created;
     file->position = 0;
     file->data = NULL;
-    file->access_time = 0;
-    file->modification_time = 0;
-    file->creation_time = 0;
+    file->capacity = 0;
+    file->access_time = file->created;
+    file->modification_time = file->created;
+    file->creation_time = file->created;
     file_table[slot] = file;
     return file->fd;
 }
@@ -108,7 +148,8 @@ error_t file_open(const char* path, uint32_t flags) {
 error_t file_close(uint32_t fd) {
     for (int i = 0; i < MAX_OPEN_FILES; i++) {
         if (file_table[i] && file_table[i]->fd == (int)fd) {
-            memory_free(file_table[i]);
+            file_free_data(file_table[i]);
+            slab_cache_free(file_cache, file_table[i]);
             file_table[i] = NULL;
             return ERR_NONE;
         }
@@ -129,7 +170,7 @@ error_t file_read(uint32_t fd, void* buffer, size_t size) {
         memcpy(buffer, (char*)file->data + file->position, to_read);
     }
     file->position += to_read;
-    file->access_time = 0; // TODO: Update access time
+    file->access_time = time_get_unix();
     return to_read;
 }
 
@@ -137,19 +178,16 @@ error_t file_read(uint32_t fd, void* buffer, size_t size) {
 error_t file_write(uint32_t fd, const void* buffer, size_t size) {
     file_t* file = get_file_by_fd(fd);
     if (!file || !buffer) return ERR_INVALID_ARGUMENT;
-    if (!file->data || file->position + size > file->size) {
-        void* new_data = memory_alloc(file->position + size);
-        if (file->data) {
-            memcpy(new_data, file->data, file->size);
-            memory_free(file->data);
-        }
-        file->data = new_data;
-        file->size = file->position + size;
+    if (!file->data || file->position + size > file->capacity) {
+        if (!file_grow(file, file->position + size)) return ERR_OUT_OF_MEMORY;
     }
     memcpy((char*)file->data + file->position, buffer, size);
     file->position += size;
-    file->modification_time = 0; // TODO: Update modification time
-    file->access_time = 0; // TODO: Update access time
+    if (file->position > file->size) {
+        file->size = file->position;
+    }
+    file->modification_time = time_get_unix();
+    file->access_time = file->modification_time;
     return size;
 }
 
@@ -209,10 +247,8 @@ bool file_delete(const char* path) {
     // For now, just search by name
     for (int i = 0; i < MAX_OPEN_FILES; i++) {
         if (file_table[i] != NULL && strcmp(file_table[i]->name, path) == 0) {
-            if (file_table[i]->data != NULL) {
-                memory_free(file_table[i]->data);
-            }
-            memory_free(file_table[i]);
+            file_free_data(file_table[i]);
+            slab_cache_free(file_cache, file_table[i]);
             file_table[i] = NULL;
             return true;
         }
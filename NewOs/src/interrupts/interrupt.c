@@ -1,14 +1,97 @@
 #include "../include/kernel.h"
+#include <cpu.h>
+#include <interrupt.h>
+#include <memory.h>
+#include <process.h>
 #include <string.h>
+#include <timer.h>
 
 // Interrupt handling structures
 static interrupt_handler_t interrupt_handlers[MAX_INTERRUPTS];
 static bool interrupts_enabled = false;
 
+volatile uint32_t interrupt_depth = 0;
+
+// Interrupt descriptor table
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_pointer_t;
+
+#define IDT_INTERRUPT_GATE 0x8E
+#define IDT_USER_INTERRUPT_GATE 0xEE
+
+#define VECTOR_DEVICE_NOT_AVAILABLE 7
+#define VECTOR_PAGE_FAULT 14
+
+// The 8259 PICs are remapped past the CPU exceptions, IRQ n arrives on
+// vector IRQ_VECTOR_BASE + n. All lines start masked.
+#define PIC_MASTER_COMMAND 0x20
+#define PIC_MASTER_DATA    0x21
+#define PIC_SLAVE_COMMAND  0xA0
+#define PIC_SLAVE_DATA     0xA1
+#define PIC_EOI            0x20
+#define IRQ_VECTOR_BASE    0x20
+#define IRQ_SPURIOUS       7
+
+static idt_entry_t idt[MAX_ISRS];
+
+// System call table, handlers take up to three register arguments
+typedef uint32_t (*syscall_handler_t)(uint32_t arg1, uint32_t arg2, uint32_t arg3);
+static syscall_t syscall_table[MAX_SYSCALLS];
+
+// Exception entry stubs, from isr.asm
+extern void isr_device_not_available(void);
+extern void isr_page_fault(void);
+extern void isr_syscall(void);
+extern void isr_timer(void);
+extern void isr_spurious(void);
+
+// Forward declarations
+bool interrupt_set_vector(uint32_t interrupt_number, void* handler);
+static void idt_set_gate(uint32_t interrupt_number, void* handler, uint8_t type_attr);
+
+// Remap both PICs to IRQ_VECTOR_BASE and mask every line
+static void pic_init(void) {
+    cpu_outb(PIC_MASTER_COMMAND, 0x11);            // ICW1: init, ICW4 follows
+    cpu_outb(PIC_SLAVE_COMMAND, 0x11);
+    cpu_outb(PIC_MASTER_DATA, IRQ_VECTOR_BASE);    // ICW2: vector base
+    cpu_outb(PIC_SLAVE_DATA, IRQ_VECTOR_BASE + 8);
+    cpu_outb(PIC_MASTER_DATA, 0x04);               // ICW3: slave on IRQ2
+    cpu_outb(PIC_SLAVE_DATA, 0x02);
+    cpu_outb(PIC_MASTER_DATA, 0x01);               // ICW4: 8086 mode
+    cpu_outb(PIC_SLAVE_DATA, 0x01);
+    cpu_outb(PIC_MASTER_DATA, 0xFF);
+    cpu_outb(PIC_SLAVE_DATA, 0xFF);
+}
+
 // Initialize interrupt system
 void interrupt_init(void) {
     memset(interrupt_handlers, 0, sizeof(interrupt_handlers));
+    memset(idt, 0, sizeof(idt));
+    memset(syscall_table, 0, sizeof(syscall_table));
     interrupts_enabled = false;
+
+    interrupt_set_vector(VECTOR_DEVICE_NOT_AVAILABLE, isr_device_not_available);
+    interrupt_set_vector(VECTOR_PAGE_FAULT, isr_page_fault);
+    idt_set_gate(SYSCALL_VECTOR, isr_syscall, IDT_USER_INTERRUPT_GATE);
+
+    // A masked line can still raise a spurious IRQ 7, which must not be
+    // acknowledged
+    pic_init();
+    interrupt_set_vector(IRQ_VECTOR_BASE + IRQ_TIMER, isr_timer);
+    interrupt_set_vector(IRQ_VECTOR_BASE + IRQ_SPURIOUS, isr_spurious);
+
+    idt_pointer_t pointer = { sizeof(idt) - 1, (uint32_t)idt };
+    __asm__ volatile("lidt %0" : : "m"(pointer));
 }
 
 // Register an interrupt handler
@@ -30,16 +113,43 @@ void interrupt_unregister(uint32_t interrupt_number) {
 
 // Enable interrupts
 void interrupt_enable(void) {
-    // TODO: Implement architecture-specific interrupt enable
     interrupts_enabled = true;
+    cpu_interrupts_enable();
 }
 
 // Disable interrupts
 void interrupt_disable(void) {
-    // TODO: Implement architecture-specific interrupt disable
+    cpu_interrupts_disable();
     interrupts_enabled = false;
 }
 
+// Let a device IRQ line through the PIC
+void interrupt_unmask_irq(uint32_t irq) {
+    if (irq >= 16) return;
+
+    uint16_t port = irq < 8 ? PIC_MASTER_DATA : PIC_SLAVE_DATA;
+    cpu_outb(port, cpu_inb(port) & ~(1 << (irq & 7)));
+    if (irq >= 8) {
+        cpu_outb(PIC_MASTER_DATA, cpu_inb(PIC_MASTER_DATA) & ~(1 << 2));
+    }
+}
+
+void interrupt_mask_irq(uint32_t irq) {
+    if (irq >= 16) return;
+
+    uint16_t port = irq < 8 ? PIC_MASTER_DATA : PIC_SLAVE_DATA;
+    cpu_outb(port, cpu_inb(port) | (1 << (irq & 7)));
+}
+
+// Acknowledge an IRQ. Handlers that may switch processes must do this
+// first, the switch can keep them from returning for a while.
+void interrupt_end_of_irq(uint32_t irq) {
+    if (irq >= 8) {
+        cpu_outb(PIC_SLAVE_COMMAND, PIC_EOI);
+    }
+    cpu_outb(PIC_MASTER_COMMAND, PIC_EOI);
+}
+
 // Check if interrupts are enabled
 bool interrupt_is_enabled(void) {
     return interrupts_enabled;
@@ -119,21 +229,34 @@ bool interrupt_trigger(uint32_t interrupt_number) {
 
 // Get interrupt vector
 void* interrupt_get_vector(uint32_t interrupt_number) {
-    if (interrupt_number >= MAX_INTERRUPTS) {
+    if (interrupt_number >= MAX_ISRS) {
         return NULL;
     }
 
-    // TODO: Implement architecture-specific vector getting
-    return NULL;
+    idt_entry_t* entry = &idt[interrupt_number];
+    return (void*)(entry->offset_low | ((uint32_t)entry->offset_high << 16));
 }
 
-// Set interrupt vector
+// Fill an IDT entry with a gate into the kernel code segment
+static void idt_set_gate(uint32_t interrupt_number, void* handler, uint8_t type_attr) {
+    uint16_t code_selector;
+    __asm__ volatile("mov %%cs, %0" : "=r"(code_selector));
+
+    idt_entry_t* entry = &idt[interrupt_number];
+    entry->offset_low = (uint32_t)handler & 0xFFFF;
+    entry->selector = code_selector;
+    entry->zero = 0;
+    entry->type_attr = type_attr;
+    entry->offset_high = (uint32_t)handler >> 16;
+}
+
+// Set interrupt vector, installs a ring 0 interrupt gate
 bool interrupt_set_vector(uint32_t interrupt_number, void* handler) {
-    if (interrupt_number >= MAX_INTERRUPTS || handler == NULL) {
+    if (interrupt_number >= MAX_ISRS || handler == NULL) {
         return false;
     }
 
-    // TODO: Implement architecture-specific vector setting
+    idt_set_gate(interrupt_number, handler, IDT_INTERRUPT_GATE);
     return true;
 }
 
@@ -167,14 +290,62 @@ void interrupt_restore_context(void* context) {
     // TODO: Implement architecture-specific context restoring
 }
 
-// Handle system call
-void interrupt_handle_syscall(uint32_t syscall_number, void* args) {
-    // TODO: Implement system call handling
+// Register a system call handler
+error_t syscall_register(uint32_t number, void* handler, const char* name) {
+    if (number >= MAX_SYSCALLS || handler == NULL) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    if (syscall_table[number].handler != NULL) {
+        return ERR_DEVICE_BUSY;
+    }
+
+    syscall_table[number].number = number;
+    syscall_table[number].handler = handler;
+    syscall_table[number].name = name;
+    return ERR_NONE;
+}
+
+// Handle system call, args points at the three argument registers.
+// The return value is handed back to the caller in EAX.
+uint32_t interrupt_handle_syscall(uint32_t syscall_number, void* args) {
+    if (syscall_number >= MAX_SYSCALLS || syscall_table[syscall_number].handler == NULL) {
+        return (uint32_t)ERR_INVALID_OPERATION;
+    }
+
+    const uint32_t* arg = (const uint32_t*)args;
+    syscall_handler_t handler = (syscall_handler_t)syscall_table[syscall_number].handler;
+    return handler(arg[0], arg[1], arg[2]);
 }
 
-// Handle page fault
+// Handle page fault: resolve copy-on-write, back demand-zero and heap
+// pages, anything else is fatal
 void interrupt_handle_page_fault(void* fault_address, uint32_t error_code) {
-    // TODO: Implement page fault handling
+    uint32_t address = (uint32_t)fault_address;
+
+    // Kernel page tables added after this address space was created
+    if (paging_sync_kernel(address)) {
+        return;
+    }
+
+    // First write to a page shared by fork
+    if (paging_handle_cow(address, error_code)) {
+        return;
+    }
+
+    if (vm_handle_fault(address, error_code) || process_handle_heap_fault(address, error_code)) {
+        process_t* process = process_get_current();
+        if (process != NULL) {
+            process->minor_faults++;
+        }
+        return;
+    }
+
+    kernel_panic("page fault outside any mapped or reserved region");
+}
+
+// Handle #NM: the current thread used the FPU after a context switch
+void interrupt_handle_device_not_available(void) {
+    process_handle_fpu_fault();
 }
 
 // Handle general protection fault
@@ -189,7 +360,8 @@ void interrupt_handle_double_fault(void) {
 
 // Handle timer interrupt
 void interrupt_handle_timer(void) {
-    // TODO: Implement timer interrupt handling
+    interrupt_end_of_irq(IRQ_TIMER);
+    timer_handle_expiry();
 }
 
 // Handle keyboard interrupt
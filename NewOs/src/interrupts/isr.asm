@@ -0,0 +1,71 @@
+; CPU exception entry stubs
+[BITS 32]
+
+extern interrupt_handle_device_not_available
+extern interrupt_handle_page_fault
+extern interrupt_handle_syscall
+extern interrupt_handle_timer
+
+extern interrupt_depth
+
+global isr_device_not_available
+global isr_page_fault
+global isr_syscall
+global isr_timer
+global isr_spurious
+
+section .text
+
+; Vector 7: FPU or SSE instruction while CR0.TS is set, no error code
+isr_device_not_available:
+    pusha
+    inc dword [interrupt_depth]
+    call interrupt_handle_device_not_available
+    dec dword [interrupt_depth]
+    popa
+    iret
+
+; Vector 14: the CPU pushes an error code, CR2 holds the faulting address
+isr_page_fault:
+    pusha
+    inc dword [interrupt_depth]
+    push dword [esp + 32]       ; Error code
+    mov eax, cr2
+    push eax                    ; Fault address
+    call interrupt_handle_page_fault
+    add esp, 8
+    dec dword [interrupt_depth]
+    popa
+    add esp, 4                  ; Drop the error code
+    iret
+
+; Vector 0x80: EAX holds the call number, EBX/ECX/EDX the arguments
+isr_syscall:
+    pusha
+    inc dword [interrupt_depth]
+    push edx
+    push ecx
+    push ebx
+    mov ecx, esp
+    push ecx                    ; Argument array
+    push eax                    ; Call number
+    call interrupt_handle_syscall
+    add esp, 20
+    dec dword [interrupt_depth]
+    mov [esp + 28], eax         ; Return value replaces the saved EAX
+    popa
+    iret
+
+; IRQ 0: PIT channel 0. The handler may switch processes, the interrupted
+; context resumes here when it is switched back in.
+isr_timer:
+    pusha
+    inc dword [interrupt_depth]
+    call interrupt_handle_timer
+    dec dword [interrupt_depth]
+    popa
+    iret
+
+; IRQ 7 raised by the PIC for a request that went away, no EOI
+isr_spurious:
+    iret
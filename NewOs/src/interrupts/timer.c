@@ -0,0 +1,96 @@
+#include "../include/kernel.h"
+#include <cpu.h>
+#include <interrupt.h>
+#include <process.h>
+#include <timer.h>
+#include <utils.h>
+
+// PIT channel 0 in mode 0 raises IRQ 0 once when the programmed count
+// runs out. The 16-bit counter limits a shot to about 55 ms, a later
+// deadline fires early and the handler arms the timer again.
+#define PIT_CHANNEL0       0x40
+#define PIT_COMMAND        0x43
+#define PIT_ONE_SHOT       0x30        // Channel 0, low then high byte, mode 0
+#define PIT_MAX_COUNT      0xFFFF
+#define PIT_MAX_SHOT_NS    54900000u   // Just under PIT_MAX_COUNT counts
+
+// Conversions without 64-bit division: counts per nanosecond as a 0.32
+// fixed-point fraction, nanoseconds per count as 16.16
+#define PIT_COUNTS_PER_NS  5124677u    // 1193182 / 1e9 * 2^32
+#define PIT_NS_PER_COUNT   54925493u   // 1e9 / 1193182 * 2^16
+
+static bool timer_enabled = false;
+static bool timer_armed = false;
+static uint64_t timer_deadline = 0;    // When the armed shot fires
+static config_entry_t* timer_quantum = NULL;
+
+// Start taking timer interrupts. Deadlines need the TSC clock, without
+// it the timer stays off and the scheduler only switches voluntarily.
+void timer_init(void) {
+    timer_quantum = config_intern(TIMER_QUANTUM_KEY);
+    if (time_get_tsc_khz() == 0) return;
+
+    // The BIOS leaves channel 0 in mode 2 at 18.2 Hz. Switch it to one
+    // shot before unmasking, else that periodic tick keeps firing on top
+    // of the deadlines; the first shot is just the longest one.
+    timer_enabled = true;
+    timer_set_deadline(time_get_current() + PIT_MAX_SHOT_NS);
+    interrupt_unmask_irq(IRQ_TIMER);
+}
+
+bool timer_is_enabled(void) {
+    return timer_enabled;
+}
+
+// Length of a time slice in nanoseconds, read at every slice so a new
+// setting applies right away
+uint64_t timer_get_quantum(void) {
+    int32_t ms = config_entry_int(timer_quantum, TIMER_DEFAULT_QUANTUM_MS);
+    if (ms < TIMER_MIN_QUANTUM_MS) ms = TIMER_MIN_QUANTUM_MS;
+    if (ms > TIMER_MAX_QUANTUM_MS) ms = TIMER_MAX_QUANTUM_MS;
+    return (uint64_t)ms * 1000000;
+}
+
+// Make IRQ 0 fire no later than deadline. A shot already armed for an
+// earlier time is kept, so most calls cost no port writes. Call with
+// interrupts disabled.
+void timer_set_deadline(uint64_t deadline) {
+    if (!timer_enabled || deadline == TIMER_NEVER) return;
+    if (timer_armed && timer_deadline <= deadline) return;
+
+    uint64_t now = time_get_current();
+    uint32_t count = 1;
+    if (deadline > now) {
+        uint64_t delta = deadline - now;
+        if (delta > PIT_MAX_SHOT_NS) {
+            count = PIT_MAX_COUNT;
+        } else {
+            count = ((uint64_t)(uint32_t)delta * PIT_COUNTS_PER_NS) >> 32;
+            if (count == 0) count = 1;
+        }
+    }
+
+    cpu_outb(PIT_COMMAND, PIT_ONE_SHOT);
+    cpu_outb(PIT_CHANNEL0, count & 0xFF);
+    cpu_outb(PIT_CHANNEL0, count >> 8);
+    timer_armed = true;
+    timer_deadline = now + (((uint64_t)count * PIT_NS_PER_COUNT) >> 16);
+}
+
+// Halt until deadline or any other interrupt. Called with interrupts
+// disabled and returns with them disabled again. Fails without the
+// timer, the caller has to spin then.
+bool timer_idle(uint64_t deadline) {
+    if (!timer_enabled) return false;
+
+    timer_set_deadline(deadline);
+    cpu_idle();
+    cpu_interrupts_disable();
+    return true;
+}
+
+// IRQ 0, after the end of interrupt has been sent
+void timer_handle_expiry(void) {
+    timer_armed = false;
+    process_handle_timer(time_get_current());
+}
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <memory.h>
+#include <multiboot.h>
 #include <process.h>
 #include <fs.h>
 #include <device.h>
@@ -11,6 +12,8 @@
 #include <net.h>
 #include <shell.h>
 #include <utils.h>
+#include <bitops.h>
+#include <timer.h>
 
 // VGA text mode colors
 enum vga_color {
@@ -102,11 +105,35 @@ void terminal_writestring(const char* data) {
         terminal_putchar(data[i]);
 }
 
-// Kernel main function
-void kernel_main(void) {
+// Halt the machine after an unrecoverable error
+void kernel_panic(const char* message) {
+    terminal_writestring("KERNEL PANIC: ");
+    terminal_writestring(message);
+    terminal_putchar('\n');
+    while (1) {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
+// Kernel main function, entered from multiboot.asm
+void kernel_main(uint32_t multiboot_magic, multiboot_info_t* multiboot_info) {
+    // Select the string and bit scan routines before anything copies memory
+    string_init();
+    bitops_init();
+
+    // Initialize physical memory from the loader's memory map
+    if (multiboot_magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        multiboot_info = NULL;
+    }
+    frame_init(multiboot_info);
+    paging_init();
+
     // Initialize memory management
     memory_init();
 
+    // Initialize interrupt system early so page faults are handled
+    interrupt_init();
+
     // Initialize process management
     process_init();
 
@@ -116,9 +143,6 @@ void kernel_main(void) {
     // Initialize device system
     device_init();
 
-    // Initialize interrupt system
-    interrupt_init();
-
     // Initialize network system
     network_init();
 
@@ -126,9 +150,14 @@ void kernel_main(void) {
     shell_init();
 
     // Initialize utility functions
+    time_init();
     log_init();
     random_init(time_get_current());
 
+    // Preemption and idle sleep need the calibrated clock
+    timer_init();
+    interrupt_enable();
+
     // Create root shell
     shell_t* root_shell = shell_create("root");
     if (root_shell != NULL) {
@@ -143,6 +172,10 @@ void kernel_main(void) {
     shell_register_command("echo", shell_command_echo, "Display a line of text");
     shell_register_command("clear", shell_command_clear, "Clear the screen");
     shell_register_command("exit", shell_command_exit, "Exit the shell");
+    shell_register_command("memstat", shell_command_memstat, "Show heap usage and traced allocations");
+    shell_register_command("dmesg", shell_command_dmesg, "Show the kernel log");
+    shell_register_command("config", shell_command_config, "Show or change configuration");
+    shell_register_command("bench", shell_command_bench, "Run microbenchmarks");
 
     // Main kernel loop
     while (1) {
@@ -154,9 +187,15 @@ void kernel_main(void) {
             // TODO: Handle pending interrupts
         }
 
+        // Drain deferred log records
+        log_flush_serial();
+
         // Shell input/output
         if (current_shell != NULL) {
             // TODO: Handle shell input/output
         }
+
+        // Nothing to run: halt until the next timer deadline
+        process_idle();
     }
 } 
\ No newline at end of file
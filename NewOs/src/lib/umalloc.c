@@ -0,0 +1,156 @@
+#include "../include/kernel.h"
+#include <umalloc.h>
+
+// Every block starts with a header; the payload follows it. Small blocks
+// come from power-of-two classes carved out of heap chunks, larger ones
+// are taken from the break directly and reused first-fit once freed.
+typedef struct ublock ublock_t;
+struct ublock {
+    uint32_t size;        // Payload size
+    uint32_t size_class;  // Class index, UMALLOC_LARGE for large blocks
+    ublock_t* next;       // Free list link, only valid while free
+    uint32_t reserved;    // Keeps the payload 16-byte aligned
+};
+
+#define UMALLOC_LARGE 0xFFFFFFFF
+#define UMALLOC_MAX_SMALL (1u << (UMALLOC_MIN_SHIFT + UMALLOC_CLASS_COUNT - 1))
+#define UBLOCK_DATA(block) ((void*)((ublock_t*)(block) + 1))
+#define UBLOCK_FROM_PTR(ptr) ((ublock_t*)(ptr) - 1)
+
+static ublock_t* class_free[UMALLOC_CLASS_COUNT];
+static ublock_t* large_free = NULL;
+
+// Unused part of the last chunk taken for small classes
+static uint8_t* chunk_next = NULL;
+static uint8_t* chunk_end = NULL;
+
+static inline uint32_t umalloc_syscall(uint32_t number, uint32_t arg) {
+    uint32_t result;
+    __asm__ volatile("int $0x80" : "=a"(result) : "a"(number), "b"(arg), "c"(0), "d"(0) : "memory");
+    return result;
+}
+
+// Move the break by increment, returns the old break or (void*)-1
+void* sbrk(intptr_t increment) {
+    return (void*)umalloc_syscall(SYS_SBRK, (uint32_t)increment);
+}
+
+// Set the break, returns 0 on success and -1 on failure
+int brk(void* address) {
+    return umalloc_syscall(SYS_BRK, (uint32_t)address) == (uint32_t)address ? 0 : -1;
+}
+
+static inline uint32_t umalloc_class(size_t size) {
+    if (size <= (1u << UMALLOC_MIN_SHIFT)) return 0;
+    return 32 - __builtin_clz(size - 1) - UMALLOC_MIN_SHIFT;
+}
+
+// Carve one block of the given class, growing the heap by a chunk if needed
+static ublock_t* umalloc_carve(uint32_t size_class) {
+    uint32_t block_size = sizeof(ublock_t) + (1u << (size_class + UMALLOC_MIN_SHIFT));
+
+    if (chunk_next == NULL || (uint32_t)(chunk_end - chunk_next) < block_size) {
+        uint8_t* chunk = (uint8_t*)sbrk(UMALLOC_CHUNK_SIZE);
+        if (chunk == (uint8_t*)-1) return NULL;
+
+        // Contiguous with the previous chunk unless someone else moved the break
+        if (chunk != chunk_end) chunk_next = chunk;
+        chunk_end = chunk + UMALLOC_CHUNK_SIZE;
+    }
+
+    ublock_t* block = (ublock_t*)chunk_next;
+    chunk_next += block_size;
+    block->size = 1u << (size_class + UMALLOC_MIN_SHIFT);
+    block->size_class = size_class;
+    return block;
+}
+
+// Take a large block from the free list or from the break
+static ublock_t* umalloc_large(size_t size) {
+    size = (size + 15) & ~15u;
+
+    ublock_t** link = &large_free;
+    while (*link != NULL) {
+        if ((*link)->size >= size) {
+            ublock_t* block = *link;
+            *link = block->next;
+            return block;
+        }
+        link = &(*link)->next;
+    }
+
+    ublock_t* block = (ublock_t*)sbrk(sizeof(ublock_t) + size);
+    if (block == (ublock_t*)-1) return NULL;
+    block->size = size;
+    block->size_class = UMALLOC_LARGE;
+    return block;
+}
+
+// Allocate size bytes, 16-byte aligned
+void* umalloc(size_t size) {
+    if (size == 0 || size > USER_HEAP_END - USER_HEAP_START) return NULL;
+
+    ublock_t* block;
+    if (size <= UMALLOC_MAX_SMALL) {
+        uint32_t size_class = umalloc_class(size);
+        block = class_free[size_class];
+        if (block != NULL) {
+            class_free[size_class] = block->next;
+        } else {
+            block = umalloc_carve(size_class);
+        }
+    } else {
+        block = umalloc_large(size);
+    }
+
+    return block != NULL ? UBLOCK_DATA(block) : NULL;
+}
+
+// Free a block returned by umalloc
+void ufree(void* ptr) {
+    if (ptr == NULL) return;
+
+    ublock_t* block = UBLOCK_FROM_PTR(ptr);
+    if (block->size_class == UMALLOC_LARGE) {
+        block->next = large_free;
+        large_free = block;
+    } else {
+        block->next = class_free[block->size_class];
+        class_free[block->size_class] = block;
+    }
+}
+
+// Allocate zeroed memory for count objects of size bytes
+void* ucalloc(size_t count, size_t size) {
+    if (size != 0 && count > (size_t)-1 / size) return NULL;
+
+    size_t total = count * size;
+    uint8_t* ptr = (uint8_t*)umalloc(total);
+    if (ptr == NULL) return NULL;
+
+    // Pages fresh from the break are already zero, recycled blocks are not
+    for (size_t i = 0; i < total; i++) {
+        ptr[i] = 0;
+    }
+    return ptr;
+}
+
+// Resize a block, keeping it in place when it is already large enough
+void* urealloc(void* ptr, size_t size) {
+    if (ptr == NULL) return umalloc(size);
+    if (size == 0) {
+        ufree(ptr);
+        return NULL;
+    }
+
+    ublock_t* block = UBLOCK_FROM_PTR(ptr);
+    if (size <= block->size) return ptr;
+
+    uint8_t* moved = (uint8_t*)umalloc(size);
+    if (moved == NULL) return NULL;
+    for (uint32_t i = 0; i < block->size; i++) {
+        moved[i] = ((uint8_t*)ptr)[i];
+    }
+    ufree(ptr);
+    return moved;
+}
@@ -0,0 +1,241 @@
+#include "../include/kernel.h"
+#include <bitops.h>
+#include <memory.h>
+#include <multiboot.h>
+#include <string.h>
+
+// Kernel image bounds, from linker.ld
+extern uint8_t kernel_start[];
+extern uint8_t kernel_end[];
+
+// Frames below 1 MiB hold the BIOS data area, VGA memory and option ROMs
+#define FRAME_LOW_MEMORY 0x100000
+
+// Used when the loader gave us no memory information
+#define FRAME_DEFAULT_MEMORY (32 * 1024 * 1024)
+
+#define FRAME_ORDER_NONE 0xFF
+
+// Free-list node, stored in the first frame of each free block
+typedef struct frame_node frame_node_t;
+struct frame_node {
+    frame_node_t* next;
+    frame_node_t* prev;
+};
+
+// Buddy allocator state
+static frame_node_t* free_lists[FRAME_MAX_ORDER + 1];
+static uint32_t* frame_bitmap = NULL;  // One bit per frame, set when in use
+static uint8_t* frame_order = NULL;    // Order of each free block head
+static uint16_t* frame_shares = NULL;  // Extra owners of each shared frame
+static uint32_t frame_count = 0;
+static uint32_t frames_total = 0;
+static uint32_t frames_free = 0;
+
+#define FRAME_ADDRESS(index) ((index) * PAGE_SIZE)
+#define FRAME_NODE(index) ((frame_node_t*)FRAME_ADDRESS(index))
+
+static inline void free_list_push(uint32_t index, uint32_t order) {
+    frame_node_t* node = FRAME_NODE(index);
+    node->prev = NULL;
+    node->next = free_lists[order];
+    if (node->next != NULL) node->next->prev = node;
+    free_lists[order] = node;
+    frame_order[index] = order;
+}
+
+static inline void free_list_remove(uint32_t index, uint32_t order) {
+    frame_node_t* node = FRAME_NODE(index);
+    if (node->prev != NULL) node->prev->next = node->next;
+    else free_lists[order] = node->next;
+    if (node->next != NULL) node->next->prev = node->prev;
+    frame_order[index] = FRAME_ORDER_NONE;
+}
+
+// Return a block to the buddy lists, merging with its buddy while possible
+static void frame_release(uint32_t index, uint32_t order) {
+    bitmap_clear_range(frame_bitmap, index, 1u << order);
+    frames_free += 1u << order;
+
+    while (order < FRAME_MAX_ORDER) {
+        uint32_t buddy = index ^ (1u << order);
+        if (buddy + (1u << order) > frame_count || frame_order[buddy] != order) {
+            break;
+        }
+        free_list_remove(buddy, order);
+        index &= ~(1u << order);
+        order++;
+    }
+
+    free_list_push(index, order);
+}
+
+// Hand a physical range to the allocator in the largest aligned blocks
+static void frame_add_range(uint32_t first, uint32_t last) {
+    while (first < last) {
+        uint32_t order = bit_first_set(first);
+        if (order > FRAME_MAX_ORDER) order = FRAME_MAX_ORDER;
+        while (first + (1u << order) > last) order--;
+
+        frames_total += 1u << order;
+        frame_release(first, order);
+        first += 1u << order;
+    }
+}
+
+// Add the part of [base, base + length) that is not reserved
+static void frame_add_region(uint64_t base, uint64_t length, uint32_t reserved_start, uint32_t reserved_end) {
+    uint64_t end = base + length;
+    if (end > (uint64_t)frame_count * PAGE_SIZE) end = (uint64_t)frame_count * PAGE_SIZE;
+    if (base < FRAME_LOW_MEMORY) base = FRAME_LOW_MEMORY;
+    if (base >= end) return;
+
+    uint32_t first = ((uint32_t)base + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t last = (uint32_t)end / PAGE_SIZE;
+    uint32_t hole_first = reserved_start / PAGE_SIZE;
+    uint32_t hole_last = (reserved_end + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    if (hole_last <= first || hole_first >= last) {
+        frame_add_range(first, last);
+        return;
+    }
+    if (first < hole_first) frame_add_range(first, hole_first);
+    if (hole_last < last) frame_add_range(hole_last, last);
+}
+
+// Initialize the physical frame allocator from the multiboot memory map.
+// Pass NULL when no boot information is available.
+void frame_init(const multiboot_info_t* info) {
+    memset(free_lists, 0, sizeof(free_lists));
+    frames_total = 0;
+    frames_free = 0;
+
+    bool have_map = info != NULL && (info->flags & MULTIBOOT_INFO_MEM_MAP);
+
+    // Find the top of usable memory
+    uint64_t top = 0;
+    if (have_map) {
+        uint32_t offset = 0;
+        while (offset < info->mmap_length) {
+            const multiboot_mmap_entry_t* entry =
+                (const multiboot_mmap_entry_t*)(info->mmap_addr + offset);
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE && entry->addr + entry->len > top) {
+                top = entry->addr + entry->len;
+            }
+            offset += entry->size + sizeof(entry->size);
+        }
+    } else if (info != NULL && (info->flags & MULTIBOOT_INFO_MEMORY)) {
+        top = FRAME_LOW_MEMORY + (uint64_t)info->mem_upper * 1024;
+    } else {
+        top = FRAME_DEFAULT_MEMORY;
+    }
+
+    // Only memory we can reach directly is managed
+    if (top > FRAME_DIRECT_LIMIT) top = FRAME_DIRECT_LIMIT;
+    frame_count = (uint32_t)(top / PAGE_SIZE);
+
+    // Bitmap, share counts and order table go right after the kernel image
+    uint32_t bitmap_bytes = ((frame_count + 31) / 32) * sizeof(uint32_t);
+    uint32_t metadata = ((uint32_t)kernel_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (metadata < FRAME_LOW_MEMORY) metadata = FRAME_LOW_MEMORY;
+    frame_bitmap = (uint32_t*)metadata;
+    frame_shares = (uint16_t*)(metadata + bitmap_bytes);
+    frame_order = (uint8_t*)(frame_shares + frame_count);
+
+    memset(frame_bitmap, 0xFF, bitmap_bytes);
+    memset(frame_shares, 0, frame_count * sizeof(uint16_t));
+    memset(frame_order, FRAME_ORDER_NONE, frame_count);
+
+    uint32_t reserved_start = (uint32_t)kernel_start;
+    uint32_t reserved_end = (uint32_t)frame_order + frame_count;
+
+    if (have_map) {
+        uint32_t offset = 0;
+        while (offset < info->mmap_length) {
+            const multiboot_mmap_entry_t* entry =
+                (const multiboot_mmap_entry_t*)(info->mmap_addr + offset);
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE) {
+                frame_add_region(entry->addr, entry->len, reserved_start, reserved_end);
+            }
+            offset += entry->size + sizeof(entry->size);
+        }
+    } else {
+        frame_add_region(FRAME_LOW_MEMORY, top - FRAME_LOW_MEMORY, reserved_start, reserved_end);
+    }
+}
+
+// Allocate 2^order contiguous frames, returns the physical address or 0
+uint32_t frame_alloc(uint32_t order) {
+    if (order > FRAME_MAX_ORDER) return 0;
+
+    // Smallest non-empty list that fits
+    uint32_t current = order;
+    while (current <= FRAME_MAX_ORDER && free_lists[current] == NULL) {
+        current++;
+    }
+    if (current > FRAME_MAX_ORDER) return 0;
+
+    uint32_t index = (uint32_t)free_lists[current] / PAGE_SIZE;
+    free_list_remove(index, current);
+
+    // Split, keeping the lower half and freeing the upper buddies
+    while (current > order) {
+        current--;
+        free_list_push(index + (1u << current), current);
+    }
+
+    bitmap_set_range(frame_bitmap, index, 1u << order);
+    frames_free -= 1u << order;
+    return FRAME_ADDRESS(index);
+}
+
+// Free 2^order frames previously returned by frame_alloc. A shared
+// frame only loses one owner and stays allocated until the last one.
+void frame_free(uint32_t address, uint32_t order) {
+    if (address == 0 || order > FRAME_MAX_ORDER) return;
+
+    uint32_t index = address / PAGE_SIZE;
+    if (index + (1u << order) > frame_count || (index & ((1u << order) - 1)) != 0) return;
+    if (!frame_is_used(address)) return;
+
+    if (order == 0 && frame_shares[index] > 0) {
+        frame_shares[index]--;
+        return;
+    }
+    frame_release(index, order);
+}
+
+// Add an owner to a single allocated frame, used for copy-on-write
+bool frame_share(uint32_t address) {
+    uint32_t index = address / PAGE_SIZE;
+    if (index >= frame_count || !frame_is_used(address)) return false;
+    if (frame_shares[index] == 0xFFFF) return false;
+
+    frame_shares[index]++;
+    return true;
+}
+
+// Number of owners of an allocated frame
+uint32_t frame_owners(uint32_t address) {
+    uint32_t index = address / PAGE_SIZE;
+    if (index >= frame_count || !frame_is_used(address)) return 0;
+    return frame_shares[index] + 1u;
+}
+
+// Check whether a frame is allocated or unavailable
+bool frame_is_used(uint32_t address) {
+    uint32_t index = address / PAGE_SIZE;
+    if (index >= frame_count) return true;
+    return bitmap_test(frame_bitmap, index);
+}
+
+// Get frame allocator statistics, in frames
+void frame_stats(uint32_t* total, uint32_t* free) {
+    if (total != NULL) *total = frames_total;
+    if (free != NULL) *free = frames_free;
+}
+
+// End of the physical memory covered by the allocator
+uint32_t frame_memory_top(void) {
+    return frame_count * PAGE_SIZE;
+}
@@ -1,100 +1,283 @@
 #include "../include/kernel.h"
+#include <memory.h>
+#include <process.h>
 #include <string.h>
 
 // Memory management structures
 static memory_block_t* kernel_heap_start = (memory_block_t*)KERNEL_HEAP_START;
-static memory_block_t* kernel_heap_end = (memory_block_t*)KERNEL_HEAP_END;
-static memory_block_t* user_heap_start = (memory_block_t*)USER_HEAP_START;
-static memory_block_t* user_heap_end = (memory_block_t*)USER_HEAP_END;
 
-// Initialize memory management
+// Size classes: small requests are served from pages carved into
+// power-of-two objects (16 bytes .. 1 KiB), everything larger goes to the
+// page-granular block list.
+#define SIZE_CLASS_NONE 0
+#define SIZE_CLASS_PAGE 0xFF
+#define SIZE_CLASS_MIN_SHIFT 4
+#define SIZE_CLASS_COUNT 7
+#define SIZE_CLASS_MAX (1 << (SIZE_CLASS_MIN_SHIFT + SIZE_CLASS_COUNT - 1))
+
+// Every block header sits on a page boundary, so the header of any pointer
+// returned by memory_alloc is found by masking off the page offset.
+#define BLOCK_HEADER_SIZE sizeof(memory_block_t)
+#define BLOCK_FROM_PTR(ptr) ((memory_block_t*)((uint32_t)(ptr) & ~(PAGE_SIZE - 1)))
+#define BLOCK_DATA(block) ((uint32_t)(block) + BLOCK_HEADER_SIZE)
+
+// Header of a page owned by a size class, placed right after its block header
+typedef struct size_class_page size_class_page_t;
+struct size_class_page {
+    size_class_page_t* prev;
+    size_class_page_t* next;
+    void* free_list;
+    uint16_t in_use;
+    uint16_t capacity;
+};
+
+#define SIZE_CLASS_PAGE_OBJECTS \
+    ((BLOCK_HEADER_SIZE + sizeof(size_class_page_t) + 15) & ~15)
+
+// Pages with at least one free object, per size class
+static size_class_page_t* partial_pages[SIZE_CLASS_COUNT];
+
+// Free page-granular blocks, in no particular order
+static memory_block_t* free_blocks = NULL;
+
+// Block physically following this one, NULL at the end of the heap
+static inline memory_block_t* block_next(memory_block_t* block) {
+    uint32_t next = BLOCK_DATA(block) + block->size;
+    return next < KERNEL_HEAP_END ? (memory_block_t*)next : NULL;
+}
+
+// Block physically preceding this one, read from its footer
+static inline memory_block_t* block_prev(memory_block_t* block) {
+    return ((memory_block_t**)block)[-1];
+}
+
+static inline void free_list_remove(memory_block_t* block) {
+    if (block->prev != NULL) block->prev->next = block->next;
+    else free_blocks = block->next;
+    if (block->next != NULL) block->next->prev = block->prev;
+    block->next = NULL;
+    block->prev = NULL;
+}
+
+// Mark a block free: write its footer, tell the following block and put it
+// on the free list. The caller has already merged any free neighbours.
+static void heap_release(memory_block_t* block) {
+    block->is_free = true;
+    block->size_class = SIZE_CLASS_NONE;
+    *(memory_block_t**)(BLOCK_DATA(block) + block->size - sizeof(memory_block_t*)) = block;
+
+    memory_block_t* following = block_next(block);
+    if (following != NULL) following->prev_free = true;
+
+    block->prev = NULL;
+    block->next = free_blocks;
+    if (free_blocks != NULL) free_blocks->prev = block;
+    free_blocks = block;
+}
+
+// Allocate a page-granular block from the kernel heap
+static memory_block_t* heap_alloc_block(size_t size) {
+    // Round so that header plus payload covers whole pages
+    size = ((size + BLOCK_HEADER_SIZE + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) - BLOCK_HEADER_SIZE;
+
+    // First fit over the free blocks only
+    memory_block_t* block = free_blocks;
+    while (block != NULL && block->size < size) {
+        block = block->next;
+    }
+    if (block == NULL) return NULL; // Out of memory
+
+    free_list_remove(block);
+    block->is_free = false;
+    block->size_class = SIZE_CLASS_NONE;
+
+    // Split block if the remainder spans at least one page
+    if (block->size >= size + PAGE_SIZE) {
+        memory_block_t* remainder = (memory_block_t*)(BLOCK_DATA(block) + size);
+        remainder->size = block->size - size - BLOCK_HEADER_SIZE;
+        remainder->prev_free = false;
+        block->size = size;
+        heap_release(remainder);
+    } else {
+        memory_block_t* following = block_next(block);
+        if (following != NULL) following->prev_free = false;
+    }
+
+    return block;
+}
+
+// Return a page-granular block to the kernel heap, merging it with free
+// neighbours on both sides in constant time
+static void heap_free_block(memory_block_t* block) {
+    memory_block_t* next = block_next(block);
+    if (next != NULL && next->is_free) {
+        free_list_remove(next);
+        block->size += BLOCK_HEADER_SIZE + next->size;
+    }
+
+    if (block->prev_free) {
+        memory_block_t* prev = block_prev(block);
+        free_list_remove(prev);
+        prev->size += BLOCK_HEADER_SIZE + block->size;
+        block = prev;
+    }
+
+    heap_release(block);
+}
+
+// Initialize memory management, after paging_init has backed the heap
 void memory_init(void) {
     // Initialize kernel heap
-    kernel_heap_start->start = (uint32_t)kernel_heap_start + sizeof(memory_block_t);
-    kernel_heap_start->size = KERNEL_HEAP_END - kernel_heap_start->start;
-    kernel_heap_start->is_free = true;
+    kernel_heap_start->size = KERNEL_HEAP_END - BLOCK_DATA(kernel_heap_start);
+    kernel_heap_start->is_free = false;
+    kernel_heap_start->prev_free = false;
+    kernel_heap_start->size_class = SIZE_CLASS_NONE;
     kernel_heap_start->next = NULL;
+    kernel_heap_start->prev = NULL;
+
+    memset(partial_pages, 0, sizeof(partial_pages));
+    free_blocks = NULL;
+    heap_release(kernel_heap_start);
+}
+
+// Map a request size to its size class index
+static inline uint32_t size_class_index(size_t size) {
+    if (size <= (1 << SIZE_CLASS_MIN_SHIFT)) return 0;
+    return (32 - __builtin_clz((uint32_t)size - 1)) - SIZE_CLASS_MIN_SHIFT;
+}
+
+static inline void size_class_unlink(uint32_t index, size_class_page_t* page) {
+    if (page->prev != NULL) page->prev->next = page->next;
+    else partial_pages[index] = page->next;
+    if (page->next != NULL) page->next->prev = page->prev;
+    page->prev = NULL;
+    page->next = NULL;
+}
 
-    // Initialize user heap
-    user_heap_start->start = (uint32_t)user_heap_start + sizeof(memory_block_t);
-    user_heap_start->size = USER_HEAP_END - user_heap_start->start;
-    user_heap_start->is_free = true;
-    user_heap_start->next = NULL;
+static inline void size_class_link(uint32_t index, size_class_page_t* page) {
+    page->prev = NULL;
+    page->next = partial_pages[index];
+    if (page->next != NULL) page->next->prev = page;
+    partial_pages[index] = page;
+}
+
+// Carve a fresh heap page into objects of one size class
+static size_class_page_t* size_class_grow(uint32_t index) {
+    memory_block_t* block = heap_alloc_block(PAGE_SIZE - BLOCK_HEADER_SIZE);
+    if (block == NULL) return NULL;
+    block->size_class = index + 1;
+
+    uint32_t object_size = 1 << (index + SIZE_CLASS_MIN_SHIFT);
+    size_class_page_t* page = (size_class_page_t*)BLOCK_DATA(block);
+    page->in_use = 0;
+    page->capacity = (PAGE_SIZE - SIZE_CLASS_PAGE_OBJECTS) / object_size;
+    page->free_list = NULL;
+
+    // Thread the free list so the lowest address is handed out first
+    uint8_t* objects = (uint8_t*)block + SIZE_CLASS_PAGE_OBJECTS;
+    for (int i = page->capacity - 1; i >= 0; i--) {
+        void** object = (void**)(objects + i * object_size);
+        *object = page->free_list;
+        page->free_list = object;
+    }
+
+    size_class_link(index, page);
+    return page;
+}
+
+// Allocate one object from a size class
+static void* size_class_alloc(uint32_t index) {
+    size_class_page_t* page = partial_pages[index];
+    if (page == NULL) {
+        page = size_class_grow(index);
+        if (page == NULL) return NULL;
+    }
+
+    void** object = page->free_list;
+    page->free_list = *object;
+    if (++page->in_use == page->capacity) {
+        size_class_unlink(index, page);
+    }
+    return object;
+}
+
+// Return one object to its size class
+static void size_class_free(memory_block_t* block, void* ptr) {
+    uint32_t index = block->size_class - 1;
+    size_class_page_t* page = (size_class_page_t*)BLOCK_DATA(block);
+
+    if (page->in_use == page->capacity) {
+        size_class_link(index, page);
+    }
+
+    *(void**)ptr = page->free_list;
+    page->free_list = ptr;
+
+    // Give empty pages back to the heap, but keep one around per class
+    // so alloc/free ping-pong doesn't thrash the block list.
+    if (--page->in_use == 0 && (page->prev != NULL || page->next != NULL)) {
+        size_class_unlink(index, page);
+        heap_free_block(block);
+    }
 }
 
 // Allocate memory from heap
 void* memory_alloc(size_t size) {
-    // Align size to page boundary
-    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (size == 0) return NULL;
 
-    // Find free block
-    memory_block_t* current = kernel_heap_start;
-    while (current != NULL) {
-        if (current->is_free && current->size >= size) {
-            // Split block if it's too large
-            if (current->size > size + sizeof(memory_block_t) + PAGE_SIZE) {
-                memory_block_t* new_block = (memory_block_t*)(current->start + size);
-                new_block->start = (uint32_t)new_block + sizeof(memory_block_t);
-                new_block->size = current->size - size - sizeof(memory_block_t);
-                new_block->is_free = true;
-                new_block->next = current->next;
-                current->next = new_block;
-                current->size = size;
-            }
-
-            current->is_free = false;
-            return (void*)current->start;
-        }
-        current = current->next;
+    // The heap is shared by every process, none may switch in halfway
+    preempt_disable();
+    void* ptr;
+    if (size <= SIZE_CLASS_MAX) {
+        ptr = size_class_alloc(size_class_index(size));
+    } else {
+        memory_block_t* block = heap_alloc_block(size);
+        ptr = block != NULL ? (void*)BLOCK_DATA(block) : NULL;
     }
 
-    return NULL; // Out of memory
+    memtrace_record_alloc(ptr, size, __builtin_return_address(0));
+    preempt_enable();
+    return ptr;
 }
 
 // Free allocated memory
 void memory_free(void* ptr) {
     if (ptr == NULL) return;
+    if ((uint32_t)ptr < KERNEL_HEAP_START || (uint32_t)ptr >= KERNEL_HEAP_END) return;
 
-    // Find the block
-    memory_block_t* current = kernel_heap_start;
-    while (current != NULL) {
-        if (current->start == (uint32_t)ptr) {
-            current->is_free = true;
-
-            // Merge with adjacent free blocks
-            memory_block_t* prev = NULL;
-            memory_block_t* next = current->next;
-            
-            if (prev != NULL && prev->is_free) {
-                prev->size += current->size + sizeof(memory_block_t);
-                prev->next = next;
-                current = prev;
-            }
-            
-            if (next != NULL && next->is_free) {
-                current->size += next->size + sizeof(memory_block_t);
-                current->next = next->next;
-            }
-            
-            return;
-        }
-        current = current->next;
+    preempt_disable();
+    memtrace_record_free(ptr);
+
+    memory_block_t* block = BLOCK_FROM_PTR(ptr);
+    if (block->size_class == SIZE_CLASS_PAGE) {
+        // Owned by memory_alloc_page, see memory_free_page
+    } else if (block->size_class != SIZE_CLASS_NONE) {
+        size_class_free(block, ptr);
+    } else if ((uint32_t)ptr == BLOCK_DATA(block) && !block->is_free) {
+        heap_free_block(block);
     }
+    preempt_enable();
 }
 
-// Memory copy function
-void* memory_copy(void* dest, const void* src, size_t n) {
-    return memcpy(dest, src, n);
+// Allocate a single page-aligned block of MEMORY_PAGE_USABLE bytes
+void* memory_alloc_page(void) {
+    preempt_disable();
+    memory_block_t* block = heap_alloc_block(MEMORY_PAGE_USABLE);
+    if (block != NULL) block->size_class = SIZE_CLASS_PAGE;
+    preempt_enable();
+    return block != NULL ? (void*)BLOCK_DATA(block) : NULL;
 }
 
-// Memory set function
-void* memory_set(void* dest, int val, size_t n) {
-    return memset(dest, val, n);
-}
+// Free a block obtained from memory_alloc_page
+void memory_free_page(void* page) {
+    if (page == NULL) return;
+    if ((uint32_t)page < KERNEL_HEAP_START || (uint32_t)page >= KERNEL_HEAP_END) return;
 
-// Memory compare function
-int memory_compare(const void* ptr1, const void* ptr2, size_t n) {
-    return memcmp(ptr1, ptr2, n);
+    memory_block_t* block = BLOCK_FROM_PTR(page);
+    if (block->size_class != SIZE_CLASS_PAGE) return;
+    preempt_disable();
+    heap_free_block(block);
+    preempt_enable();
 }
 
 // Get memory statistics
@@ -111,30 +294,86 @@ void memory_stats(size_t* total, size_t* used, size_t* free) {
         } else {
             *used += current->size;
         }
-        current = current->next;
+        current = block_next(current);
+    }
+}
+
+// External fragmentation of the kernel heap, in percent: how much of the
+// free memory lies outside the largest free block
+uint32_t memory_fragmentation(void) {
+    size_t total_free = 0;
+    size_t largest_free = 0;
+
+    for (memory_block_t* block = free_blocks; block != NULL; block = block->next) {
+        total_free += block->size;
+        if (block->size > largest_free) largest_free = block->size;
     }
+
+    // Work in pages so the product stays within 32 bits
+    total_free /= PAGE_SIZE;
+    largest_free /= PAGE_SIZE;
+    if (total_free == 0) return 0;
+    return 100 - (uint32_t)(largest_free * 100 / total_free);
 }
 
 // Memory protection functions
 bool memory_protect(void* addr, size_t size, uint32_t flags) {
-    // TODO: Implement memory protection
-    return true;
+    if (addr == NULL || size == 0) return false;
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    return paging_protect_range((uint32_t)addr, pages, flags);
 }
 
 bool memory_unprotect(void* addr, size_t size) {
-    // TODO: Implement memory unprotection
-    return true;
+    if (addr == NULL || size == 0) return false;
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    return paging_protect_range((uint32_t)addr, pages, PAGE_WRITABLE);
+}
+
+// Check that pages from virt lie in user space. Every frame mapped there
+// came from frame_alloc and belongs to the address space, unlike the
+// identity-mapped RAM and the kernel heap.
+static bool memory_is_user_range(uint32_t virt, uint32_t pages) {
+    if (!paging_is_user_address(virt)) return false;
+    return pages <= (USER_SPACE_END - virt) / PAGE_SIZE;
 }
 
-// Memory mapping functions
+// Memory mapping functions. memory_map backs a page-aligned user range
+// with fresh frames and refuses pages that are already mapped;
+// memory_unmap releases the frames again.
 void* memory_map(void* addr, size_t size, uint32_t flags) {
-    // TODO: Implement memory mapping
-    return NULL;
+    if (addr == NULL || size == 0 || ((uint32_t)addr & (PAGE_SIZE - 1))) return NULL;
+
+    uint32_t virt = (uint32_t)addr;
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (!memory_is_user_range(virt, pages)) return NULL;
+    for (uint32_t i = 0; i < pages; i++) {
+        if (paging_get_physical(virt + i * PAGE_SIZE) != 0) return NULL;
+    }
+
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t frame = frame_alloc(0);
+        if (frame == 0 || !paging_map_range(virt + i * PAGE_SIZE, frame, 1, flags)) {
+            if (frame != 0) frame_free(frame, 0);
+            memory_unmap(addr, i * PAGE_SIZE);
+            return NULL;
+        }
+    }
+
+    return addr;
 }
 
 bool memory_unmap(void* addr, size_t size) {
-    // TODO: Implement memory unmapping
-    return true;
+    if (addr == NULL || ((uint32_t)addr & (PAGE_SIZE - 1))) return false;
+
+    uint32_t virt = (uint32_t)addr;
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (!memory_is_user_range(virt, pages)) return false;
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t phys = paging_get_physical(virt + i * PAGE_SIZE);
+        if (phys != 0) frame_free(phys, 0);
+    }
+
+    return paging_unmap_range(virt, pages);
 }
 
 // Memory locking functions
@@ -0,0 +1,212 @@
+#include "../include/kernel.h"
+#include <memory.h>
+#include <string.h>
+#include <utils.h>
+
+// Allocation tracer for the kernel heap. Disabled by default; once
+// enabled every memory_alloc/memory_free is recorded in the event ring,
+// and live allocations are kept in an open-addressed table so a free can
+// be charged back to the call site that made the allocation.
+
+#define MEMTRACE_SITE_NONE 0xFFFF
+
+typedef struct {
+    void* ptr;
+    uint64_t timestamp;
+    uint32_t size;
+    uint16_t site;
+} memtrace_live_t;
+
+static bool memtrace_enabled = false;
+static uint32_t memtrace_untracked = 0;
+
+static memtrace_event_t event_ring[MEMTRACE_RING_SIZE];
+static uint32_t event_head = 0;     // Next slot to write
+static uint32_t event_count = 0;
+
+static memtrace_live_t live_table[MEMTRACE_MAX_LIVE];
+static memtrace_site_t site_table[MEMTRACE_MAX_SITES];
+static uint32_t site_count = 0;
+
+// Home slot of an address in the live table
+static inline uint32_t memtrace_hash(void* ptr) {
+    return (((uint32_t)ptr >> 4) * 2654435761u) % MEMTRACE_MAX_LIVE;
+}
+
+static void memtrace_log(uint64_t now, void* ptr, void* site, uint32_t size, bool is_free) {
+    memtrace_event_t* event = &event_ring[event_head];
+    event->timestamp = now;
+    event->ptr = ptr;
+    event->site = site;
+    event->size = size;
+    event->is_free = is_free;
+
+    event_head = (event_head + 1) % MEMTRACE_RING_SIZE;
+    if (event_count < MEMTRACE_RING_SIZE) event_count++;
+}
+
+// Find or add the summary entry of a call site
+static uint32_t memtrace_site_index(void* site) {
+    for (uint32_t i = 0; i < site_count; i++) {
+        if (site_table[i].site == site) return i;
+    }
+    if (site_count == MEMTRACE_MAX_SITES) return MEMTRACE_SITE_NONE;
+
+    memtrace_site_t* entry = &site_table[site_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->site = site;
+    return site_count++;
+}
+
+// Turn tracing on or off; turning it on starts from a clean state
+void memtrace_enable(bool enable) {
+    if (enable && !memtrace_enabled) {
+        memtrace_reset();
+    }
+    memtrace_enabled = enable;
+}
+
+bool memtrace_is_enabled(void) {
+    return memtrace_enabled;
+}
+
+// Forget all recorded events and allocations
+void memtrace_reset(void) {
+    memset(event_ring, 0, sizeof(event_ring));
+    memset(live_table, 0, sizeof(live_table));
+    memset(site_table, 0, sizeof(site_table));
+    event_head = 0;
+    event_count = 0;
+    site_count = 0;
+    memtrace_untracked = 0;
+}
+
+// Record an allocation made from site
+void memtrace_record_alloc(void* ptr, size_t size, void* site) {
+    if (!memtrace_enabled || ptr == NULL) return;
+
+    uint64_t now = time_get_current();
+    memtrace_log(now, ptr, site, size, false);
+
+    // Linear probing; once the table is full allocations are only logged
+    uint32_t slot = memtrace_hash(ptr);
+    uint32_t probe = 0;
+    while (probe < MEMTRACE_MAX_LIVE && live_table[slot].ptr != NULL) {
+        slot = (slot + 1) % MEMTRACE_MAX_LIVE;
+        probe++;
+    }
+    if (probe == MEMTRACE_MAX_LIVE) {
+        memtrace_untracked++;
+        return;
+    }
+
+    uint16_t index = memtrace_site_index(site);
+    if (index != MEMTRACE_SITE_NONE) {
+        site_table[index].live_bytes += size;
+        site_table[index].live_count++;
+        site_table[index].total_count++;
+    }
+
+    memtrace_live_t* live = &live_table[slot];
+    live->ptr = ptr;
+    live->size = size;
+    live->timestamp = now;
+    live->site = index;
+}
+
+// Record a free; pointers allocated before tracing started are ignored
+void memtrace_record_free(void* ptr) {
+    if (!memtrace_enabled || ptr == NULL) return;
+
+    uint32_t slot = memtrace_hash(ptr);
+    for (uint32_t probe = 0; probe < MEMTRACE_MAX_LIVE; probe++) {
+        memtrace_live_t* live = &live_table[slot];
+        if (live->ptr == NULL) return;
+        if (live->ptr == ptr) break;
+        slot = (slot + 1) % MEMTRACE_MAX_LIVE;
+    }
+
+    memtrace_live_t* live = &live_table[slot];
+    if (live->ptr != ptr) return;
+
+    uint64_t now = time_get_current();
+    if (live->site != MEMTRACE_SITE_NONE) {
+        memtrace_site_t* site = &site_table[live->site];
+        site->live_bytes -= live->size;
+        site->live_count--;
+        memtrace_log(now, ptr, site->site, live->size, true);
+    } else {
+        memtrace_log(now, ptr, NULL, live->size, true);
+    }
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    uint32_t hole = slot;
+    uint32_t next = (slot + 1) % MEMTRACE_MAX_LIVE;
+    live_table[hole].ptr = NULL;
+    while (live_table[next].ptr != NULL) {
+        uint32_t home = memtrace_hash(live_table[next].ptr);
+        uint32_t distance_next = (next - home + MEMTRACE_MAX_LIVE) % MEMTRACE_MAX_LIVE;
+        uint32_t distance_hole = (hole - home + MEMTRACE_MAX_LIVE) % MEMTRACE_MAX_LIVE;
+        if (distance_hole <= distance_next) {
+            live_table[hole] = live_table[next];
+            live_table[next].ptr = NULL;
+            hole = next;
+        }
+        next = (next + 1) % MEMTRACE_MAX_LIVE;
+    }
+}
+
+// Copy the call-site summary, largest live footprint first. Returns the
+// number of entries written.
+uint32_t memtrace_get_sites(memtrace_site_t* sites, uint32_t max) {
+    if (sites == NULL) return 0;
+
+    // Age of the oldest live allocation of each site
+    uint64_t now = time_get_current();
+    for (uint32_t i = 0; i < site_count; i++) {
+        site_table[i].oldest_age = 0;
+    }
+    for (uint32_t i = 0; i < MEMTRACE_MAX_LIVE; i++) {
+        memtrace_live_t* live = &live_table[i];
+        if (live->ptr == NULL || live->site == MEMTRACE_SITE_NONE) continue;
+
+        uint32_t age = time_ns_to_ms(now - live->timestamp);
+        if (age > site_table[live->site].oldest_age) {
+            site_table[live->site].oldest_age = age;
+        }
+    }
+
+    // Insertion sort into the caller's buffer, the table is small
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < site_count; i++) {
+        const memtrace_site_t* site = &site_table[i];
+        uint32_t position = count < max ? count : max;
+        while (position > 0 && sites[position - 1].live_bytes < site->live_bytes) {
+            if (position < max) sites[position] = sites[position - 1];
+            position--;
+        }
+        if (position < max) {
+            sites[position] = *site;
+            if (count < max) count++;
+        }
+    }
+    return count;
+}
+
+// Copy recent events, newest first. Returns the number written.
+uint32_t memtrace_get_events(memtrace_event_t* events, uint32_t max) {
+    if (events == NULL) return 0;
+
+    uint32_t count = event_count < max ? event_count : max;
+    uint32_t index = event_head;
+    for (uint32_t i = 0; i < count; i++) {
+        index = (index + MEMTRACE_RING_SIZE - 1) % MEMTRACE_RING_SIZE;
+        events[i] = event_ring[index];
+    }
+    return count;
+}
+
+// Allocations left out of the summary because the live table was full
+uint32_t memtrace_dropped(void) {
+    return memtrace_untracked;
+}
@@ -0,0 +1,459 @@
+#include "../include/kernel.h"
+#include <memory.h>
+#include <cpu.h>
+#include <string.h>
+
+// Two-level i386 paging. Page directories and page tables live in
+// identity-mapped frames, so they are reached through their physical
+// address both before and after paging is turned on.
+#define PAGE_DIRECTORY_INDEX(virt) ((virt) >> 22)
+#define PAGE_TABLE_INDEX(virt) (((virt) >> 12) & 0x3FF)
+#define PAGE_ENTRY_ADDRESS(entry) ((entry) & ~PAGE_FLAGS_MASK)
+
+// Directory entries covering user space differ per address space, all
+// others are copied from the kernel directory
+#define PAGE_USER_FIRST_TABLE PAGE_DIRECTORY_INDEX(USER_SPACE_START)
+#define PAGE_USER_LAST_TABLE PAGE_DIRECTORY_INDEX(USER_SPACE_END - 1)
+
+static uint32_t* kernel_directory = NULL;
+static uint32_t* current_directory = NULL;
+static bool paging_enabled = false;
+static bool paging_large_pages = false;
+
+// Every process directory, so kernel directory entries can be kept in
+// sync when one of them changes
+static uint32_t* address_spaces[MAX_PROCESSES];
+
+// Kernel mappings are always edited in the kernel directory
+static inline uint32_t* paging_directory_for(uint32_t virt) {
+    return paging_is_user_address(virt) ? current_directory : kernel_directory;
+}
+
+// Update a directory entry; kernel entries are copied to every address space
+static void paging_set_directory_entry(uint32_t* directory, uint32_t index, uint32_t value) {
+    directory[index] = value;
+    if (directory != kernel_directory || (index >= PAGE_USER_FIRST_TABLE && index <= PAGE_USER_LAST_TABLE)) {
+        return;
+    }
+    for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
+        if (address_spaces[i] != NULL) {
+            address_spaces[i][index] = value;
+        }
+    }
+}
+
+// Replace a 4 MiB mapping with a page table mapping the same frames
+static uint32_t* paging_split_large(uint32_t* directory, uint32_t index) {
+    uint32_t entry = directory[index];
+    uint32_t table = frame_alloc(0);
+    if (table == 0) return NULL;
+
+    uint32_t* entries = (uint32_t*)table;
+    uint32_t base = entry & PAGE_LARGE_MASK;
+    uint32_t flags = entry & PAGE_FLAGS_MASK & ~PAGE_LARGE;
+    for (uint32_t i = 0; i < 1024; i++) {
+        entries[i] = (base + i * PAGE_SIZE) | flags;
+    }
+
+    paging_set_directory_entry(directory, index, table | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER);
+
+    // One invlpg drops the whole large TLB entry
+    if (paging_enabled) cpu_invlpg(index << 22);
+    return entries;
+}
+
+// Get the page table covering virt, optionally creating it. A 4 MiB
+// mapping is split first, since callers edit individual pages.
+static uint32_t* paging_get_table(uint32_t* directory, uint32_t virt, bool create) {
+    uint32_t entry = directory[PAGE_DIRECTORY_INDEX(virt)];
+    if ((entry & (PAGE_PRESENT | PAGE_LARGE)) == (PAGE_PRESENT | PAGE_LARGE)) {
+        return paging_split_large(directory, PAGE_DIRECTORY_INDEX(virt));
+    }
+    if (entry & PAGE_PRESENT) {
+        return (uint32_t*)PAGE_ENTRY_ADDRESS(entry);
+    }
+    if (!create) return NULL;
+
+    uint32_t table = frame_alloc(0);
+    if (table == 0) return NULL;
+    memset((void*)table, 0, PAGE_SIZE);
+
+    // Directory entries stay permissive, the page entries decide access
+    paging_set_directory_entry(directory, PAGE_DIRECTORY_INDEX(virt), table | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER);
+    return (uint32_t*)table;
+}
+
+// Get the directory entry for virt if it is a present 4 MiB mapping
+static inline uint32_t paging_get_large(uint32_t* directory, uint32_t virt) {
+    uint32_t entry = directory[PAGE_DIRECTORY_INDEX(virt)];
+    if ((entry & (PAGE_PRESENT | PAGE_LARGE)) == (PAGE_PRESENT | PAGE_LARGE)) {
+        return entry;
+    }
+    return 0;
+}
+
+// Batched TLB invalidation for one range update: small ranges get one
+// invlpg per changed page, large ones a single CR3 reload at the end.
+typedef struct {
+    bool active;
+    bool flush_all;
+    bool pending;
+} tlb_batch_t;
+
+static inline void tlb_batch_begin(tlb_batch_t* batch, uint32_t* directory, uint32_t count) {
+    batch->active = paging_enabled && (directory == current_directory || directory == kernel_directory);
+    batch->flush_all = count > PAGE_TLB_FLUSH_THRESHOLD;
+    batch->pending = false;
+}
+
+static inline void tlb_batch_add(tlb_batch_t* batch, uint32_t virt) {
+    if (!batch->active) return;
+    if (batch->flush_all) {
+        batch->pending = true;
+    } else {
+        cpu_invlpg(virt);
+    }
+}
+
+static inline void tlb_batch_end(tlb_batch_t* batch) {
+    if (batch->pending) {
+        cpu_flush_tlb();
+    }
+}
+
+// Map count pages of physical memory at virt in the given directory
+static bool paging_map_in(uint32_t* directory, uint32_t virt, uint32_t phys, uint32_t count, uint32_t flags) {
+    tlb_batch_t batch;
+    tlb_batch_begin(&batch, directory, count);
+
+    uint32_t* table = NULL;
+    for (uint32_t i = 0; i < count; i++, virt += PAGE_SIZE, phys += PAGE_SIZE) {
+        if (table == NULL || PAGE_TABLE_INDEX(virt) == 0) {
+            table = paging_get_table(directory, virt, true);
+            if (table == NULL) {
+                tlb_batch_end(&batch);
+                return false;
+            }
+        }
+
+        uint32_t* entry = &table[PAGE_TABLE_INDEX(virt)];
+        bool was_present = (*entry & PAGE_PRESENT) != 0;
+        *entry = PAGE_ENTRY_ADDRESS(phys) | (flags & PAGE_FLAGS_MASK) | PAGE_PRESENT;
+
+        // A non-present entry cannot be cached in the TLB
+        if (was_present) tlb_batch_add(&batch, virt);
+    }
+
+    tlb_batch_end(&batch);
+    return true;
+}
+
+// Map 4 MiB aligned memory with large pages, at init time only
+static void paging_map_large_in(uint32_t* directory, uint32_t virt, uint32_t phys, uint32_t count, uint32_t flags) {
+    for (uint32_t i = 0; i < count; i++, virt += PAGE_LARGE_SIZE, phys += PAGE_LARGE_SIZE) {
+        directory[PAGE_DIRECTORY_INDEX(virt)] = phys | (flags & PAGE_FLAGS_MASK) | PAGE_PRESENT | PAGE_LARGE;
+    }
+}
+
+// Set up the kernel address space and turn paging on
+void paging_init(void) {
+    kernel_directory = (uint32_t*)frame_alloc(0);
+    if (kernel_directory == NULL) {
+        kernel_panic("paging: no frame for the page directory");
+    }
+    memset(kernel_directory, 0, PAGE_SIZE);
+    memset(address_spaces, 0, sizeof(address_spaces));
+    current_directory = kernel_directory;
+
+    paging_large_pages = cpu_has_feature_edx(CPUID_EDX_PSE);
+    if (paging_large_pages) {
+        cpu_write_cr4(cpu_read_cr4() | CR4_PSE);
+    }
+
+    // Identity map all managed memory except page 0, so NULL faults. The
+    // first 4 MiB keep small pages for that hole, whole 4 MiB blocks
+    // above it use large pages when available.
+    uint32_t top = frame_memory_top();
+    uint32_t small_end = top;
+    uint32_t large_end = top;
+    if (paging_large_pages && top > PAGE_LARGE_SIZE) {
+        small_end = PAGE_LARGE_SIZE;
+        large_end = top & PAGE_LARGE_MASK;
+    }
+    paging_map_in(kernel_directory, PAGE_SIZE, PAGE_SIZE, small_end / PAGE_SIZE - 1, PAGE_WRITABLE);
+    if (large_end > small_end) {
+        paging_map_large_in(kernel_directory, small_end, small_end,
+                            (large_end - small_end) / PAGE_LARGE_SIZE, PAGE_WRITABLE);
+        paging_map_in(kernel_directory, large_end, large_end, (top - large_end) / PAGE_SIZE, PAGE_WRITABLE);
+    }
+
+    // Back the kernel heap, contiguously if possible. An order 10 block is
+    // 4 MiB aligned, so it fits a single large page.
+    uint32_t heap_pages = (KERNEL_HEAP_END - KERNEL_HEAP_START) / PAGE_SIZE;
+    uint32_t heap_frames = frame_alloc(FRAME_MAX_ORDER);
+    if (heap_frames != 0 && heap_pages == (1u << FRAME_MAX_ORDER)) {
+        if (paging_large_pages) {
+            paging_map_large_in(kernel_directory, KERNEL_HEAP_START, heap_frames, 1, PAGE_WRITABLE);
+        } else {
+            paging_map_in(kernel_directory, KERNEL_HEAP_START, heap_frames, heap_pages, PAGE_WRITABLE);
+        }
+    } else {
+        if (heap_frames != 0) frame_free(heap_frames, FRAME_MAX_ORDER);
+        for (uint32_t i = 0; i < heap_pages; i++) {
+            uint32_t frame = frame_alloc(0);
+            if (frame == 0) {
+                kernel_panic("paging: out of frames for the kernel heap");
+            }
+            paging_map_in(kernel_directory, KERNEL_HEAP_START + i * PAGE_SIZE, frame, 1, PAGE_WRITABLE);
+        }
+    }
+
+    cpu_write_cr3((uint32_t)kernel_directory);
+    cpu_write_cr0(cpu_read_cr0() | CR0_PG | CR0_WP);
+    paging_enabled = true;
+}
+
+// Map count pages starting at virt onto physical memory starting at phys
+bool paging_map_range(uint32_t virt, uint32_t phys, uint32_t count, uint32_t flags) {
+    if ((virt | phys) & (PAGE_SIZE - 1)) return false;
+    return paging_map_in(paging_directory_for(virt), virt, phys, count, flags);
+}
+
+// Remove count page mappings starting at virt
+bool paging_unmap_range(uint32_t virt, uint32_t count) {
+    if (virt & (PAGE_SIZE - 1)) return false;
+
+    uint32_t* directory = paging_directory_for(virt);
+    tlb_batch_t batch;
+    tlb_batch_begin(&batch, directory, count);
+
+    for (uint32_t i = 0; i < count; i++, virt += PAGE_SIZE) {
+        uint32_t* table = paging_get_table(directory, virt, false);
+        if (table == NULL) {
+            // Skip the rest of this unmapped 4 MiB region
+            uint32_t skip = 1024 - PAGE_TABLE_INDEX(virt) - 1;
+            i += skip;
+            virt += skip * PAGE_SIZE;
+            continue;
+        }
+
+        uint32_t* entry = &table[PAGE_TABLE_INDEX(virt)];
+        if (*entry & PAGE_PRESENT) {
+            *entry = 0;
+            tlb_batch_add(&batch, virt);
+        }
+    }
+
+    tlb_batch_end(&batch);
+    return true;
+}
+
+// Change the flags of count present pages starting at virt
+bool paging_protect_range(uint32_t virt, uint32_t count, uint32_t flags) {
+    if (virt & (PAGE_SIZE - 1)) return false;
+
+    uint32_t* directory = paging_directory_for(virt);
+    tlb_batch_t batch;
+    tlb_batch_begin(&batch, directory, count);
+
+    bool ok = true;
+    for (uint32_t i = 0; i < count; i++, virt += PAGE_SIZE) {
+        uint32_t* table = paging_get_table(directory, virt, false);
+        uint32_t* entry = table != NULL ? &table[PAGE_TABLE_INDEX(virt)] : NULL;
+        if (entry == NULL || !(*entry & PAGE_PRESENT)) {
+            ok = false;
+            continue;
+        }
+
+        uint32_t updated = PAGE_ENTRY_ADDRESS(*entry) | (flags & PAGE_FLAGS_MASK) | PAGE_PRESENT;
+        if (updated != *entry) {
+            *entry = updated;
+            tlb_batch_add(&batch, virt);
+        }
+    }
+
+    tlb_batch_end(&batch);
+    return ok;
+}
+
+// Translate a virtual address, returns 0 when it is not mapped
+uint32_t paging_get_physical(uint32_t virt) {
+    uint32_t large = paging_get_large(paging_directory_for(virt), virt);
+    if (large != 0) {
+        return (large & PAGE_LARGE_MASK) | (virt & (PAGE_LARGE_SIZE - 1));
+    }
+
+    uint32_t* table = paging_get_table(paging_directory_for(virt), virt, false);
+    if (table == NULL) return 0;
+
+    uint32_t entry = table[PAGE_TABLE_INDEX(virt)];
+    if (!(entry & PAGE_PRESENT)) return 0;
+    return PAGE_ENTRY_ADDRESS(entry) | (virt & (PAGE_SIZE - 1));
+}
+
+// Get the page table entry flags for a virtual address, 0 when unmapped
+uint32_t paging_get_flags(uint32_t virt) {
+    uint32_t large = paging_get_large(paging_directory_for(virt), virt);
+    if (large != 0) return large & PAGE_FLAGS_MASK;
+
+    uint32_t* table = paging_get_table(paging_directory_for(virt), virt, false);
+    if (table == NULL) return 0;
+    return table[PAGE_TABLE_INDEX(virt)] & PAGE_FLAGS_MASK;
+}
+
+// Create an address space with empty user space and the kernel mappings.
+// Returns the physical address of its page directory, 0 on failure.
+uint32_t paging_create_directory(void) {
+    uint32_t slot = 0;
+    while (slot < MAX_PROCESSES && address_spaces[slot] != NULL) slot++;
+    if (slot == MAX_PROCESSES) return 0;
+
+    uint32_t* directory = (uint32_t*)frame_alloc(0);
+    if (directory == NULL) return 0;
+
+    for (uint32_t i = 0; i < 1024; i++) {
+        bool user = i >= PAGE_USER_FIRST_TABLE && i <= PAGE_USER_LAST_TABLE;
+        directory[i] = user ? 0 : kernel_directory[i];
+    }
+    address_spaces[slot] = directory;
+    return (uint32_t)directory;
+}
+
+// Free an address space together with every user frame mapped in it
+void paging_destroy_directory(uint32_t directory_address) {
+    uint32_t* directory = (uint32_t*)directory_address;
+    if (directory == NULL || directory == kernel_directory) return;
+    if (directory == current_directory) {
+        paging_switch_directory(0);
+    }
+
+    for (uint32_t i = PAGE_USER_FIRST_TABLE; i <= PAGE_USER_LAST_TABLE; i++) {
+        if (!(directory[i] & PAGE_PRESENT)) continue;
+
+        uint32_t* table = (uint32_t*)PAGE_ENTRY_ADDRESS(directory[i]);
+        for (uint32_t j = 0; j < 1024; j++) {
+            if (table[j] & PAGE_PRESENT) {
+                frame_free(PAGE_ENTRY_ADDRESS(table[j]), 0);
+            }
+        }
+        frame_free((uint32_t)table, 0);
+    }
+
+    for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
+        if (address_spaces[i] == directory) {
+            address_spaces[i] = NULL;
+            break;
+        }
+    }
+    frame_free(directory_address, 0);
+}
+
+// Switch to an address space, 0 selects the kernel directory
+void paging_switch_directory(uint32_t directory_address) {
+    uint32_t* directory = directory_address != 0 ? (uint32_t*)directory_address : kernel_directory;
+    if (directory == current_directory) return;
+
+    current_directory = directory;
+    if (paging_enabled) {
+        cpu_write_cr3((uint32_t)directory);
+    }
+}
+
+// Fix faults on kernel addresses whose page table was created after the
+// current address space was cloned from the kernel directory
+bool paging_sync_kernel(uint32_t address) {
+    if (paging_is_user_address(address) || current_directory == kernel_directory) return false;
+
+    uint32_t index = PAGE_DIRECTORY_INDEX(address);
+    if (current_directory[index] & PAGE_PRESENT) return false;
+    if (!(kernel_directory[index] & PAGE_PRESENT)) return false;
+
+    current_directory[index] = kernel_directory[index];
+    return true;
+}
+
+// Create a copy-on-write clone of an address space. Writable user pages
+// become read-only in both spaces and their frames gain an owner; the
+// first write on either side faults and gets a private copy.
+// Returns the physical address of the new directory, 0 on failure.
+uint32_t paging_clone_directory(uint32_t directory_address) {
+    uint32_t* source = directory_address != 0 ? (uint32_t*)directory_address : kernel_directory;
+    uint32_t* clone = (uint32_t*)paging_create_directory();
+    if (clone == NULL) return 0;
+
+    bool flush = false;
+    bool ok = true;
+    for (uint32_t i = PAGE_USER_FIRST_TABLE; i <= PAGE_USER_LAST_TABLE && ok; i++) {
+        if (!(source[i] & PAGE_PRESENT)) continue;
+
+        uint32_t* table = (uint32_t*)PAGE_ENTRY_ADDRESS(source[i]);
+        uint32_t* copy = (uint32_t*)frame_alloc(0);
+        if (copy == NULL) {
+            ok = false;
+            break;
+        }
+        memset(copy, 0, PAGE_SIZE);
+        clone[i] = (uint32_t)copy | (source[i] & PAGE_FLAGS_MASK);
+
+        for (uint32_t j = 0; j < 1024; j++) {
+            uint32_t entry = table[j];
+            if (!(entry & PAGE_PRESENT)) continue;
+            if (!frame_share(PAGE_ENTRY_ADDRESS(entry))) {
+                ok = false;
+                break;
+            }
+            if (entry & PAGE_WRITABLE) {
+                entry = (entry & ~PAGE_WRITABLE) | PAGE_COW;
+                table[j] = entry;
+                flush = true;
+            }
+            copy[j] = entry;
+        }
+    }
+
+    // One reload covers every page the parent just lost write access to.
+    // On failure the parent keeps its copy-on-write entries, the fault
+    // handler makes them writable again since they have a single owner.
+    if (flush && paging_enabled && source == current_directory) {
+        cpu_flush_tlb();
+    }
+    if (!ok) {
+        paging_destroy_directory((uint32_t)clone);
+        return 0;
+    }
+    return (uint32_t)clone;
+}
+
+// Resolve a write fault on a copy-on-write page of the current address
+// space. Returns false when the fault is not a copy-on-write fault.
+bool paging_handle_cow(uint32_t address, uint32_t error_code) {
+    uint32_t required = PAGE_FAULT_PRESENT | PAGE_FAULT_WRITE;
+    if ((error_code & required) != required || !paging_is_user_address(address)) return false;
+
+    uint32_t* table = paging_get_table(current_directory, address, false);
+    if (table == NULL) return false;
+
+    uint32_t* entry = &table[PAGE_TABLE_INDEX(address)];
+    if ((*entry & (PAGE_PRESENT | PAGE_COW)) != (PAGE_PRESENT | PAGE_COW)) return false;
+
+    uint32_t frame = PAGE_ENTRY_ADDRESS(*entry);
+    uint32_t flags = (*entry & PAGE_FLAGS_MASK & ~PAGE_COW) | PAGE_WRITABLE;
+
+    // Last owner keeps the frame, everyone else copies it
+    if (frame_owners(frame) > 1) {
+        uint32_t copy = frame_alloc(0);
+        if (copy == 0) return false;
+        memcpy((void*)copy, (void*)frame, PAGE_SIZE);
+        frame_free(frame, 0);
+        frame = copy;
+    }
+
+    *entry = frame | flags;
+    cpu_invlpg(address & ~(PAGE_SIZE - 1));
+    return true;
+}
+
+// Check whether the kernel mappings use 4 MiB pages
+bool paging_uses_large_pages(void) {
+    return paging_large_pages;
+}
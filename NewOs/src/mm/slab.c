@@ -0,0 +1,204 @@
+#include "../include/kernel.h"
+#include <memory.h>
+#include <process.h>
+#include <string.h>
+
+// Slab header, stored at the start of each slab page. Free objects are
+// tracked by index in a stack that follows the header, so a free object
+// keeps its constructed state intact.
+struct slab {
+    slab_cache_t* cache;
+    slab_t* prev;
+    slab_t* next;
+    uint8_t* objects;
+    uint16_t in_use;
+    uint16_t free_count;
+    uint16_t free_stack[];
+};
+
+#define SLAB_ALIGN 8
+#define SLAB_ALIGN_UP(x) (((x) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+// Slab cache descriptors
+static slab_cache_t slab_caches[MAX_SLAB_CACHES];
+
+// Find the slab that owns an object
+static inline slab_t* slab_from_object(void* object) {
+    return (slab_t*)(((uint32_t)object & ~(PAGE_SIZE - 1)) + sizeof(memory_block_t));
+}
+
+static void slab_list_remove(slab_t** list, slab_t* slab) {
+    if (slab->prev != NULL) slab->prev->next = slab->next;
+    else *list = slab->next;
+    if (slab->next != NULL) slab->next->prev = slab->prev;
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+static void slab_list_add(slab_t** list, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (slab->next != NULL) slab->next->prev = slab;
+    *list = slab;
+}
+
+// Get a new slab page and construct all of its objects
+static slab_t* slab_grow(slab_cache_t* cache) {
+    slab_t* slab = (slab_t*)memory_alloc_page();
+    if (slab == NULL) return NULL;
+
+    slab->cache = cache;
+    slab->prev = NULL;
+    slab->next = NULL;
+    slab->objects = (uint8_t*)slab +
+        SLAB_ALIGN_UP(sizeof(slab_t) + cache->objects_per_slab * sizeof(uint16_t));
+    slab->in_use = 0;
+    slab->free_count = cache->objects_per_slab;
+
+    // Lowest address on top of the stack
+    for (uint32_t i = 0; i < cache->objects_per_slab; i++) {
+        slab->free_stack[i] = cache->objects_per_slab - 1 - i;
+        if (cache->ctor != NULL) {
+            cache->ctor(slab->objects + i * cache->object_size);
+        }
+    }
+
+    cache->stats.total_slabs++;
+    return slab;
+}
+
+// Create a slab cache
+slab_cache_t* slab_cache_create(const char* name, size_t object_size, void (*ctor)(void*)) {
+    if (name == NULL || object_size == 0) return NULL;
+
+    object_size = SLAB_ALIGN_UP(object_size);
+
+    // Each object costs its size plus one free-stack entry
+    uint32_t objects_per_slab =
+        (MEMORY_PAGE_USABLE - SLAB_ALIGN_UP(sizeof(slab_t))) / (object_size + sizeof(uint16_t));
+    while (objects_per_slab > 0 &&
+           SLAB_ALIGN_UP(sizeof(slab_t) + objects_per_slab * sizeof(uint16_t)) +
+           objects_per_slab * object_size > MEMORY_PAGE_USABLE) {
+        objects_per_slab--;
+    }
+    if (objects_per_slab == 0) return NULL;
+
+    // Find free cache slot
+    slab_cache_t* cache = NULL;
+    for (int i = 0; i < MAX_SLAB_CACHES; i++) {
+        if (!slab_caches[i].in_use) {
+            cache = &slab_caches[i];
+            break;
+        }
+    }
+    if (cache == NULL) return NULL;
+
+    memset(cache, 0, sizeof(slab_cache_t));
+    strncpy(cache->name, name, MAX_NAME_LENGTH - 1);
+    cache->name[MAX_NAME_LENGTH - 1] = '\0';
+    cache->object_size = object_size;
+    cache->objects_per_slab = objects_per_slab;
+    cache->ctor = ctor;
+    cache->stats.object_size = object_size;
+    cache->stats.objects_per_slab = cache->objects_per_slab;
+    cache->in_use = true;
+
+    return cache;
+}
+
+// Destroy a slab cache, releasing every slab it owns
+void slab_cache_destroy(slab_cache_t* cache) {
+    if (cache == NULL || !cache->in_use) return;
+
+    slab_t* lists[3] = { cache->partial, cache->full, cache->empty };
+    for (int i = 0; i < 3; i++) {
+        slab_t* slab = lists[i];
+        while (slab != NULL) {
+            slab_t* next = slab->next;
+            memory_free_page(slab);
+            slab = next;
+        }
+    }
+
+    cache->in_use = false;
+}
+
+// Allocate an object from a slab cache
+void* slab_cache_alloc(slab_cache_t* cache) {
+    if (cache == NULL || !cache->in_use) return NULL;
+
+    preempt_disable();
+    slab_t* slab = cache->partial;
+    if (slab == NULL) {
+        slab = cache->empty;
+        if (slab != NULL) {
+            slab_list_remove(&cache->empty, slab);
+        } else {
+            slab = slab_grow(cache);
+            if (slab == NULL) {
+                preempt_enable();
+                return NULL;
+            }
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    void* object = slab->objects + slab->free_stack[--slab->free_count] * cache->object_size;
+    if (++slab->in_use == cache->objects_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+
+    cache->stats.active_objects++;
+    cache->stats.total_allocs++;
+    preempt_enable();
+    return object;
+}
+
+// Return an object to its slab cache. Objects of a cache with a
+// constructor must be handed back in their constructed state.
+void slab_cache_free(slab_cache_t* cache, void* object) {
+    if (cache == NULL || object == NULL) return;
+
+    slab_t* slab = slab_from_object(object);
+    if (slab->cache != cache) return;
+
+    preempt_disable();
+    if (slab->in_use == cache->objects_per_slab) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    slab->free_stack[slab->free_count++] =
+        ((uint8_t*)object - slab->objects) / cache->object_size;
+    if (--slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->empty, slab);
+    }
+
+    cache->stats.active_objects--;
+    cache->stats.total_frees++;
+    preempt_enable();
+}
+
+// Release empty slabs back to the heap, returns the number of pages freed
+uint32_t slab_cache_shrink(slab_cache_t* cache) {
+    if (cache == NULL || !cache->in_use) return 0;
+
+    uint32_t freed = 0;
+    while (cache->empty != NULL) {
+        slab_t* slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        memory_free_page(slab);
+        freed++;
+    }
+
+    cache->stats.total_slabs -= freed;
+    return freed;
+}
+
+// Get slab cache statistics
+void slab_cache_get_stats(slab_cache_t* cache, slab_cache_stats_t* stats) {
+    if (cache == NULL || stats == NULL) return;
+    *stats = cache->stats;
+}
@@ -0,0 +1,146 @@
+#include "../include/kernel.h"
+#include <memory.h>
+#include <string.h>
+
+// Reserved virtual regions, kept sorted by start address. Pages inside a
+// region are backed by a zeroed frame the first time they are touched.
+static vm_region_t vm_regions[MAX_VM_REGIONS];
+static uint32_t vm_region_count = 0;
+static vm_stats_t vm_statistics;
+
+// Index of the first region ending above address
+static uint32_t vm_region_search(uint32_t address) {
+    uint32_t low = 0;
+    uint32_t high = vm_region_count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (vm_regions[mid].end <= address) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Find the region containing address
+vm_region_t* vm_find_region(uint32_t address) {
+    uint32_t index = vm_region_search(address);
+    if (index < vm_region_count && vm_regions[index].start <= address) {
+        return &vm_regions[index];
+    }
+    return NULL;
+}
+
+// Insert a region at a known sorted position
+static vm_region_t* vm_region_insert(uint32_t index, uint32_t start, uint32_t end, uint32_t flags) {
+    if (vm_region_count == MAX_VM_REGIONS) return NULL;
+
+    for (uint32_t i = vm_region_count; i > index; i--) {
+        vm_regions[i] = vm_regions[i - 1];
+    }
+    vm_region_count++;
+
+    vm_region_t* region = &vm_regions[index];
+    region->start = start;
+    region->end = end;
+    region->flags = flags;
+    region->committed = 0;
+
+    vm_statistics.reserved_bytes += end - start;
+    return region;
+}
+
+// Reserve size bytes of address space in the lazy area, leaving an
+// unmapped guard page between regions
+void* vm_reserve(size_t size, uint32_t flags) {
+    if (size == 0) return NULL;
+    uint32_t length = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    // First fit over the gaps between regions
+    uint32_t candidate = VM_LAZY_START;
+    uint32_t index = vm_region_search(VM_LAZY_START);
+    while (index < vm_region_count && vm_regions[index].start < VM_LAZY_END) {
+        if (vm_regions[index].start >= candidate + length + PAGE_SIZE) break;
+        candidate = vm_regions[index].end + PAGE_SIZE;
+        index++;
+    }
+    if (candidate + length > VM_LAZY_END || candidate + length < candidate) return NULL;
+
+    vm_region_t* region = vm_region_insert(index, candidate, candidate + length, flags);
+    return region != NULL ? (void*)region->start : NULL;
+}
+
+// Reserve a fixed range, fails if it overlaps an existing region
+bool vm_reserve_at(uint32_t start, size_t size, uint32_t flags) {
+    if ((start & (PAGE_SIZE - 1)) || size == 0) return false;
+    uint32_t end = start + ((size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+
+    uint32_t index = vm_region_search(start);
+    if (index < vm_region_count && vm_regions[index].start < end) return false;
+
+    return vm_region_insert(index, start, end, flags) != NULL;
+}
+
+// Release a region, freeing the frames of every page that was touched
+bool vm_release(void* addr) {
+    uint32_t index = vm_region_search((uint32_t)addr);
+    if (index >= vm_region_count || vm_regions[index].start != (uint32_t)addr) return false;
+
+    vm_region_t* region = &vm_regions[index];
+    if (region->committed > 0) {
+        uint32_t pages = (region->end - region->start) / PAGE_SIZE;
+        for (uint32_t i = 0; i < pages; i++) {
+            uint32_t phys = paging_get_physical(region->start + i * PAGE_SIZE);
+            if (phys != 0) frame_free(phys & ~(PAGE_SIZE - 1), 0);
+        }
+        paging_unmap_range(region->start, pages);
+        vm_statistics.committed_pages -= region->committed;
+    }
+    vm_statistics.reserved_bytes -= region->end - region->start;
+
+    vm_region_count--;
+    for (uint32_t i = index; i < vm_region_count; i++) {
+        vm_regions[i] = vm_regions[i + 1];
+    }
+    return true;
+}
+
+// Check whether addr lies inside a reserved region
+bool vm_is_reserved(const void* addr) {
+    return vm_find_region((uint32_t)addr) != NULL;
+}
+
+// Map a freshly zeroed frame at a page-aligned address
+bool vm_map_zero_page(uint32_t address, uint32_t flags) {
+    uint32_t frame = frame_alloc(0);
+    if (frame == 0) return false;
+    memset((void*)frame, 0, PAGE_SIZE);
+
+    if (!paging_map_range(address, frame, 1, flags)) {
+        frame_free(frame, 0);
+        return false;
+    }
+    return true;
+}
+
+// Back the faulting page with a zeroed frame if it belongs to a region.
+// Returns false when the fault is not ours to fix.
+bool vm_handle_fault(uint32_t address, uint32_t error_code) {
+    if (error_code & PAGE_FAULT_PRESENT) return false;
+
+    vm_region_t* region = vm_find_region(address);
+    if (region == NULL) return false;
+    if ((error_code & PAGE_FAULT_WRITE) && !(region->flags & PAGE_WRITABLE)) return false;
+    if ((error_code & PAGE_FAULT_USER) && !(region->flags & PAGE_USER)) return false;
+
+    if (!vm_map_zero_page(address & ~(PAGE_SIZE - 1), region->flags)) return false;
+
+    region->committed++;
+    vm_statistics.committed_pages++;
+    vm_statistics.minor_faults++;
+    return true;
+}
+
+// Get lazy allocation statistics
+void vm_get_stats(vm_stats_t* stats) {
+    if (stats == NULL) return;
+    *stats = vm_statistics;
+}
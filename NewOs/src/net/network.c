@@ -1,13 +1,23 @@
 #include "../include/kernel.h"
+#include <hashmap.h>
+#include <memory.h>
 #include <string.h>
 
 // Network structures
 static network_interface_t* network_interfaces[MAX_NETWORK_INTERFACES];
 static uint32_t next_interface_id = 1;
+static slab_cache_t* interface_cache = NULL;
+
+// Interface id index
+static hash_map_entry_t interface_id_entries[HASH_MAP_CAPACITY(MAX_NETWORK_INTERFACES)];
+static hash_map_t interface_ids;
 
 // Initialize network system
 void network_init(void) {
     memset(network_interfaces, 0, sizeof(network_interfaces));
+    hash_map_init(&interface_ids, interface_id_entries, HASH_MAP_CAPACITY(MAX_NETWORK_INTERFACES),
+                  hash_map_hash_id, hash_map_equals_id);
+    interface_cache = slab_cache_create("netif", sizeof(network_interface_t), NULL);
 }
 
 // Register a network interface
@@ -24,7 +34,7 @@ network_interface_t* network_register_interface(const char* name, network_interf
     if (slot == -1) return NULL; // No free slots
 
     // Allocate interface structure
-    network_interface_t* interface = (network_interface_t*)memory_alloc(sizeof(network_interface_t));
+    network_interface_t* interface = (network_interface_t*)slab_cache_alloc(interface_cache);
     if (interface == NULL) return NULL;
 
     // Initialize interface
@@ -44,6 +54,7 @@ network_interface_t* network_register_interface(const char* name, network_interf
 
     // Add to interface table
     network_interfaces[slot] = interface;
+    hash_map_put(&interface_ids, HASH_MAP_ID(interface->id), interface);
 
     return interface;
 }
@@ -53,6 +64,7 @@ void network_unregister_interface(network_interface_t* interface) {
     if (interface == NULL) return;
 
     // Remove from interface table
+    hash_map_remove(&interface_ids, HASH_MAP_ID(interface->id));
     for (int i = 0; i < MAX_NETWORK_INTERFACES; i++) {
         if (network_interfaces[i] == interface) {
             network_interfaces[i] = NULL;
@@ -61,7 +73,7 @@ void network_unregister_interface(network_interface_t* interface) {
     }
 
     // Free interface structure
-    memory_free(interface);
+    slab_cache_free(interface_cache, interface);
 }
 
 // Set interface state
@@ -127,12 +139,7 @@ size_t network_receive_packet(network_interface_t* interface, void* buffer, size
 
 // Get interface by ID
 network_interface_t* network_get_interface_by_id(uint32_t id) {
-    for (int i = 0; i < MAX_NETWORK_INTERFACES; i++) {
-        if (network_interfaces[i] != NULL && network_interfaces[i]->id == id) {
-            return network_interfaces[i];
-        }
-    }
-    return NULL;
+    return hash_map_get(&interface_ids, HASH_MAP_ID(id));
 }
 
 // Get interface by name
@@ -1,115 +1,610 @@
 #include "../include/kernel.h"
+#include <bitops.h>
+#include <cpu.h>
+#include <hashmap.h>
+#include <interrupt.h>
+#include <memory.h>
+#include <process.h>
 #include <string.h>
+#include <timer.h>
+#include <utils.h>
 
-// Process table
+// PIDs are recycled, but only after the counter has gone round the
+// whole range, so a stale PID does not immediately name a new process
+#define PID_LIMIT 32768
+
+// Process table, with bitmaps of used table slots and PIDs
 static process_t* process_table[MAX_PROCESSES];
+static uint32_t slot_bitmap[BITMAP_WORDS(MAX_PROCESSES)];
+static uint32_t pid_bitmap[BITMAP_WORDS(PID_LIMIT)];
 static uint32_t next_pid = 1;
 static process_t* current_process = NULL;
 
+// Run queues, one circular list per priority level with the next process
+// to run at the head, and a bitmap of the non-empty levels. A process is
+// queued exactly while it is PROC_READY.
+#define PRIORITY_LEVELS (MAX_PRIORITY + 1)
+
+static process_t* run_queues[PRIORITY_LEVELS];
+static uint32_t run_bitmap = 0;
+
+// PID index over the process table
+static hash_map_entry_t pid_entries[HASH_MAP_CAPACITY(MAX_PROCESSES)];
+static hash_map_t pid_map;
+
+// Object caches for process and thread structures
+static slab_cache_t* process_cache = NULL;
+static slab_cache_t* thread_cache = NULL;
+
+// Context of the kernel main loop, which runs whenever no process is
+// ready. It has no process, only a place to keep its stack pointer and
+// FPU state.
+static thread_t idle_thread;
+
+// A process that exited cannot free the stack it is running on; the
+// next context outside an interrupt handler does it. Zombies are off the
+// run queues, so run_next links them here.
+static process_t* exited_processes = NULL;
+
+// Sleeping processes by wake_at, earliest first
+static process_t* sleep_queue = NULL;
+
+volatile uint32_t preempt_count = 0;
+volatile bool preempt_pending = false;
+
+// Lazy FPU switching. The registers stay loaded until another thread
+// touches the FPU: CR0.TS is set on every switch away from the owner, and
+// the resulting #NM saves the owner's state and loads the new thread's.
+// FXSAVE areas need 16-byte alignment, slab objects only have 8.
+#define FPU_STATE_SIZE 512
+#define FPU_STATE_AREA(thread) ((void*)(((uint32_t)(thread)->fpu_state + 15) & ~15u))
+
+static slab_cache_t* fpu_cache = NULL;
+static thread_t* fpu_owner = NULL;  // NULL when the registers hold nothing to keep
+static bool fpu_trapping = false;   // Mirrors CR0.TS
+static bool fpu_fxsr = false;       // FXSAVE usable, otherwise FNSAVE
+
+// From switch.asm
+extern void context_switch(uint32_t* save_stack, uint32_t load_stack);
+extern void fork_return(void);
+
+// Frame of a process_fork call the child returns from: the frame pointer
+// of process_fork and the caller's callee-saved registers
+typedef struct {
+    uint32_t base;
+    uint32_t ebx;
+    uint32_t esi;
+    uint32_t edi;
+} fork_frame_t;
+
+static uint32_t process_sys_brk(uint32_t address, uint32_t unused1, uint32_t unused2);
+static uint32_t process_sys_sbrk(uint32_t increment, uint32_t unused1, uint32_t unused2);
+
+// Set or clear CR0.TS; while set, the next FPU/SSE instruction traps
+static inline void fpu_set_trap(bool trap) {
+    if (trap == fpu_trapping) return;
+    if (trap) cpu_set_ts();
+    else cpu_clts();
+    fpu_trapping = trap;
+}
+
 // Initialize process management
 void process_init(void) {
     memset(process_table, 0, sizeof(process_table));
+    memset(slot_bitmap, 0, sizeof(slot_bitmap));
+    memset(pid_bitmap, 0, sizeof(pid_bitmap));
+    bitmap_set(pid_bitmap, 0);
+    memset(run_queues, 0, sizeof(run_queues));
+    run_bitmap = 0;
+    hash_map_init(&pid_map, pid_entries, HASH_MAP_CAPACITY(MAX_PROCESSES),
+                  hash_map_hash_id, hash_map_equals_id);
+    process_cache = slab_cache_create("process", sizeof(process_t), NULL);
+    thread_cache = slab_cache_create("thread", sizeof(thread_t), NULL);
+    fpu_cache = slab_cache_create("fpu", FPU_STATE_SIZE + 8, NULL);
+
+    memset(&idle_thread, 0, sizeof(idle_thread));
+    exited_processes = NULL;
+    sleep_queue = NULL;
+    fpu_owner = NULL;
+    fpu_fxsr = cpu_sse_enabled();
+
+    // Nobody owns the FPU yet, so the next use, even by the kernel main
+    // loop, has to claim it through the #NM handler
+    fpu_trapping = false;
+    fpu_set_trap(true);
+
+    syscall_register(SYS_BRK, process_sys_brk, "brk");
+    syscall_register(SYS_SBRK, process_sys_sbrk, "sbrk");
 }
 
-// Create a new process
-error_t process_create(const char* name, void* entry_point, uint32_t priority) {
-    // Find free slot in process table
-    int slot = -1;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i] == NULL) {
-            slot = i;
-            break;
+static inline uint32_t process_level(const process_t* process) {
+    return process->priority < MAX_PRIORITY ? process->priority : MAX_PRIORITY;
+}
+
+// Add a process at the tail of its level
+static void run_queue_add(process_t* process) {
+    uint32_t level = process_level(process);
+    process_t* head = run_queues[level];
+    if (head == NULL) {
+        process->run_next = process;
+        process->run_prev = process;
+        run_queues[level] = process;
+        run_bitmap |= 1u << level;
+        return;
+    }
+    process->run_next = head;
+    process->run_prev = head->run_prev;
+    head->run_prev->run_next = process;
+    head->run_prev = process;
+}
+
+static void run_queue_remove(process_t* process) {
+    uint32_t level = process_level(process);
+    if (process->run_next == process) {
+        run_queues[level] = NULL;
+        run_bitmap &= ~(1u << level);
+    } else {
+        process->run_prev->run_next = process->run_next;
+        process->run_next->run_prev = process->run_prev;
+        if (run_queues[level] == process) run_queues[level] = process->run_next;
+    }
+    process->run_next = NULL;
+    process->run_prev = NULL;
+}
+
+static void sleep_queue_add(process_t* process) {
+    process_t** link = &sleep_queue;
+    while (*link != NULL && (*link)->wake_at <= process->wake_at) {
+        link = &(*link)->sleep_next;
+    }
+    process->sleep_next = *link;
+    *link = process;
+}
+
+static void sleep_queue_remove(process_t* process) {
+    process_t** link = &sleep_queue;
+    while (*link != NULL && *link != process) {
+        link = &(*link)->sleep_next;
+    }
+    if (*link != NULL) *link = process->sleep_next;
+    process->sleep_next = NULL;
+}
+
+// Highest priority ready process, found with one bit scan
+process_t* process_pick_next(void) {
+    uint32_t level = bit_last_set(run_bitmap);
+    return level < PRIORITY_LEVELS ? run_queues[level] : NULL;
+}
+
+// Thread whose stack is in use
+static inline thread_t* process_current_thread(void) {
+    return current_process != NULL ? current_process->thread : &idle_thread;
+}
+
+// #NM handler: hand the FPU to the current thread
+void process_handle_fpu_fault(void) {
+    fpu_set_trap(false);
+    thread_t* thread = process_current_thread();
+    if (fpu_owner == thread) return;
+
+    if (fpu_owner != NULL) {
+        if (fpu_fxsr) cpu_fxsave(FPU_STATE_AREA(fpu_owner));
+        else cpu_fnsave(FPU_STATE_AREA(fpu_owner));
+    }
+    fpu_owner = thread;
+
+    // First use starts from a clean FPU
+    if (thread->fpu_state == NULL) {
+        thread->fpu_state = slab_cache_alloc(fpu_cache);
+        if (thread->fpu_state == NULL) {
+            kernel_panic("out of memory for FPU state");
         }
+        cpu_fpu_reset(fpu_fxsr);
+    } else if (fpu_fxsr) {
+        cpu_fxrstor(FPU_STATE_AREA(thread));
+    } else {
+        cpu_frstor(FPU_STATE_AREA(thread));
+    }
+}
+
+// Drop the FPU state of a thread that is going away
+static void fpu_release(thread_t* thread) {
+    if (fpu_owner == thread) fpu_owner = NULL;
+    if (thread->fpu_state != NULL) {
+        slab_cache_free(fpu_cache, thread->fpu_state);
+        thread->fpu_state = NULL;
     }
+}
+
+// Free the processes that exited before the last switch, now that their
+// stacks are no longer in use. process_terminate unlinks each one.
+static void process_reap(void) {
+    while (exited_processes != NULL) {
+        process_terminate(exited_processes->pid);
+    }
+}
+
+static void exit_list_remove(process_t* process) {
+    uint32_t flags = cpu_interrupts_save();
+    process_t** link = &exited_processes;
+    while (*link != NULL && *link != process) {
+        link = &(*link)->run_next;
+    }
+    if (*link != NULL) *link = process->run_next;
+    process->run_next = NULL;
+    cpu_interrupts_restore(flags);
+}
+
+// Earliest time the scheduler needs the timer: the first wake-up, or the
+// end of the running process's slice when another process of its level
+// is waiting for the CPU
+static uint64_t process_next_deadline(void) {
+    uint64_t deadline = sleep_queue != NULL ? sleep_queue->wake_at : TIMER_NEVER;
+    process_t* process = current_process;
+    if (process != NULL && process->state == PROC_RUNNING && run_bitmap != 0 &&
+        bit_last_set(run_bitmap) >= process_level(process) && process->slice_end < deadline) {
+        deadline = process->slice_end;
+    }
+    return deadline;
+}
+
+static inline void process_update_timer(void) {
+    timer_set_deadline(process_next_deadline());
+}
+
+// First code a new thread runs, entered from context_switch with
+// interrupts disabled. Also called by fork_return in switch.asm before a
+// forked child returns from process_fork.
+void process_enter(void) {
+    interrupt_depth = 0;
+    preempt_count = 0;
+    if (interrupt_is_enabled()) cpu_interrupts_enable();
+    process_reap();
+}
+
+static void process_start(void) {
+    process_enter();
+    ((void (*)(void))current_process->entry_point)();
+    process_exit(0);
+}
+
+// Build the frame context_switch pops on a fresh stack, so the first
+// switch to the thread returns into process_start with the stack aligned
+// as after a call. Returns the initial stack pointer.
+static uint32_t process_prepare_stack(uint32_t stack_top) {
+    uint32_t* frame = (uint32_t*)(stack_top & ~15u);
+    *--frame = 0;                         // Return address of process_start
+    *--frame = (uint32_t)process_start;
+    for (int i = 0; i < 4; i++) {
+        *--frame = 0;                     // EBP, EBX, ESI, EDI
+    }
+    return (uint32_t)frame;
+}
+
+// Switch stacks to next, or to the kernel main loop when next is NULL.
+// Returns once something switches back to the caller. Called with
+// interrupts disabled.
+static void process_switch(process_t* next) {
+    thread_t* from = process_current_thread();
+    thread_t* to = next != NULL ? next->thread : &idle_thread;
+    if (from == to) {
+        if (next != NULL) next->slice_end = time_get_current() + timer_get_quantum();
+        return;
+    }
+
+    // Handler depth and preemption count belong to the thread, a switch
+    // from inside a handler must not leave them raised for the next one
+    uint32_t depth = interrupt_depth;
+    uint32_t preempt = preempt_count;
+    preempt_pending = false;
+    process_set_current(next);
+    process_update_timer();
+    fpu_set_trap(fpu_owner != to);
+    context_switch(&from->stack_ptr, to->stack_ptr);
+    interrupt_depth = depth;
+    preempt_count = preempt;
+
+    // Resumed inside the timer handler the interrupted code may be
+    // halfway through the structures process_terminate changes
+    if (!interrupt_in_handler()) process_reap();
+}
+
+// Next free PID at or after the last one handed out. There are far more
+// PIDs than table slots, so one is always free once a slot is.
+static uint32_t process_next_pid(void) {
+    uint32_t pid = bitmap_find_next_zero(pid_bitmap, PID_LIMIT, next_pid);
+    if (pid == PID_LIMIT) pid = bitmap_find_first_zero(pid_bitmap, PID_LIMIT);
+    return pid;
+}
+
+// Enter a fully built process in the table and the PID index
+static void process_insert(uint32_t slot, process_t* process) {
+    process_table[slot] = process;
+    bitmap_set(slot_bitmap, slot);
+    bitmap_set(pid_bitmap, process->pid);
+    next_pid = process->pid + 1;
+    hash_map_put(&pid_map, HASH_MAP_ID(process->pid), process);
+    if (process->state == PROC_READY) {
+        uint32_t flags = cpu_interrupts_save();
+        run_queue_add(process);
+        process_update_timer();
+        cpu_interrupts_restore(flags);
+    }
+}
 
-    if (slot == -1) {
+// Body of process_create, runs with preemption disabled
+static error_t process_construct(const char* name, void* entry_point, uint32_t priority) {
+    // Find free slot in process table
+    uint32_t slot = bitmap_find_first_zero(slot_bitmap, MAX_PROCESSES);
+    if (slot == MAX_PROCESSES) {
         return ERR_OUT_OF_MEMORY;
     }
 
     // Allocate process structure
-    process_t* process = (process_t*)memory_alloc(sizeof(process_t));
+    process_t* process = (process_t*)slab_cache_alloc(process_cache);
     if (process == NULL) {
         return ERR_OUT_OF_MEMORY;
     }
 
     // Initialize process
-    process->pid = next_pid++;
+    process->pid = process_next_pid();
     strncpy(process->name, name, MAX_NAME_LENGTH - 1);
     process->name[MAX_NAME_LENGTH - 1] = '\0';
     process->state = PROC_READY;
     process->priority = priority;
     process->entry_point = entry_point;
-    process->stack_ptr = 0;
     process->stack_size = DEFAULT_STACK_SIZE;
-    process->heap_ptr = 0;
+    process->heap_ptr = USER_HEAP_START;
     process->heap_size = 0;
     process->parent_pid = 0;
     process->exit_code = 0;
     process->cpu_time = 0;
+    process->cpu_time_ns = 0;
+    process->scheduled_at = 0;
     process->memory_usage = 0;
-    process->creation_time = 0; // TODO: Implement system time
+    process->minor_faults = 0;
+    process->creation_time = time_get_unix();
+
+    // Private address space for the user heap
+    process->page_directory = paging_create_directory();
+    if (process->page_directory == 0) {
+        slab_cache_free(process_cache, process);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    // Reserve the stack and back it right away: a page fault on the stack
+    // a handler would run on cannot be delivered
+    void* stack = vm_reserve(DEFAULT_STACK_SIZE, PAGE_WRITABLE);
+    if (stack == NULL) {
+        paging_destroy_directory(process->page_directory);
+        slab_cache_free(process_cache, process);
+        return ERR_OUT_OF_MEMORY;
+    }
+    memset(stack, 0, DEFAULT_STACK_SIZE);
+    process->stack_ptr = (uint32_t)stack + DEFAULT_STACK_SIZE;
 
     // Create main thread
-    process->thread = (thread_t*)memory_alloc(sizeof(thread_t));
+    process->thread = (thread_t*)slab_cache_alloc(thread_cache);
     if (process->thread == NULL) {
-        memory_free(process);
+        vm_release(stack);
+        paging_destroy_directory(process->page_directory);
+        slab_cache_free(process_cache, process);
         return ERR_OUT_OF_MEMORY;
     }
 
     // Initialize thread
     process->thread->tid = 1;
     process->thread->pid = process->pid;
-    process->thread->stack_ptr = 0;
+    process->thread->stack_ptr = process_prepare_stack(process->stack_ptr);
     process->thread->stack_size = DEFAULT_STACK_SIZE;
     process->thread->priority = priority;
     process->thread->is_main = true;
+    process->thread->fpu_state = NULL;
 
     // Add to process table
-    process_table[slot] = process;
+    process_insert(slot, process);
 
     return ERR_NONE;
 }
 
-// Terminate a process
-error_t process_terminate(uint32_t pid) {
-    // Find process
-    process_t* process = NULL;
-    int slot = -1;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i] != NULL && process_table[i]->pid == pid) {
-            process = process_table[i];
-            slot = i;
-            break;
+// Create a new process
+error_t process_create(const char* name, void* entry_point, uint32_t priority) {
+    preempt_disable();
+    error_t error = process_construct(name, entry_point, priority);
+    preempt_enable();
+    return error;
+}
+
+// Body of process_fork, runs with preemption disabled
+static error_t process_clone(process_t* parent, const fork_frame_t* frame, uint32_t* child_pid) {
+    uint32_t slot = bitmap_find_first_zero(slot_bitmap, MAX_PROCESSES);
+    if (slot == MAX_PROCESSES) {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    process_t* child = (process_t*)slab_cache_alloc(process_cache);
+    if (child == NULL) {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    *child = *parent;
+    child->pid = process_next_pid();
+    child->state = PROC_READY;
+    child->sleep_next = NULL;
+    child->parent_pid = parent->pid;
+    child->exit_code = 0;
+    child->cpu_time = 0;
+    child->cpu_time_ns = 0;
+    child->minor_faults = 0;
+    child->creation_time = time_get_unix();
+
+    child->page_directory = paging_clone_directory(parent->page_directory);
+    if (child->page_directory == 0) {
+        slab_cache_free(process_cache, child);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    uint32_t parent_stack = parent->stack_ptr - parent->stack_size;
+    void* stack = vm_reserve(parent->stack_size, PAGE_WRITABLE);
+    if (stack == NULL) {
+        paging_destroy_directory(child->page_directory);
+        slab_cache_free(process_cache, child);
+        return ERR_OUT_OF_MEMORY;
+    }
+    for (uint32_t offset = 0; offset < parent->stack_size; offset += PAGE_SIZE) {
+        if (paging_get_physical(parent_stack + offset) != 0) {
+            memcpy((uint8_t*)stack + offset, (void*)(parent_stack + offset), PAGE_SIZE);
+        } else {
+            memset((uint8_t*)stack + offset, 0, PAGE_SIZE);
+        }
+    }
+    child->stack_ptr = (uint32_t)stack + parent->stack_size;
+
+    child->thread = (thread_t*)slab_cache_alloc(thread_cache);
+    if (child->thread == NULL) {
+        vm_release(stack);
+        paging_destroy_directory(child->page_directory);
+        slab_cache_free(process_cache, child);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    // The saved frame pointers in the copy still point into the parent's
+    // stack. Walk the chain from the caller of process_fork to the first
+    // frame outside the stack, the zero process_prepare_stack left, and
+    // move each link into the copy.
+    uint32_t delta = child->stack_ptr - parent->stack_ptr;
+    uint32_t caller_frame = *(uint32_t*)frame->base;
+    for (uint32_t link = caller_frame; link >= parent_stack && link < parent->stack_ptr; ) {
+        uint32_t* saved = (uint32_t*)(link + delta);
+        if (*saved <= link || *saved >= parent->stack_ptr) break;
+        link = *saved;
+        *saved = link + delta;
+    }
+    if (caller_frame >= parent_stack && caller_frame < parent->stack_ptr) {
+        caller_frame += delta;
+    }
+
+    // Resume the child as if process_fork returned: context_switch pops
+    // the caller's registers and returns into fork_return, right below
+    // the copied return address of process_fork
+    uint32_t* resume = (uint32_t*)(frame->base + delta) - 4;
+    resume[0] = frame->edi;
+    resume[1] = frame->esi;
+    resume[2] = frame->ebx;
+    resume[3] = caller_frame;
+    resume[4] = (uint32_t)fork_return;
+
+    *child->thread = *parent->thread;
+    child->thread->pid = child->pid;
+    child->thread->stack_ptr = (uint32_t)resume;
+    child->thread->stack_size = parent->stack_size;
+    child->thread->fpu_state = NULL;
+
+    // The child's copy of the PID reads 0, the parent's the child's PID
+    if (child_pid != NULL) {
+        if ((uint32_t)child_pid >= parent_stack && (uint32_t)child_pid < parent->stack_ptr) {
+            *(uint32_t*)((uint32_t)child_pid + delta) = 0;
         }
+        *child_pid = child->pid;
+    }
+
+    process_insert(slot, child);
+    return ERR_NONE;
+}
+
+// Fork the running process; both parent and child return from here, the
+// child finds 0 in *child_pid. The child shares every user page with the
+// parent copy-on-write, so the cost is the page-table copy rather than
+// the memory itself. The kernel stack is copied eagerly with its frame
+// pointer chain moved into the copy, which needs the frame pointers the
+// kernel is built with. Other pointers to stack data are not moved, so
+// the caller must not reach its locals through them in the child. Only
+// the current process can fork, outside handlers and with preemption on.
+error_t process_fork(process_t* parent, uint32_t* child_pid) {
+    fork_frame_t frame;
+    __asm__ volatile("mov %%ebx, %0\n\t"
+                     "mov %%esi, %1\n\t"
+                     "mov %%edi, %2"
+                     : "=m"(frame.ebx), "=m"(frame.esi), "=m"(frame.edi));
+    frame.base = (uint32_t)__builtin_frame_address(0);
+
+    if (parent == NULL) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    if (parent != current_process || preempt_count != 0 || interrupt_in_handler()) {
+        return ERR_INVALID_OPERATION;
     }
 
+    preempt_disable();
+    error_t error = process_clone(parent, &frame, child_pid);
+    preempt_enable();
+    return error;
+}
+
+// Terminate a process
+error_t process_terminate(uint32_t pid) {
+    // Find process
+    preempt_disable();
+    process_t* process = hash_map_get(&pid_map, HASH_MAP_ID(pid));
     if (process == NULL) {
+        preempt_enable();
         return ERR_INVALID_ARGUMENT;
     }
 
+    // The running process is still on its stack; it is freed once the
+    // scheduler has switched away from it
+    if (process == current_process) {
+        process_exit(process->exit_code);
+    }
+    if (process->state == PROC_ZOMBIE) {
+        exit_list_remove(process);
+    }
+    hash_map_remove(&pid_map, HASH_MAP_ID(pid));
+
+    int slot = 0;
+    while (process_table[slot] != process) {
+        slot++;
+    }
+
     // Update process state
-    process->state = PROC_TERMINATED;
+    process_set_state(process, PROC_TERMINATED);
 
     // Free thread
     if (process->thread != NULL) {
-        memory_free(process->thread);
+        fpu_release(process->thread);
+        slab_cache_free(thread_cache, process->thread);
     }
 
-    // Free process
-    memory_free(process);
+    // Free stack, heap and process
+    vm_release((void*)(process->stack_ptr - process->stack_size));
+    paging_destroy_directory(process->page_directory);
+    slab_cache_free(process_cache, process);
     process_table[slot] = NULL;
+    bitmap_clear(slot_bitmap, slot);
+    bitmap_clear(pid_bitmap, pid);
+    preempt_enable();
 
     return ERR_NONE;
 }
 
+// End the current process. It becomes a zombie until the next process
+// has taken over the CPU, then process_reap frees it. Does not return.
+void process_exit(uint32_t exit_code) {
+    process_t* process = current_process;
+    if (process == NULL) return;
+
+    // A preemption between becoming a zombie and the switch would strand it
+    cpu_interrupts_disable();
+    process->exit_code = exit_code;
+    process_set_state(process, PROC_ZOMBIE);
+    process->run_next = exited_processes;
+    exited_processes = process;
+    process_schedule();
+}
+
 // Get process by PID
 process_t* process_get_by_pid(uint32_t pid) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i] != NULL && process_table[i]->pid == pid) {
-            return process_table[i];
-        }
-    }
-    return NULL;
+    return hash_map_get(&pid_map, HASH_MAP_ID(pid));
 }
 
 // Get current process
@@ -117,48 +612,225 @@ process_t* process_get_current(void) {
     return current_process;
 }
 
-// Set current process
+// Set current process and switch to its address space
 void process_set_current(process_t* process) {
+    // Charge the outgoing process for its time on the CPU
+    uint64_t now = time_get_current();
+    if (current_process != NULL && current_process != process) {
+        current_process->cpu_time_ns += now - current_process->scheduled_at;
+        current_process->cpu_time = time_ns_to_ms(current_process->cpu_time_ns);
+    }
+    if (process != NULL && process != current_process) {
+        process->scheduled_at = now;
+        process->slice_end = now + timer_get_quantum();
+    }
+
     current_process = process;
+    paging_switch_directory(process != NULL ? process->page_directory : 0);
 }
 
-// Schedule processes
-void process_schedule(void) {
-    // Find highest priority ready process
-    process_t* highest_priority = NULL;
-    int highest_priority_value = -1;
+// Current end of a process heap
+static inline uint32_t process_heap_break(const process_t* process) {
+    return process->heap_ptr + process->heap_size;
+}
 
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i] != NULL && 
-            process_table[i]->state == PROC_READY) {
-            if (process_table[i]->priority > highest_priority_value) {
-                highest_priority = process_table[i];
-                highest_priority_value = process_table[i]->priority;
-            }
+// Back a touched heap page of the current process with a zeroed frame.
+// Returns false when the address is outside the heap.
+bool process_handle_heap_fault(uint32_t address, uint32_t error_code) {
+    process_t* process = current_process;
+    if (process == NULL || (error_code & PAGE_FAULT_PRESENT)) return false;
+
+    uint32_t heap_end = (process_heap_break(process) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (address < process->heap_ptr || address >= heap_end) return false;
+
+    if (!vm_map_zero_page(address & ~(PAGE_SIZE - 1), PAGE_WRITABLE | PAGE_USER)) return false;
+    process->memory_usage += PAGE_SIZE;
+    return true;
+}
+
+// Move the heap break of a process. Growing only moves the break, the
+// pages are backed on first touch; shrinking frees whole pages at once,
+// in the address space of the process whether or not it is running, so
+// growing again later faults in fresh zero pages.
+bool process_set_break(process_t* process, uint32_t address) {
+    if (process == NULL || address < process->heap_ptr || address > USER_HEAP_END) {
+        return false;
+    }
+
+    uint32_t old_end = (process_heap_break(process) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t new_end = (address + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    if (new_end < old_end) {
+        // User lookups go through the active directory, so borrow the
+        // target's with interrupts off and hand the current one back
+        uint32_t flags = cpu_interrupts_save();
+        bool borrowed = process != current_process;
+        if (borrowed) paging_switch_directory(process->page_directory);
+
+        for (uint32_t page = new_end; page < old_end; page += PAGE_SIZE) {
+            uint32_t phys = paging_get_physical(page);
+            if (phys == 0) continue;
+            frame_free(phys & ~(PAGE_SIZE - 1), 0);
+            process->memory_usage -= PAGE_SIZE;
+        }
+        paging_unmap_range(new_end, (old_end - new_end) / PAGE_SIZE);
+
+        if (borrowed) {
+            paging_switch_directory(current_process != NULL ? current_process->page_directory : 0);
         }
+        cpu_interrupts_restore(flags);
     }
 
-    // Switch to highest priority process
-    if (highest_priority != NULL) {
-        // TODO: Implement context switch
-        highest_priority->state = PROC_RUNNING;
+    process->heap_size = address - process->heap_ptr;
+    return true;
+}
+
+// SYS_BRK: set the break, returns the resulting break
+static uint32_t process_sys_brk(uint32_t address, uint32_t unused1, uint32_t unused2) {
+    (void)unused1;
+    (void)unused2;
+    process_t* process = current_process;
+    if (process == NULL) return 0;
+
+    process_set_break(process, address);
+    return process_heap_break(process);
+}
+
+// SYS_SBRK: move the break by a signed increment, returns the old break
+// or (uint32_t)-1 on failure
+static uint32_t process_sys_sbrk(uint32_t increment, uint32_t unused1, uint32_t unused2) {
+    (void)unused1;
+    (void)unused2;
+    process_t* process = current_process;
+    if (process == NULL) return (uint32_t)-1;
+
+    uint32_t old_break = process_heap_break(process);
+    int32_t delta = (int32_t)increment;
+    uint32_t new_break = old_break + (uint32_t)delta;
+    if ((delta > 0 && new_break < old_break) || (delta < 0 && new_break > old_break)) {
+        return (uint32_t)-1;
     }
+    if (!process_set_break(process, new_break)) return (uint32_t)-1;
+    return old_break;
 }
 
-// Process state management
+// Give the CPU to the highest priority ready process. The running
+// process keeps it against lower priorities only, so processes of equal
+// priority take turns in round-robin order.
+void process_schedule(void) {
+    uint32_t flags = cpu_interrupts_save();
+    process_t* next = process_pick_next();
+    process_t* previous = current_process;
+    if (previous != NULL && previous->state == PROC_RUNNING) {
+        if (next == NULL || process_level(previous) > process_level(next)) {
+            cpu_interrupts_restore(flags);
+            return;
+        }
+        process_set_state(previous, PROC_READY);
+    } else if (previous == NULL && next == NULL) {
+        cpu_interrupts_restore(flags);
+        return;
+    }
+
+    // With nothing ready a blocked or exited process hands the CPU back
+    // to the kernel main loop
+    if (next != NULL) {
+        process_set_state(next, PROC_RUNNING);
+    }
+    process_switch(next);
+    cpu_interrupts_restore(flags);
+}
+
+// Timer interrupt: wake the sleepers that are due, then preempt the
+// running process if its slice is over or a woken process outranks it.
+// Inside a preempt_disable section the switch waits for preempt_enable.
+void process_handle_timer(uint64_t now) {
+    while (sleep_queue != NULL && sleep_queue->wake_at <= now) {
+        process_set_state(sleep_queue, PROC_READY);
+    }
+
+    process_t* process = current_process;
+    process_t* next = process_pick_next();
+    bool preempt;
+    if (process == NULL || process->state != PROC_RUNNING) {
+        preempt = next != NULL;
+    } else {
+        preempt = next != NULL && (now >= process->slice_end ||
+                                   process_level(next) > process_level(process));
+    }
+
+    if (preempt && preempt_count == 0) {
+        process_schedule();
+    } else if (preempt) {
+        preempt_pending = true;
+    }
+    process_update_timer();
+}
+
+// Preemption that came due inside a preempt_disable section
+void process_preempt(void) {
+    if (interrupt_in_handler()) return;
+    preempt_pending = false;
+    process_schedule();
+}
+
+// Block the current process until deadline, in time_get_current
+// nanoseconds. Fails outside a process, inside a handler or without the
+// timer to wake it; the caller has to wait some other way then.
+bool process_sleep_until(uint64_t deadline) {
+    process_t* process = current_process;
+    if (process == NULL || interrupt_in_handler() || !timer_is_enabled()) return false;
+
+    uint32_t flags = cpu_interrupts_save();
+    if (deadline > time_get_current()) {
+        process_set_state(process, PROC_SLEEPING);
+        process->wake_at = deadline;
+        sleep_queue_add(process);
+        process_schedule();
+    }
+    cpu_interrupts_restore(flags);
+    return true;
+}
+
+// Kernel main loop with nothing to run: halt until the next deadline or
+// interrupt instead of spinning. The run queues are checked with
+// interrupts off, so a wake-up cannot slip in before the HLT.
+void process_idle(void) {
+    uint32_t flags = cpu_interrupts_save();
+    if ((flags & EFLAGS_IF) && process_pick_next() == NULL) {
+        timer_idle(process_next_deadline());
+    }
+    cpu_interrupts_restore(flags);
+}
+
+// Process state management, keeps the run and sleep queues in step.
+// The timer interrupt changes states too.
 void process_set_state(process_t* process, process_state_t state) {
-    if (process != NULL) {
-        process->state = state;
+    if (process == NULL || process->state == state) return;
+
+    uint32_t flags = cpu_interrupts_save();
+    if (process->state == PROC_READY) run_queue_remove(process);
+    else if (process->state == PROC_SLEEPING) sleep_queue_remove(process);
+    process->state = state;
+    if (state == PROC_READY) {
+        run_queue_add(process);
+        process_update_timer();
     }
+    cpu_interrupts_restore(flags);
 }
 
 // Set process priority
 void process_set_priority(process_t* process, uint32_t priority) {
     if (process != NULL) {
+        uint32_t flags = cpu_interrupts_save();
+        bool queued = process->state == PROC_READY;
+        if (queued) run_queue_remove(process);
         process->priority = priority;
+        if (queued) run_queue_add(process);
         if (process->thread != NULL) {
             process->thread->priority = priority;
         }
+        cpu_interrupts_restore(flags);
     }
 }
 
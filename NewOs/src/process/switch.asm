@@ -0,0 +1,37 @@
+; Kernel context switch
+[BITS 32]
+
+global context_switch
+global fork_return
+
+extern process_enter
+
+section .text
+
+; void context_switch(uint32_t* save_stack, uint32_t load_stack)
+; Push the callee-saved registers, store the stack pointer in
+; *save_stack, then continue on load_stack, which holds the same frame
+; built by an earlier switch or by process_prepare_stack. Everything
+; else is caller-saved and already spilled by the C caller.
+context_switch:
+    mov eax, [esp + 4]          ; save_stack
+    mov edx, [esp + 8]          ; load_stack
+    push ebp
+    push ebx
+    push esi
+    push edi
+    mov [eax], esp
+    mov esp, edx
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
+
+; First code a forked child runs. process_clone left the stack as it was
+; when the parent entered process_fork, with context_switch's frame in
+; place of process_fork's own; return to the caller with ERR_NONE.
+fork_return:
+    call process_enter
+    xor eax, eax
+    ret
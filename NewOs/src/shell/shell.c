@@ -1,14 +1,26 @@
 #include "../include/kernel.h"
+#include <bench.h>
+#include <hashmap.h>
+#include <memory.h>
 #include <string.h>
+#include <utils.h>
 
 // Shell structures
 static shell_t* current_shell = NULL;
 static command_t* command_table[MAX_COMMANDS];
 static uint32_t next_command_id = 1;
+static slab_cache_t* command_cache = NULL;
+
+// Name index, keys point at command->name
+static hash_map_entry_t command_name_entries[HASH_MAP_CAPACITY(MAX_COMMANDS)];
+static hash_map_t command_names;
 
 // Initialize shell system
 void shell_init(void) {
     memset(command_table, 0, sizeof(command_table));
+    hash_map_init(&command_names, command_name_entries, HASH_MAP_CAPACITY(MAX_COMMANDS),
+                  hash_map_hash_string, hash_map_equals_string);
+    command_cache = slab_cache_create("command", sizeof(command_t), NULL);
     current_shell = NULL;
 }
 
@@ -71,7 +83,7 @@ bool shell_register_command(const char* name, command_handler_t handler, const c
     if (slot == -1) return false; // No free slots
 
     // Allocate command structure
-    command_t* command = (command_t*)memory_alloc(sizeof(command_t));
+    command_t* command = (command_t*)slab_cache_alloc(command_cache);
     if (command == NULL) return false;
 
     // Initialize command
@@ -82,21 +94,31 @@ bool shell_register_command(const char* name, command_handler_t handler, const c
     strncpy(command->description, description, MAX_DESCRIPTION_LENGTH - 1);
     command->description[MAX_DESCRIPTION_LENGTH - 1] = '\0';
 
-    // Add to command table
+    // Add to command table, an earlier command with the same name wins
     command_table[slot] = command;
+    if (hash_map_get(&command_names, command->name) == NULL) {
+        hash_map_put(&command_names, command->name, command);
+    }
 
     return true;
 }
 
 // Unregister a command
 void shell_unregister_command(const char* name) {
+    if (name == NULL) return;
+    command_t* command = hash_map_remove(&command_names, name);
+    if (command == NULL) return;
+
+    // Drop it from the table and let a shadowed command take the name
     for (int i = 0; i < MAX_COMMANDS; i++) {
-        if (command_table[i] != NULL && strcmp(command_table[i]->name, name) == 0) {
-            memory_free(command_table[i]);
+        if (command_table[i] == command) {
             command_table[i] = NULL;
-            break;
+        } else if (command_table[i] != NULL && strcmp(command_table[i]->name, command->name) == 0 &&
+                   hash_map_get(&command_names, command->name) == NULL) {
+            hash_map_put(&command_names, command_table[i]->name, command_table[i]);
         }
     }
+    slab_cache_free(command_cache, command);
 }
 
 // Execute a command
@@ -112,21 +134,20 @@ bool shell_execute_command(shell_t* shell, const char* command_line) {
         }
     }
 
-    // Parse command
-    char command_name[MAX_NAME_LENGTH];
+    // Parse command in a stack copy, args point into it
+    char line[MAX_COMMAND_LINE];
     char* args[MAX_ARGS];
-    int arg_count = 0;
+    strncpy(line, command_line, MAX_COMMAND_LINE - 1);
+    line[MAX_COMMAND_LINE - 1] = '\0';
 
-    // TODO: Implement command parsing
+    int arg_count = string_split_args(line, args, MAX_ARGS);
+    if (arg_count == 0) return false;
+    const char* command_name = args[0];
 
     // Find and execute command
-    for (int i = 0; i < MAX_COMMANDS; i++) {
-        if (command_table[i] != NULL && strcmp(command_table[i]->name, command_name) == 0) {
-            return command_table[i]->handler(shell, arg_count, args);
-        }
-    }
-
-    return false;
+    command_t* command = hash_map_get(&command_names, command_name);
+    if (command == NULL) return false;
+    return command->handler(shell, arg_count, args);
 }
 
 // Set shell prompt
@@ -185,12 +206,8 @@ void shell_list_commands(command_t** list, int* count) {
 
 // Get command by name
 command_t* shell_get_command_by_name(const char* name) {
-    for (int i = 0; i < MAX_COMMANDS; i++) {
-        if (command_table[i] != NULL && strcmp(command_table[i]->name, name) == 0) {
-            return command_table[i];
-        }
-    }
-    return NULL;
+    if (name == NULL) return NULL;
+    return hash_map_get(&command_names, name);
 }
 
 // Get command by ID
@@ -270,4 +287,262 @@ bool shell_command_clear(shell_t* shell, int argc, char** argv) {
 bool shell_command_exit(shell_t* shell, int argc, char** argv) {
     // TODO: Implement exit command
     return true;
-} 
\ No newline at end of file
+}
+
+// Write an unsigned number in decimal or hexadecimal
+static void shell_write_number(uint32_t value, uint32_t base) {
+    char buffer[12];
+    int position = sizeof(buffer) - 1;
+    buffer[position] = '\0';
+    do {
+        buffer[--position] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value != 0);
+    if (base == 16) {
+        buffer[--position] = 'x';
+        buffer[--position] = '0';
+    }
+    terminal_writestring(&buffer[position]);
+}
+
+// memstat [on|off|log]: heap usage, fragmentation and traced call sites
+bool shell_command_memstat(shell_t* shell, int argc, char** argv) {
+    (void)shell;
+
+    if (argc > 1 && strcmp(argv[1], "on") == 0) {
+        memtrace_enable(true);
+        return true;
+    }
+    if (argc > 1 && strcmp(argv[1], "off") == 0) {
+        memtrace_enable(false);
+        return true;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "log") == 0) {
+        memtrace_event_t events[16];
+        uint32_t count = memtrace_get_events(events, 16);
+        for (uint32_t i = 0; i < count; i++) {
+            shell_write_number(time_ns_to_ms(events[i].timestamp), 10);
+            terminal_writestring(" ms");
+            terminal_writestring(events[i].is_free ? " free  " : " alloc ");
+            shell_write_number((uint32_t)events[i].ptr, 16);
+            terminal_writestring(" ");
+            shell_write_number(events[i].size, 10);
+            terminal_writestring(" from ");
+            shell_write_number((uint32_t)events[i].site, 16);
+            terminal_writestring("\n");
+        }
+        return true;
+    }
+
+    size_t total, used, free;
+    memory_stats(&total, &used, &free);
+    terminal_writestring("heap: ");
+    shell_write_number(used, 10);
+    terminal_writestring(" used, ");
+    shell_write_number(free, 10);
+    terminal_writestring(" free of ");
+    shell_write_number(total, 10);
+    terminal_writestring(" bytes, fragmentation ");
+    shell_write_number(memory_fragmentation(), 10);
+    terminal_writestring("%\n");
+
+    if (!memtrace_is_enabled()) {
+        terminal_writestring("tracing off, 'memstat on' to start\n");
+        return true;
+    }
+
+    memtrace_site_t sites[16];
+    uint32_t count = memtrace_get_sites(sites, 16);
+    terminal_writestring("site        live bytes  live  total  oldest ms\n");
+    for (uint32_t i = 0; i < count; i++) {
+        shell_write_number((uint32_t)sites[i].site, 16);
+        terminal_writestring("  ");
+        shell_write_number(sites[i].live_bytes, 10);
+        terminal_writestring("  ");
+        shell_write_number(sites[i].live_count, 10);
+        terminal_writestring("  ");
+        shell_write_number(sites[i].total_count, 10);
+        terminal_writestring("  ");
+        shell_write_number(sites[i].oldest_age, 10);
+        terminal_writestring("\n");
+    }
+    if (memtrace_dropped() > 0) {
+        shell_write_number(memtrace_dropped(), 10);
+        terminal_writestring(" allocations not tracked\n");
+    }
+    return true;
+}
+
+// dmesg [debug]: print the kernel log ring, oldest record first
+bool shell_command_dmesg(shell_t* shell, int argc, char** argv) {
+    (void)shell;
+
+    if (argc > 1 && strcmp(argv[1], "debug") == 0) {
+        log_set_level(LOG_DEBUG);
+        return true;
+    }
+
+    log_cursor_t cursor;
+    log_record_t record;
+    char line[160];
+    log_cursor_init(&cursor);
+    while (log_read(&cursor, &record)) {
+        log_format(&record, line, sizeof(line));
+        terminal_writestring(line);
+        terminal_writestring("\n");
+    }
+    if (cursor.lost > 0) {
+        shell_write_number(cursor.lost, 10);
+        terminal_writestring(" records overwritten while reading\n");
+    }
+    return true;
+}
+
+// Parse a decimal integer with an optional sign, the whole string must match
+static bool shell_parse_int(const char* text, int* value) {
+    bool negative = *text == '-';
+    if (negative) text++;
+    if (*text == '\0') return false;
+
+    uint32_t result = 0;
+    for (; *text != '\0'; text++) {
+        if (*text < '0' || *text > '9') return false;
+        result = result * 10 + (*text - '0');
+        if (result > 0x80000000u) return false;
+    }
+    if (!negative && result == 0x80000000u) return false;
+    *value = negative ? -(int)(result - 1) - 1 : (int)result;
+    return true;
+}
+
+// config [set key value | save file | load file]: show or change settings
+bool shell_command_config(shell_t* shell, int argc, char** argv) {
+    (void)shell;
+
+    if (argc == 4 && strcmp(argv[1], "set") == 0) {
+        // A key keeps its type; new keys take the type the value looks like
+        const config_entry_t* entry = config_intern(argv[2]);
+        if (entry == NULL) {
+            terminal_writestring("config: store full or key too long\n");
+            return false;
+        }
+
+        int number;
+        bool is_true = strcmp(argv[3], "true") == 0;
+        bool is_bool = is_true || strcmp(argv[3], "false") == 0;
+        bool is_int = shell_parse_int(argv[3], &number);
+        bool set;
+        if (entry->type == CONFIG_BOOL || (entry->type == CONFIG_NONE && is_bool)) {
+            set = is_bool && config_set_bool(argv[2], is_true);
+        } else if (entry->type == CONFIG_INT || (entry->type == CONFIG_NONE && is_int)) {
+            set = is_int && config_set_int(argv[2], number);
+        } else {
+            set = config_set_string(argv[2], argv[3]);
+        }
+        if (!set) terminal_writestring("config: invalid value\n");
+        return set;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "save") == 0) {
+        if (config_save(argv[2])) return true;
+        terminal_writestring("config: save failed\n");
+        return false;
+    }
+    if (argc == 3 && strcmp(argv[1], "load") == 0) {
+        if (config_load(argv[2])) return true;
+        terminal_writestring("config: not a valid snapshot\n");
+        return false;
+    }
+    if (argc > 1) {
+        terminal_writestring("usage: config [set key value | save file | load file]\n");
+        return false;
+    }
+
+    const config_entry_t* entry;
+    for (uint32_t i = 0; (entry = config_get_entry(i)) != NULL; i++) {
+        if (entry->type == CONFIG_NONE) continue;
+
+        terminal_writestring(entry->key);
+        terminal_writestring(" = ");
+        if (entry->type == CONFIG_INT) {
+            uint32_t number = entry->value.number;
+            if (entry->value.number < 0) {
+                terminal_writestring("-");
+                number = -number;
+            }
+            shell_write_number(number, 10);
+        } else if (entry->type == CONFIG_BOOL) {
+            terminal_writestring(entry->value.flag ? "true" : "false");
+        } else {
+            terminal_writestring(entry->value.string);
+        }
+        terminal_writestring("\n");
+    }
+    return true;
+}
+
+// bench [save] [name]: time the built-in benchmarks in cycles per call,
+// with throughput where it applies, and compare the medians with the
+// baselines kept in the configuration store
+bool shell_command_bench(shell_t* shell, int argc, char** argv) {
+    (void)shell;
+
+    int arg = 1;
+    bool save = argc > arg && strcmp(argv[arg], "save") == 0;
+    if (save) arg++;
+    const char* only = argc > arg ? argv[arg] : NULL;
+
+    bool found = false;
+    for (uint32_t i = 0; i < bench_count(); i++) {
+        const char* name = bench_name(i);
+        if (only != NULL && strcmp(name, only) != 0) continue;
+        found = true;
+
+        bench_result_t result;
+        if (!bench_run(i, &result)) {
+            terminal_writestring("bench: no time stamp counter\n");
+            return false;
+        }
+
+        char key[CONFIG_MAX_KEY + 1] = "bench.";
+        strncat(key, name, CONFIG_MAX_KEY - strlen(key));
+        uint32_t previous = config_get_int(key) > 0 ? (uint32_t)config_get_int(key) : 0;
+
+        terminal_writestring(name);
+        terminal_writestring(": median ");
+        shell_write_number(result.median, 10);
+        terminal_writestring(", p99 ");
+        shell_write_number(result.p99, 10);
+        terminal_writestring(", min ");
+        shell_write_number(result.min, 10);
+
+        // Bytes per thousand cycles times MHz, which stays within 32 bits
+        uint32_t bytes = bench_bytes(i);
+        uint32_t mhz = time_get_tsc_khz() / 1000;
+        if (bytes != 0 && result.median != 0 && mhz != 0) {
+            terminal_writestring(", ");
+            shell_write_number(bytes * 1000 / result.median * mhz / 1000, 10);
+            terminal_writestring(" MB/s");
+        }
+        if (previous > 0) {
+            bool faster = result.median < previous;
+            uint32_t change = faster ? previous - result.median : result.median - previous;
+            change = change < 0x1000000 ? change * 100 / previous : change / previous * 100;
+            terminal_writestring(", baseline ");
+            shell_write_number(previous, 10);
+            terminal_writestring(faster ? " (-" : " (+");
+            shell_write_number(change, 10);
+            terminal_writestring("%)");
+        }
+        terminal_writestring("\n");
+
+        if (save) config_set_int(key, result.median);
+    }
+
+    if (!found) {
+        terminal_writestring("bench: unknown benchmark\n");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,567 @@
+#include "../include/kernel.h"
+#include <bench.h>
+#include <bitops.h>
+#include <cpu.h>
+#include <memory.h>
+#include <process.h>
+#include <string.h>
+#include <utils.h>
+
+#define BENCH_BUFFER_SIZE 4096
+#define BENCH_TLB_PAGES   ((KERNEL_HEAP_END - KERNEL_HEAP_START) / PAGE_SIZE)
+
+static uint32_t bench_samples[BENCH_SAMPLES];
+static uint32_t bench_overhead = 0;
+static bool bench_calibrated = false;
+
+// Cycles taken by batch calls of fn, saturated to 32 bits
+static uint32_t bench_time_batch(bench_fn_t fn, uint32_t batch) {
+    uint32_t flags = cpu_interrupts_save();
+    uint64_t start = cpu_rdtsc();
+    for (uint32_t i = 0; i < batch; i++) {
+        fn();
+    }
+    uint64_t elapsed = cpu_rdtsc() - start;
+    cpu_interrupts_restore(flags);
+    return elapsed >> 32 ? 0xFFFFFFFF : (uint32_t)elapsed;
+}
+
+// Collect sorted per-call samples, without overhead correction
+static void bench_sample(bench_fn_t fn, bench_result_t* result) {
+    uint32_t batch = 1;
+    while (batch < BENCH_MAX_BATCH && bench_time_batch(fn, batch) < BENCH_SAMPLE_CYCLES) {
+        batch *= 2;
+    }
+
+    // Insertion sort as the samples arrive, the array is small
+    for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+        uint32_t cycles = bench_time_batch(fn, batch) / batch;
+        uint32_t position = i;
+        while (position > 0 && bench_samples[position - 1] > cycles) {
+            bench_samples[position] = bench_samples[position - 1];
+            position--;
+        }
+        bench_samples[position] = cycles;
+    }
+
+    result->batch = batch;
+    result->min = bench_samples[0];
+    result->median = bench_samples[BENCH_SAMPLES / 2];
+    result->p99 = bench_samples[(BENCH_SAMPLES * 99 + 99) / 100 - 1];
+}
+
+static void bench_empty(void) {
+    __asm__ volatile("" ::: "memory");
+}
+
+static inline uint32_t bench_subtract(uint32_t cycles) {
+    return cycles > bench_overhead ? cycles - bench_overhead : 0;
+}
+
+// Measure fn; fails when the CPU has no TSC
+bool bench_measure(bench_fn_t fn, bench_result_t* result) {
+    if (fn == NULL || result == NULL || !cpu_has_feature_edx(CPUID_EDX_TSC)) return false;
+
+    if (!bench_calibrated) {
+        bench_result_t empty;
+        bench_sample(bench_empty, &empty);
+        bench_overhead = empty.min;
+        bench_calibrated = true;
+    }
+
+    bench_sample(fn, result);
+    result->min = bench_subtract(result->min);
+    result->median = bench_subtract(result->median);
+    result->p99 = bench_subtract(result->p99);
+    return true;
+}
+
+// Built-in benchmarks share these buffers
+static uint8_t bench_source[BENCH_BUFFER_SIZE] __attribute__((aligned(16)));
+static uint8_t bench_target[BENCH_BUFFER_SIZE * 2] __attribute__((aligned(16)));
+static uint32_t bench_bitmap[BITMAP_WORDS(BENCH_BUFFER_SIZE)];
+static char bench_hex[BENCH_BUFFER_SIZE + 1];
+static char bench_base64_text[BENCH_BUFFER_SIZE + 1];
+static uint16_t bench_tlb_order[BENCH_TLB_PAGES];
+static bool bench_ready = false;
+
+static void bench_setup(void) {
+    for (uint32_t i = 0; i < BENCH_BUFFER_SIZE; i++) {
+        bench_source[i] = 'a' + i % 26;
+    }
+    bench_source[255] = '\0';
+    bitmap_set_range(bench_bitmap, 0, BENCH_BUFFER_SIZE - 1);
+    hex_encode(bench_source, BENCH_BUFFER_SIZE / 2, bench_hex);
+    base64_encode(bench_source, BENCH_BUFFER_SIZE / 4 * 3, bench_base64_text);
+
+    // Fixed shuffle of the heap pages, the same for every run
+    random_state_t random;
+    random_seed(&random, 0x71B);
+    for (uint32_t i = 0; i < BENCH_TLB_PAGES; i++) {
+        uint32_t j = random_next_bounded(&random, i + 1);
+        bench_tlb_order[i] = bench_tlb_order[j];
+        bench_tlb_order[j] = i;
+    }
+    bench_ready = true;
+}
+
+static void bench_memcpy(void) {
+    memcpy(bench_target, bench_source, BENCH_BUFFER_SIZE);
+}
+
+static void bench_memset(void) {
+    memset(bench_target, 0, BENCH_BUFFER_SIZE);
+}
+
+static void bench_strlen(void) {
+    strlen((const char*)bench_source);
+}
+
+static void bench_crc32(void) {
+    crc32(bench_source, BENCH_BUFFER_SIZE);
+}
+
+static void bench_crc32c(void) {
+    crc32c(bench_source, BENCH_BUFFER_SIZE);
+}
+
+static void bench_fnv1a(void) {
+    hash_fnv1a(bench_source, BENCH_BUFFER_SIZE);
+}
+
+static void bench_murmur3(void) {
+    hash_murmur3(bench_source, BENCH_BUFFER_SIZE);
+}
+
+static void bench_base64(void) {
+    base64_encode(bench_source, 3072, (char*)bench_target);
+}
+
+static void bench_base64_decode(void) {
+    base64_decode(bench_base64_text, bench_target);
+}
+
+static void bench_hex_encode(void) {
+    hex_encode(bench_source, BENCH_BUFFER_SIZE / 2, (char*)bench_target);
+}
+
+static void bench_hex_decode(void) {
+    hex_decode(bench_hex, bench_target);
+}
+
+// The same codec benchmarks on the scalar loops
+static bool bench_scalar(bench_fn_t fn, bench_result_t* result) {
+    codec_set_ssse3(false);
+    bool ok = bench_measure(fn, result);
+    codec_set_ssse3(true);
+    return ok;
+}
+
+static bool bench_base64_scalar(bench_result_t* result) {
+    return bench_scalar(bench_base64, result);
+}
+
+static bool bench_base64_decode_scalar(bench_result_t* result) {
+    return bench_scalar(bench_base64_decode, result);
+}
+
+static bool bench_hex_encode_scalar(bench_result_t* result) {
+    return bench_scalar(bench_hex_encode, result);
+}
+
+static bool bench_hex_decode_scalar(bench_result_t* result) {
+    return bench_scalar(bench_hex_decode, result);
+}
+
+static void bench_alloc(void) {
+    memory_free(memory_alloc(64));
+}
+
+static void bench_random(void) {
+    random_get();
+}
+
+// Records with the usual three arguments, and one below the level that
+// is dropped. The written records push the real ones out of the ring.
+static void bench_log_write(void) {
+    log_write(LOG_INFO, "bench: %u %x %d", 1, 0xABCD, -1);
+}
+
+static void bench_log_dropped(void) {
+    log_write(LOG_DEBUG, "bench: %u %x %d", 1, 0xABCD, -1);
+}
+
+static void bench_bitmap_scan(void) {
+    bitmap_find_first_zero(bench_bitmap, BENCH_BUFFER_SIZE);
+}
+
+// Map and unmap a range of pages in one call each, over a reserved
+// region that is never touched. Past PAGE_TLB_FLUSH_THRESHOLD pages the
+// unmap reloads CR3 instead of issuing one invlpg per page.
+static uint32_t bench_map_start = 0;
+static uint32_t bench_map_pages = 0;
+
+static void bench_map_unmap(void) {
+    paging_map_range(bench_map_start, 0, bench_map_pages, PAGE_WRITABLE);
+    paging_unmap_range(bench_map_start, bench_map_pages);
+}
+
+// Fails where there is no paging
+static bool bench_map(bench_result_t* result, uint32_t pages) {
+    void* region = vm_reserve(pages * PAGE_SIZE, PAGE_WRITABLE);
+    if (region == NULL) return false;
+
+    bench_map_start = (uint32_t)region;
+    bench_map_pages = pages;
+    bool ok = paging_map_range(bench_map_start, 0, pages, PAGE_WRITABLE);
+    paging_unmap_range(bench_map_start, pages);
+    if (ok) ok = bench_measure(bench_map_unmap, result);
+    vm_release(region);
+    return ok;
+}
+
+static bool bench_map_1(bench_result_t* result) {
+    return bench_map(result, 1);
+}
+
+static bool bench_map_16(bench_result_t* result) {
+    return bench_map(result, 16);
+}
+
+static bool bench_map_64(bench_result_t* result) {
+    return bench_map(result, 64);
+}
+
+static bool bench_map_256(bench_result_t* result) {
+    return bench_map(result, 256);
+}
+
+static bool bench_map_1024(bench_result_t* result) {
+    return bench_map(result, 1024);
+}
+
+// TLB reach: one load from every page of the 4 MiB kernel heap in a
+// shuffled order, each address depending on the previous load so the
+// misses cannot overlap. The kernel maps the heap with one large page
+// when the CPU has PSE; the alias maps the same frames with 4 KiB pages,
+// so the difference per load is the cost of a TLB miss.
+static uint32_t bench_tlb_base = 0;
+
+static void bench_tlb_walk(void) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < BENCH_TLB_PAGES; i++) {
+        __asm__("andl $0, %0" : "+r"(value));
+        uint32_t page = bench_tlb_order[i];
+        value = *(volatile uint8_t*)(bench_tlb_base + page * PAGE_SIZE + (page & 63) * 64 + value);
+    }
+}
+
+static bool bench_tlb_kernel(bench_result_t* result) {
+    if (paging_get_physical(KERNEL_HEAP_START) == 0) return false;
+    bench_tlb_base = KERNEL_HEAP_START;
+    return bench_measure(bench_tlb_walk, result);
+}
+
+static bool bench_tlb_alias(bench_result_t* result) {
+    void* alias = vm_reserve(BENCH_TLB_PAGES * PAGE_SIZE, 0);
+    if (alias == NULL) return false;
+
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < BENCH_TLB_PAGES; i++) {
+        uint32_t phys = paging_get_physical(KERNEL_HEAP_START + i * PAGE_SIZE);
+        ok = phys != 0 && paging_map_range((uint32_t)alias + i * PAGE_SIZE, phys & ~(PAGE_SIZE - 1), 1, 0);
+    }
+    if (ok) {
+        bench_tlb_base = (uint32_t)alias;
+        ok = bench_measure(bench_tlb_walk, result);
+    }
+
+    // The frames belong to the heap, only the alias goes
+    paging_unmap_range((uint32_t)alias, BENCH_TLB_PAGES);
+    vm_release(alias);
+    return ok;
+}
+
+// Context switch ping-pong: two processes at the top priority yield to
+// each other while one of them measures, so every yield is a round trip
+static volatile uint32_t bench_switch_threads = 0;
+static volatile bool bench_switch_done = false;
+static bench_result_t* bench_switch_result = NULL;
+static bool bench_switch_ok = false;
+
+static void bench_yield(void) {
+    process_schedule();
+}
+
+static void bench_ping(void) {
+    bench_switch_ok = bench_measure(bench_yield, bench_switch_result);
+    if (bench_switch_ok) {
+        bench_switch_result->min /= 2;
+        bench_switch_result->median /= 2;
+        bench_switch_result->p99 /= 2;
+    }
+    bench_switch_done = true;
+    bench_switch_threads--;
+}
+
+static void bench_pong(void) {
+    while (!bench_switch_done) {
+        process_schedule();
+    }
+    bench_switch_threads--;
+}
+
+// Cycles per switch; the caller waits until both processes have exited
+static bool bench_switch(bench_result_t* result) {
+    bench_switch_result = result;
+    bench_switch_ok = false;
+    bench_switch_done = false;
+
+    if (process_create("bench-pong", bench_pong, MAX_PRIORITY) != ERR_NONE) return false;
+    bench_switch_threads = 1;
+    if (process_create("bench-ping", bench_ping, MAX_PRIORITY) == ERR_NONE) {
+        bench_switch_threads++;
+    } else {
+        bench_switch_done = true;
+    }
+
+    while (bench_switch_threads > 0) {
+        process_schedule();
+    }
+    return bench_switch_ok;
+}
+
+// Scheduler decisions with size processes waiting in the run queues.
+// The fillers are spread over every level below the measuring process,
+// so the bitmap is full and process_schedule keeps the measuring process
+// running: only the decision is timed, never a switch.
+static volatile uint32_t bench_queue_threads = 0;
+static volatile bool bench_queue_done = false;
+static bench_fn_t bench_queue_fn = NULL;
+static bench_result_t* bench_queue_result = NULL;
+static bool bench_queue_ok = false;
+
+static void bench_pick_next(void) {
+    process_pick_next();
+}
+
+// Finds bench_queue_done already set when the queues could not be filled
+static void bench_queue_measure(void) {
+    if (!bench_queue_done) bench_queue_ok = bench_measure(bench_queue_fn, bench_queue_result);
+    bench_queue_done = true;
+    bench_queue_threads--;
+}
+
+static void bench_queue_filler(void) {
+    while (!bench_queue_done) {
+        process_schedule();
+    }
+    bench_queue_threads--;
+}
+
+// Fails unless size fillers were created. BENCH_QUEUE_FULL instead fills
+// the process table, however many slots are left.
+#define BENCH_QUEUE_FULL MAX_PROCESSES
+
+static bool bench_queue(bench_result_t* result, uint32_t size, bench_fn_t fn) {
+    bench_queue_fn = fn;
+    bench_queue_result = result;
+    bench_queue_ok = false;
+    bench_queue_done = false;
+    bench_queue_threads = 0;
+
+    // Nothing may run before the queues are filled
+    preempt_disable();
+    if (process_create("bench-queue", bench_queue_measure, MAX_PRIORITY) == ERR_NONE) {
+        bench_queue_threads++;
+    } else {
+        bench_queue_done = true;
+    }
+    uint32_t fillers = 0;
+    while (!bench_queue_done && fillers < size &&
+           process_create("bench-filler", bench_queue_filler, fillers % MAX_PRIORITY) == ERR_NONE) {
+        fillers++;
+        bench_queue_threads++;
+    }
+    if (fillers < size && size != BENCH_QUEUE_FULL) bench_queue_done = true;
+    preempt_enable();
+
+    while (bench_queue_threads > 0) {
+        process_schedule();
+    }
+    return bench_queue_ok;
+}
+
+static bool bench_pick_next_10(bench_result_t* result) {
+    return bench_queue(result, 10, bench_pick_next);
+}
+
+static bool bench_pick_next_100(bench_result_t* result) {
+    return bench_queue(result, 100, bench_pick_next);
+}
+
+static bool bench_pick_next_full(bench_result_t* result) {
+    return bench_queue(result, BENCH_QUEUE_FULL, bench_pick_next);
+}
+
+static bool bench_schedule_10(bench_result_t* result) {
+    return bench_queue(result, 10, bench_yield);
+}
+
+static bool bench_schedule_100(bench_result_t* result) {
+    return bench_queue(result, 100, bench_yield);
+}
+
+static bool bench_schedule_full(bench_result_t* result) {
+    return bench_queue(result, BENCH_QUEUE_FULL, bench_yield);
+}
+
+// Benchmarks that need an address space run in a process of their own
+// at the top priority. It first grows its heap by pages and touches
+// them, then measures fn, and shrinks the heap again.
+static volatile bool bench_process_done = false;
+static bench_fn_t bench_process_fn = NULL;
+static uint32_t bench_process_pages = 0;
+static bench_result_t* bench_process_result = NULL;
+static bool bench_process_ok = false;
+
+static inline uint32_t bench_heap_break(const process_t* process) {
+    return process->heap_ptr + process->heap_size;
+}
+
+static void bench_process_main(void) {
+    process_t* self = process_get_current();
+    uint32_t start = bench_heap_break(self);
+    bench_process_ok = process_set_break(self, start + bench_process_pages * PAGE_SIZE);
+    for (uint32_t i = 0; bench_process_ok && i < bench_process_pages; i++) {
+        *(volatile uint8_t*)(start + i * PAGE_SIZE) = 1;
+    }
+
+    if (bench_process_ok) bench_process_ok = bench_measure(bench_process_fn, bench_process_result);
+    process_set_break(self, start);
+    bench_process_done = true;
+}
+
+static bool bench_in_process(bench_result_t* result, bench_fn_t fn, uint32_t pages) {
+    bench_process_fn = fn;
+    bench_process_pages = pages;
+    bench_process_result = result;
+    bench_process_ok = false;
+    bench_process_done = false;
+
+    if (process_create("bench-process", bench_process_main, MAX_PRIORITY) != ERR_NONE) return false;
+    while (!bench_process_done) {
+        process_schedule();
+    }
+    return bench_process_ok;
+}
+
+// Grow the heap by 16 pages, fault each one in as a zero page, and give
+// them back
+#define BENCH_BRK_PAGES 16
+
+static void bench_brk(void) {
+    process_t* self = process_get_current();
+    uint32_t start = bench_heap_break(self);
+    process_set_break(self, start + BENCH_BRK_PAGES * PAGE_SIZE);
+    for (uint32_t i = 0; i < BENCH_BRK_PAGES; i++) {
+        *(volatile uint8_t*)(start + i * PAGE_SIZE) = 1;
+    }
+    process_set_break(self, start);
+}
+
+static bool bench_brk_run(bench_result_t* result) {
+    return bench_in_process(result, bench_brk, 0);
+}
+
+// Fork round trip: the child exits at once and the parent waits for it,
+// so a call is fork, two switches and an exit. The cost grows with the
+// pages the parent has touched, which the child shares copy-on-write.
+static void bench_fork(void) {
+    uint32_t pid;
+    if (process_fork(process_get_current(), &pid) != ERR_NONE) return;
+    if (pid == 0) process_exit(0);
+    process_schedule();
+}
+
+static bool bench_fork_0(bench_result_t* result) {
+    return bench_in_process(result, bench_fork, 0);
+}
+
+static bool bench_fork_256k(bench_result_t* result) {
+    return bench_in_process(result, bench_fork, 64);
+}
+
+static bool bench_fork_4m(bench_result_t* result) {
+    return bench_in_process(result, bench_fork, 1024);
+}
+
+// Entries time fn with bench_measure, or call run to do their own setup.
+// bytes is the data handled per call, 0 when there is no throughput.
+static const struct {
+    const char* name;
+    bench_fn_t fn;
+    bool (*run)(bench_result_t* result);
+    uint32_t bytes;
+} bench_table[] = {
+    { "memcpy-4k", bench_memcpy, NULL, BENCH_BUFFER_SIZE },
+    { "memset-4k", bench_memset, NULL, BENCH_BUFFER_SIZE },
+    { "strlen-255", bench_strlen, NULL, 255 },
+    { "crc32-4k", bench_crc32, NULL, BENCH_BUFFER_SIZE },
+    { "crc32c-4k", bench_crc32c, NULL, BENCH_BUFFER_SIZE },
+    { "fnv1a-4k", bench_fnv1a, NULL, BENCH_BUFFER_SIZE },
+    { "murmur3-4k", bench_murmur3, NULL, BENCH_BUFFER_SIZE },
+    { "base64-3k", bench_base64, NULL, 3072 },
+    { "base64-3k-scalar", NULL, bench_base64_scalar, 3072 },
+    { "b64dec-3k", bench_base64_decode, NULL, 3072 },
+    { "b64dec-3k-scalar", NULL, bench_base64_decode_scalar, 3072 },
+    { "hexenc-2k", bench_hex_encode, NULL, 2048 },
+    { "hexenc-2k-scalar", NULL, bench_hex_encode_scalar, 2048 },
+    { "hexdec-2k", bench_hex_decode, NULL, 2048 },
+    { "hexdec-2k-scalar", NULL, bench_hex_decode_scalar, 2048 },
+    { "alloc-64", bench_alloc, NULL, 0 },
+    { "random", bench_random, NULL, 0 },
+    { "log-write", bench_log_write, NULL, 0 },
+    { "log-dropped", bench_log_dropped, NULL, 0 },
+    { "bitmap-4k", bench_bitmap_scan, NULL, 0 },
+    { "map-4k", NULL, bench_map_1, PAGE_SIZE },
+    { "map-64k", NULL, bench_map_16, 16 * PAGE_SIZE },
+    { "map-256k", NULL, bench_map_64, 64 * PAGE_SIZE },
+    { "map-1m", NULL, bench_map_256, 256 * PAGE_SIZE },
+    { "map-4m", NULL, bench_map_1024, 1024 * PAGE_SIZE },
+    { "tlb-kernel-map", NULL, bench_tlb_kernel, 0 },
+    { "tlb-4k-alias", NULL, bench_tlb_alias, 0 },
+    { "switch", NULL, bench_switch, 0 },
+    { "brk-64k", NULL, bench_brk_run, BENCH_BRK_PAGES * PAGE_SIZE },
+    { "fork-0", NULL, bench_fork_0, 0 },
+    { "fork-256k", NULL, bench_fork_256k, 0 },
+    { "fork-4m", NULL, bench_fork_4m, 0 },
+    { "pick-next-10", NULL, bench_pick_next_10, 0 },
+    { "pick-next-100", NULL, bench_pick_next_100, 0 },
+    { "pick-next-full", NULL, bench_pick_next_full, 0 },
+    { "schedule-10", NULL, bench_schedule_10, 0 },
+    { "schedule-100", NULL, bench_schedule_100, 0 },
+    { "schedule-full", NULL, bench_schedule_full, 0 },
+};
+
+#define BENCH_COUNT (sizeof(bench_table) / sizeof(bench_table[0]))
+
+uint32_t bench_count(void) {
+    return BENCH_COUNT;
+}
+
+const char* bench_name(uint32_t index) {
+    return index < BENCH_COUNT ? bench_table[index].name : NULL;
+}
+
+// Bytes handled per call, 0 when the entry has no throughput
+uint32_t bench_bytes(uint32_t index) {
+    return index < BENCH_COUNT ? bench_table[index].bytes : 0;
+}
+
+bool bench_run(uint32_t index, bench_result_t* result) {
+    if (index >= BENCH_COUNT) return false;
+    if (!bench_ready) bench_setup();
+    if (bench_table[index].run != NULL) return bench_table[index].run(result);
+    return bench_measure(bench_table[index].fn, result);
+}
@@ -0,0 +1,77 @@
+#include "../include/kernel.h"
+#include <bitops.h>
+#include <cpu.h>
+
+bool bitops_popcnt = false;
+
+// Use POPCNT when the CPU has it, called once at boot
+void bitops_init(void) {
+    bitops_popcnt = cpu_has_feature_ecx(CPUID_ECX_POPCNT);
+}
+
+// Set or clear a run of bits, whole words at a time in the middle
+static void bitmap_fill(uint32_t* map, uint32_t start, uint32_t count, bool set) {
+    if (count == 0) return;
+
+    uint32_t index = start >> 5;
+    uint32_t last = (start + count - 1) >> 5;
+    uint32_t first_mask = ~0u << (start & 31);
+    uint32_t last_mask = ~0u >> (31 - ((start + count - 1) & 31));
+
+    if (index == last) first_mask &= last_mask;
+    if (set) map[index] |= first_mask;
+    else map[index] &= ~first_mask;
+    if (index == last) return;
+
+    for (index++; index < last; index++) {
+        map[index] = set ? ~0u : 0;
+    }
+    if (set) map[last] |= last_mask;
+    else map[last] &= ~last_mask;
+}
+
+void bitmap_set_range(uint32_t* map, uint32_t start, uint32_t count) {
+    bitmap_fill(map, start, count, true);
+}
+
+void bitmap_clear_range(uint32_t* map, uint32_t start, uint32_t count) {
+    bitmap_fill(map, start, count, false);
+}
+
+// Scan for the first bit at or after start that differs from the
+// invert pattern, skipping whole words that cannot match
+static uint32_t bitmap_find_next(const uint32_t* map, uint32_t bits, uint32_t start, uint32_t invert) {
+    if (start >= bits) return bits;
+
+    uint32_t index = start >> 5;
+    uint32_t words = BITMAP_WORDS(bits);
+    uint32_t word = (map[index] ^ invert) & (~0u << (start & 31));
+    while (word == 0) {
+        if (++index == words) return bits;
+        word = map[index] ^ invert;
+    }
+
+    uint32_t bit = (index << 5) + bit_first_set(word);
+    return bit < bits ? bit : bits;
+}
+
+uint32_t bitmap_find_next_set(const uint32_t* map, uint32_t bits, uint32_t start) {
+    return bitmap_find_next(map, bits, start, 0);
+}
+
+uint32_t bitmap_find_next_zero(const uint32_t* map, uint32_t bits, uint32_t start) {
+    return bitmap_find_next(map, bits, start, ~0u);
+}
+
+// Number of set bits
+uint32_t bitmap_count(const uint32_t* map, uint32_t bits) {
+    uint32_t count = 0;
+    uint32_t full = bits >> 5;
+    for (uint32_t i = 0; i < full; i++) {
+        count += bit_popcount(map[i]);
+    }
+    if (bits & 31) {
+        count += bit_popcount(map[full] & ~(~0u << (bits & 31)));
+    }
+    return count;
+}
@@ -0,0 +1,94 @@
+#include "../include/kernel.h"
+#include <hashmap.h>
+#include <string.h>
+#include <utils.h>
+
+// Set up a map over entries, capacity must be a power of two
+void hash_map_init(hash_map_t* map, hash_map_entry_t* entries, uint32_t capacity,
+                   hash_map_hash_t hash, hash_map_equals_t equals) {
+    map->entries = entries;
+    map->capacity = capacity;
+    map->hash = hash;
+    map->equals = equals;
+    hash_map_clear(map);
+}
+
+void hash_map_clear(hash_map_t* map) {
+    memset(map->entries, 0, map->capacity * sizeof(hash_map_entry_t));
+    map->count = 0;
+}
+
+// Slot holding key, or the empty slot that ends its probe sequence
+static uint32_t hash_map_find(const hash_map_t* map, const void* key, uint32_t hash) {
+    uint32_t mask = map->capacity - 1;
+    uint32_t slot = hash & mask;
+    while (map->entries[slot].used) {
+        const hash_map_entry_t* entry = &map->entries[slot];
+        if (entry->hash == hash && map->equals(entry->key, key)) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Look up a key, returns NULL when absent
+void* hash_map_get(const hash_map_t* map, const void* key) {
+    uint32_t slot = hash_map_find(map, key, map->hash(key));
+    return map->entries[slot].used ? map->entries[slot].value : NULL;
+}
+
+// Insert or replace a key. Fails when the map would become more than
+// three quarters full, which keeps probe sequences short.
+bool hash_map_put(hash_map_t* map, const void* key, void* value) {
+    uint32_t hash = map->hash(key);
+    uint32_t slot = hash_map_find(map, key, hash);
+    hash_map_entry_t* entry = &map->entries[slot];
+
+    if (!entry->used) {
+        if ((map->count + 1) * 4 > map->capacity * 3) return false;
+        entry->used = true;
+        entry->hash = hash;
+        map->count++;
+    }
+    entry->key = key;
+    entry->value = value;
+    return true;
+}
+
+// Remove a key, returns its value or NULL when absent
+void* hash_map_remove(hash_map_t* map, const void* key) {
+    uint32_t mask = map->capacity - 1;
+    uint32_t hole = hash_map_find(map, key, map->hash(key));
+    if (!map->entries[hole].used) return NULL;
+
+    void* value = map->entries[hole].value;
+    map->entries[hole].used = false;
+    map->count--;
+
+    // Backward-shift deletion: pull later entries of the cluster into the
+    // hole when their home slot allows it, so no tombstones are needed
+    for (uint32_t next = (hole + 1) & mask; map->entries[next].used; next = (next + 1) & mask) {
+        uint32_t home = map->entries[next].hash & mask;
+        if (((next - home) & mask) >= ((hole - home) & mask)) {
+            map->entries[hole] = map->entries[next];
+            map->entries[next].used = false;
+            hole = next;
+        }
+    }
+    return value;
+}
+
+uint32_t hash_map_hash_id(const void* key) {
+    return hash_mix32((uint32_t)(uintptr_t)key);
+}
+
+bool hash_map_equals_id(const void* a, const void* b) {
+    return a == b;
+}
+
+uint32_t hash_map_hash_string(const void* key) {
+    return hash_fnv1a(key, strlen(key));
+}
+
+bool hash_map_equals_string(const void* a, const void* b) {
+    return strcmp(a, b) == 0;
+}
@@ -1,22 +1,198 @@
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
+#include <cpu.h>
+#include <interrupt.h>
+
+// Copy strategies by size: bytes for short runs, aligned 32-bit words
+// for medium ones, rep movsd/stosd above STRING_REP_THRESHOLD, and 64-byte
+// SSE2 blocks above STRING_SSE2_THRESHOLD once string_init has found SSE2.
+#define STRING_WORD_THRESHOLD 16
+#define STRING_REP_THRESHOLD  128
+#define STRING_SSE2_THRESHOLD 1024
+
+typedef uint32_t unaligned_u32 __attribute__((aligned(1), may_alias));
+typedef uint32_t aliased_u32 __attribute__((may_alias));
+typedef char v16qi __attribute__((vector_size(16)));
+typedef uint32_t v4si __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16), may_alias));
+typedef long long v2di_u __attribute__((vector_size(16), aligned(1), may_alias));
+
+static bool string_sse2 = false;
+
+// SSE registers belong to the interrupted thread inside handlers
+static inline bool string_use_sse2(void) {
+    return string_sse2 && !interrupt_in_handler();
+}
+
+// Pick the fastest available routines, called once at boot
+void string_init(void) {
+    if (cpu_has_feature_edx(CPUID_EDX_FXSR | CPUID_EDX_SSE2)) {
+        cpu_enable_sse();
+        string_sse2 = true;
+    }
+}
+
+// Copy n bytes, a multiple of 64, to a 16-byte aligned destination.
+// All loads of a block happen before its stores, so it also serves
+// forward memmove.
+__attribute__((target("sse2")))
+static void memcpy_sse2(uint8_t* d, const uint8_t* s, size_t n) {
+    v2di* dst = (v2di*)d;
+    const v2di_u* src = (const v2di_u*)s;
+    for (; n >= 64; n -= 64, dst += 4, src += 4) {
+        v2di a = src[0], b = src[1], c = src[2], e = src[3];
+        dst[0] = a;
+        dst[1] = b;
+        dst[2] = c;
+        dst[3] = e;
+    }
+}
+
+__attribute__((target("sse2")))
+static void memset_sse2(uint8_t* d, uint32_t pattern, size_t n) {
+    v2di value = (v2di)(v4si){ pattern, pattern, pattern, pattern };
+    v2di* dst = (v2di*)d;
+    for (; n >= 64; n -= 64, dst += 4) {
+        dst[0] = value;
+        dst[1] = value;
+        dst[2] = value;
+        dst[3] = value;
+    }
+}
+
+// Index of the first differing byte within 16, or 16 when equal
+__attribute__((target("sse2")))
+static inline uint32_t memcmp_sse2_block(const uint8_t* a, const uint8_t* b) {
+    v16qi x = (v16qi)*(const v2di_u*)a;
+    v16qi y = (v16qi)*(const v2di_u*)b;
+    uint32_t equal = __builtin_ia32_pmovmskb128(__builtin_ia32_pcmpeqb128(x, y));
+    return equal == 0xFFFF ? 16 : (uint32_t)__builtin_ctz(~equal);
+}
 
 void* memcpy(void* dest, const void* src, size_t n) {
-    unsigned char* d = dest;
-    const unsigned char* s = src;
-    for (size_t i = 0; i < n; i++) d[i] = s[i];
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+
+    if (n >= STRING_WORD_THRESHOLD) {
+        // Align the destination, stores are the costly side
+        bool sse2 = n >= STRING_SSE2_THRESHOLD && string_use_sse2();
+        uint32_t align = sse2 ? 15 : 3;
+        while ((uint32_t)d & align) {
+            *d++ = *s++;
+            n--;
+        }
+
+        if (sse2 && n >= STRING_SSE2_THRESHOLD) {
+            size_t block = n & ~(size_t)63;
+            memcpy_sse2(d, s, block);
+            d += block;
+            s += block;
+            n -= block;
+        } else if (n >= STRING_REP_THRESHOLD) {
+            size_t words = n / 4;
+            __asm__ volatile("rep movsl"
+                             : "+D"(d), "+S"(s), "+c"(words)
+                             :
+                             : "memory");
+            n &= 3;
+        }
+
+        for (; n >= 4; n -= 4, d += 4, s += 4) {
+            *(aliased_u32*)d = *(const unaligned_u32*)s;
+        }
+    }
+
+    while (n--) *d++ = *s++;
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+
+    // A forward copy is safe unless dest starts inside the source
+    if (d <= s || d >= s + n) {
+        return memcpy(dest, src, n);
+    }
+
+    d += n;
+    s += n;
+    if (n >= STRING_WORD_THRESHOLD) {
+        while ((uint32_t)d & 3) {
+            *--d = *--s;
+            n--;
+        }
+        for (; n >= 4; n -= 4) {
+            d -= 4;
+            s -= 4;
+            *(aliased_u32*)d = *(const unaligned_u32*)s;
+        }
+    }
+    while (n--) *--d = *--s;
     return dest;
 }
 
 void* memset(void* dest, int c, size_t n) {
-    unsigned char* d = dest;
-    for (size_t i = 0; i < n; i++) d[i] = (unsigned char)c;
+    uint8_t* d = dest;
+    uint8_t value = (uint8_t)c;
+
+    if (n >= STRING_WORD_THRESHOLD) {
+        uint32_t pattern = value * 0x01010101u;
+        bool sse2 = n >= STRING_SSE2_THRESHOLD && string_use_sse2();
+        uint32_t align = sse2 ? 15 : 3;
+        while ((uint32_t)d & align) {
+            *d++ = value;
+            n--;
+        }
+
+        if (sse2 && n >= STRING_SSE2_THRESHOLD) {
+            size_t block = n & ~(size_t)63;
+            memset_sse2(d, pattern, block);
+            d += block;
+            n -= block;
+        } else if (n >= STRING_REP_THRESHOLD) {
+            size_t words = n / 4;
+            __asm__ volatile("rep stosl"
+                             : "+D"(d), "+c"(words)
+                             : "a"(pattern)
+                             : "memory");
+            n &= 3;
+        }
+
+        for (; n >= 4; n -= 4, d += 4) {
+            *(aliased_u32*)d = pattern;
+        }
+    }
+
+    while (n--) *d++ = value;
     return dest;
 }
 
 int memcmp(const void* s1, const void* s2, size_t n) {
-    const unsigned char* a = s1;
-    const unsigned char* b = s2;
+    const uint8_t* a = s1;
+    const uint8_t* b = s2;
+
+    // Skip equal prefixes in blocks, then let the byte loop find the
+    // ordering of the first difference
+    if (string_use_sse2()) {
+        while (n >= 16) {
+            uint32_t index = memcmp_sse2_block(a, b);
+            if (index < 16) {
+                return a[index] - b[index];
+            }
+            a += 16;
+            b += 16;
+            n -= 16;
+        }
+    }
+    while (n >= 4 && *(const unaligned_u32*)a == *(const unaligned_u32*)b) {
+        a += 4;
+        b += 4;
+        n -= 4;
+    }
+
     for (size_t i = 0; i < n; i++) {
         if (a[i] != b[i]) return a[i] - b[i];
     }
@@ -36,15 +212,53 @@ char* strncpy(char* dest, const char* src, size_t n) {
     return dest;
 }
 
+// Word-at-a-time helpers: a word has a zero byte iff this is non-zero.
+// Aligned word loads never cross a page, so reading past the terminator
+// within the last word is safe.
+#define WORD_ONES  0x01010101u
+#define WORD_HIGHS 0x80808080u
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+#define STRING_PAGE_SIZE 4096
+
 int strcmp(const char* s1, const char* s2) {
-    while (*s1 && (*s1 == *s2)) { s1++; s2++; }
-    return *(unsigned char*)s1 - *(unsigned char*)s2;
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+
+    // Align s1, then compare whole words while s2's unaligned load stays
+    // within its page
+    while ((uint32_t)a & 3) {
+        if (*a != *b || *a == 0) return *a - *b;
+        a++;
+        b++;
+    }
+    while (((uint32_t)b & (STRING_PAGE_SIZE - 1)) <= STRING_PAGE_SIZE - 4) {
+        uint32_t wa = *(const aliased_u32*)a;
+        uint32_t wb = *(const unaligned_u32*)b;
+        if (wa != wb || WORD_HAS_ZERO(wa)) break;
+        a += 4;
+        b += 4;
+    }
+
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a - *b;
 }
 
 size_t strlen(const char* s) {
-    size_t len = 0;
-    while (s[len]) len++;
-    return len;
+    const char* p = s;
+    while ((uint32_t)p & 3) {
+        if (*p == 0) return p - s;
+        p++;
+    }
+
+    const aliased_u32* w = (const aliased_u32*)p;
+    while (!WORD_HAS_ZERO(*w)) w++;
+
+    p = (const char*)w;
+    while (*p) p++;
+    return p - s;
 }
 
 char* strcat(char* dest, const char* src) {
@@ -61,34 +275,257 @@ char* strncat(char* dest, const char* src, size_t n) {
     return dest;
 }
 
-char* strstr(const char* haystack, const char* needle) {
-    if (!*needle) return (char*)haystack;
-    for (; *haystack; haystack++) {
-        const char* h = haystack;
-        const char* n = needle;
-        while (*h && *n && *h == *n) { h++; n++; }
-        if (!*n) return (char*)haystack;
+// Maximal suffix of needle under the byte order, or the reversed order.
+// Returns the start of the suffix and stores its period.
+static size_t strstr_maximal_suffix(const uint8_t* needle, size_t m, size_t* period, bool reverse) {
+    size_t suffix = (size_t)-1;
+    size_t j = 0;
+    size_t k = 1;
+    size_t p = 1;
+
+    while (j + k < m) {
+        uint8_t a = needle[j + k];
+        uint8_t b = needle[suffix + k];
+        if (reverse ? a > b : a < b) {
+            j += k;
+            k = 1;
+            p = j - suffix;
+        } else if (a == b) {
+            if (k != p) {
+                k++;
+            } else {
+                j += p;
+                k = 1;
+            }
+        } else {
+            suffix = j++;
+            k = p = 1;
+        }
+    }
+
+    *period = p;
+    return suffix + 1;
+}
+
+// Two-Way string matching (Crochemore-Perrin): linear time, constant
+// space. The needle is split at a critical factorization; the right part
+// is matched left to right, the left part right to left.
+static char* strstr_two_way(const uint8_t* haystack, size_t n, const uint8_t* needle, size_t m) {
+    size_t period, period_reverse;
+    size_t suffix = strstr_maximal_suffix(needle, m, &period, false);
+    size_t suffix_reverse = strstr_maximal_suffix(needle, m, &period_reverse, true);
+    if (suffix_reverse > suffix) {
+        suffix = suffix_reverse;
+        period = period_reverse;
+    }
+
+    if (memcmp(needle, needle + period, suffix) == 0) {
+        // Periodic needle: remember how much of the left part is known
+        // to match after a shift by the period
+        size_t memory = 0;
+        for (size_t j = 0; j + m <= n;) {
+            size_t i = suffix > memory ? suffix : memory;
+            while (i < m && needle[i] == haystack[i + j]) i++;
+            if (i < m) {
+                j += i - suffix + 1;
+                memory = 0;
+                continue;
+            }
+
+            i = suffix;
+            while (i > memory && needle[i - 1] == haystack[i - 1 + j]) i--;
+            if (i <= memory) return (char*)haystack + j;
+            j += period;
+            memory = m - period;
+        }
+    } else {
+        // No useful period: shift past the longer half on a left mismatch
+        period = (suffix > m - suffix ? suffix : m - suffix) + 1;
+        for (size_t j = 0; j + m <= n;) {
+            size_t i = suffix;
+            while (i < m && needle[i] == haystack[i + j]) i++;
+            if (i < m) {
+                j += i - suffix + 1;
+                continue;
+            }
+
+            i = suffix;
+            while (i > 0 && needle[i - 1] == haystack[i - 1 + j]) i--;
+            if (i == 0) return (char*)haystack + j;
+            j += period;
+        }
     }
     return NULL;
 }
 
-char* strtok(char* str, const char* delim) {
-    static char* last;
-    if (!str) str = last;
+char* strstr(const char* haystack, const char* needle) {
+    if (!needle[0]) return (char*)haystack;
+    if (!needle[1]) {
+        for (; *haystack; haystack++) {
+            if (*haystack == needle[0]) return (char*)haystack;
+        }
+        return NULL;
+    }
+
+    size_t m = strlen(needle);
+    size_t n = strlen(haystack);
+    if (m > n) return NULL;
+    return strstr_two_way((const uint8_t*)haystack, n, (const uint8_t*)needle, m);
+}
+
+// Length of the prefix of s made only of bytes in accept
+size_t strspn(const char* s, const char* accept) {
+    uint32_t set[8] = {0};
+    for (; *accept; accept++) set[(uint8_t)*accept >> 5] |= 1u << ((uint8_t)*accept & 31);
+
+    size_t len = 0;
+    while (s[len] && (set[(uint8_t)s[len] >> 5] & (1u << ((uint8_t)s[len] & 31)))) len++;
+    return len;
+}
+
+// Length of the prefix of s made only of bytes not in reject
+size_t strcspn(const char* s, const char* reject) {
+    uint32_t set[8] = {0};
+    for (; *reject; reject++) set[(uint8_t)*reject >> 5] |= 1u << ((uint8_t)*reject & 31);
+
+    size_t len = 0;
+    while (s[len] && !(set[(uint8_t)s[len] >> 5] & (1u << ((uint8_t)s[len] & 31)))) len++;
+    return len;
+}
+
+// Reentrant strtok: the position is kept in *saveptr
+char* strtok_r(char* str, const char* delim, char** saveptr) {
+    if (!str) str = *saveptr;
     if (!str) return NULL;
     str += strspn(str, delim);
-    if (!*str) { last = NULL; return NULL; }
+    if (!*str) { *saveptr = NULL; return NULL; }
     char* end = str + strcspn(str, delim);
-    if (*end) { *end = '\0'; last = end + 1; }
-    else last = NULL;
+    if (*end) { *end = '\0'; *saveptr = end + 1; }
+    else *saveptr = NULL;
     return str;
 }
 
+char* strtok(char* str, const char* delim) {
+    static char* last;
+    return strtok_r(str, delim, &last);
+}
+
+// Command-line tokenizer. Tokens are separated by unquoted whitespace;
+// '...' is literal, "..." allows backslash escapes, and a backslash
+// outside quotes escapes the next byte. Tokens are returned as slices of
+// the input, nothing is copied.
+static inline bool string_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+void string_tokenizer_init(string_tokenizer_t* tokenizer, const char* input) {
+    tokenizer->position = input;
+}
+
+// Get the next token, returns false at the end of the input
+bool string_tokenizer_next(string_tokenizer_t* tokenizer, string_token_t* token) {
+    const char* p = tokenizer->position;
+    if (p == NULL) return false;
+    while (string_is_space(*p)) p++;
+    if (*p == '\0') {
+        tokenizer->position = p;
+        return false;
+    }
+
+    const char* start = p;
+    uint32_t quote_sections = 0;
+    bool escaped = false;
+    char quote = 0;
+    for (; *p; p++) {
+        if (quote == '\'') {
+            if (*p == '\'') quote = 0;
+        } else if (*p == '\\' && p[1] != '\0') {
+            escaped = true;
+            p++;
+        } else if (quote == '"') {
+            if (*p == '"') quote = 0;
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+            quote_sections++;
+        } else if (string_is_space(*p)) {
+            break;
+        }
+    }
+    tokenizer->position = p;
+
+    token->start = start;
+    token->length = p - start;
+    token->needs_unescape = escaped || quote_sections > 0;
+
+    // A token that is exactly one quoted section is returned without its
+    // quotes and needs no further processing
+    if (!escaped && quote_sections == 1 && token->length >= 2 &&
+        (*start == '"' || *start == '\'') && p[-1] == *start && quote == 0) {
+        token->start = start + 1;
+        token->length -= 2;
+        token->needs_unescape = false;
+    }
+    return true;
+}
+
+// Copy a token to dest with quotes and escapes removed. dest may be the
+// token's own start, the result is never longer than the token.
+// Returns the length written, dest is not terminated.
+size_t string_token_unescape(const string_token_t* token, char* dest) {
+    const char* p = token->start;
+    const char* end = token->start + token->length;
+    if (!token->needs_unescape) {
+        if (dest != p) memmove(dest, p, token->length);
+        return token->length;
+    }
+
+    size_t length = 0;
+    char quote = 0;
+    for (; p < end; p++) {
+        if (quote == '\'') {
+            if (*p == '\'') quote = 0;
+            else dest[length++] = *p;
+        } else if (*p == '\\' && p + 1 < end) {
+            dest[length++] = *++p;
+        } else if (quote == '"') {
+            if (*p == '"') quote = 0;
+            else dest[length++] = *p;
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+        } else {
+            dest[length++] = *p;
+        }
+    }
+    return length;
+}
+
+// Split a command line into argv in place: tokens are unescaped where
+// they are and terminated with a NUL. Returns the argument count.
+int string_split_args(char* line, char** argv, int max_args) {
+    string_tokenizer_t tokenizer;
+    string_token_t token;
+    int argc = 0;
+
+    string_tokenizer_init(&tokenizer, line);
+    while (argc < max_args && string_tokenizer_next(&tokenizer, &token)) {
+        char* arg = (char*)token.start;
+        size_t length = string_token_unescape(&token, arg);
+
+        // The separator after the token is the only byte the next call
+        // has not read yet, step over it before overwriting it
+        if (*tokenizer.position != '\0') tokenizer.position++;
+        arg[length] = '\0';
+        argv[argc++] = arg;
+    }
+    return argc;
+}
+
 char* strrchr(const char* s, int c) {
-    const char* last = NULL;
-    while (*s) {
-        if (*s == (char)c) last = s;
-        s++;
+    // Find the end with the word-wide strlen, then scan backwards
+    const char* p = s + strlen(s);
+    if ((char)c == 0) return (char*)p;
+    while (p != s) {
+        if (*--p == (char)c) return (char*)p;
     }
-    return (char*)last;
+    return NULL;
 } 
\ No newline at end of file
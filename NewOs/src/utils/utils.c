@@ -1,5 +1,13 @@
 #include "../include/kernel.h"
+#include <stdarg.h>
 #include <string.h>
+#include <bitops.h>
+#include <cpu.h>
+#include <hashmap.h>
+#include <interrupt.h>
+#include <process.h>
+#include <timer.h>
+#include <utils.h>
 
 // String functions
 size_t string_length(const char* str) {
@@ -63,41 +71,348 @@ int memory_compare(const void* ptr1, const void* ptr2, size_t n) {
     return memcmp(ptr1, ptr2, n);
 }
 
-// Time functions
+// Time functions. The TSC is calibrated against PIT channel 2 at boot;
+// after that the monotonic clock costs one rdtsc and a 64x32-bit scale.
+// Wall-clock time is the CMOS RTC reading taken at boot plus the
+// monotonic clock, so it never steps backwards. Without a usable TSC the
+// clock falls back to reading the RTC, with one-second resolution.
+#define PIT_FREQUENCY         1193182
+#define PIT_CHANNEL2          0x42
+#define PIT_COMMAND           0x43
+#define PIT_GATE_PORT         0x61
+#define PIT_GATE_CHANNEL2     0x01
+#define PIT_GATE_SPEAKER      0x02
+#define PIT_OUTPUT_CHANNEL2   0x20
+
+#define CLOCK_CALIBRATE_MS    10
+#define CLOCK_CALIBRATE_RUNS  3
+#define CLOCK_SPIN_LIMIT      1000000
+#define NS_PER_SECOND         1000000000u
+
+#define CMOS_ADDRESS          0x70
+#define CMOS_DATA             0x71
+#define RTC_STATUS_A          0x0A
+#define RTC_STATUS_B          0x0B
+#define RTC_UPDATE_IN_PROGRESS 0x80
+#define RTC_BINARY            0x04
+#define RTC_24_HOUR           0x02
+
+static bool clock_ready = false;
+static uint64_t clock_tsc_base = 0;
+static uint32_t clock_mult = 0;   // 0 when the TSC is not used
+static uint32_t clock_shift = 0;
+static uint32_t clock_tsc_khz = 0;
+static uint32_t clock_boot_unix = 0;
+
+// 64 by 32-bit division in two divl steps, libgcc is not linked
+static uint64_t clock_div64(uint64_t dividend, uint32_t divisor) {
+    uint32_t high = dividend >> 32;
+    uint32_t quotient_high = high / divisor;
+    uint32_t rest = high % divisor;
+    uint32_t quotient_low;
+    __asm__("divl %3" : "=a"(quotient_low), "+d"(rest) : "a"((uint32_t)dividend), "rm"(divisor));
+    return (uint64_t)quotient_high << 32 | quotient_low;
+}
+
+// (value * mult) >> shift for 0 < shift <= 32, keeping all 96 bits of
+// the product
+static inline uint64_t clock_scale(uint64_t value, uint32_t mult, uint32_t shift) {
+    uint64_t low = (uint64_t)(uint32_t)value * mult;
+    uint64_t high = (uint64_t)(uint32_t)(value >> 32) * mult;
+    return (low >> shift) + (high << (32 - shift));
+}
+
+// TSC ticks while PIT channel 2 counts down CLOCK_CALIBRATE_MS in mode 0,
+// or 0 if its output never rises
+static uint64_t clock_measure_tsc(uint32_t count) {
+    uint8_t gate = cpu_inb(PIT_GATE_PORT);
+    cpu_outb(PIT_GATE_PORT, (gate & ~PIT_GATE_SPEAKER) | PIT_GATE_CHANNEL2);
+    cpu_outb(PIT_COMMAND, 0xB0);  // Channel 2, low then high byte, mode 0
+    cpu_outb(PIT_CHANNEL2, count & 0xFF);
+    cpu_outb(PIT_CHANNEL2, count >> 8);
+
+    uint64_t start = cpu_rdtsc();
+    uint64_t elapsed = 0;
+    for (uint32_t spin = 0; spin < CLOCK_SPIN_LIMIT; spin++) {
+        if (cpu_inb(PIT_GATE_PORT) & PIT_OUTPUT_CHANNEL2) {
+            elapsed = cpu_rdtsc() - start;
+            break;
+        }
+    }
+
+    cpu_outb(PIT_GATE_PORT, gate);
+    return elapsed;
+}
+
+static uint8_t cmos_read(uint8_t reg) {
+    cpu_outb(CMOS_ADDRESS, reg);
+    return cpu_inb(CMOS_DATA);
+}
+
+static void clock_read_rtc_registers(uint8_t* registers) {
+    for (uint32_t spin = 0; spin < CLOCK_SPIN_LIMIT; spin++) {
+        if (!(cmos_read(RTC_STATUS_A) & RTC_UPDATE_IN_PROGRESS)) break;
+    }
+    registers[0] = cmos_read(0x00);  // Second
+    registers[1] = cmos_read(0x02);  // Minute
+    registers[2] = cmos_read(0x04);  // Hour
+    registers[3] = cmos_read(0x07);  // Day
+    registers[4] = cmos_read(0x08);  // Month
+    registers[5] = cmos_read(0x09);  // Year in century
+}
+
+static inline uint32_t bcd_to_binary(uint8_t value) {
+    return (value & 0x0F) + (value >> 4) * 10;
+}
+
+// Days from 1970-01-01 to a proleptic Gregorian date
+static uint32_t clock_days_from_civil(uint32_t year, uint32_t month, uint32_t day) {
+    year -= month <= 2;
+    uint32_t era = year / 400;
+    uint32_t year_of_era = year - era * 400;
+    uint32_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+// RTC time as seconds since the Unix epoch. The registers are read until
+// two passes agree, so an update between reads cannot tear the result.
+static uint32_t clock_read_rtc(void) {
+    uint8_t now[6], last[6];
+    clock_read_rtc_registers(now);
+    do {
+        memcpy(last, now, sizeof(now));
+        clock_read_rtc_registers(now);
+    } while (memcmp(last, now, sizeof(now)) != 0);
+
+    uint8_t status = cmos_read(RTC_STATUS_B);
+    bool pm = now[2] & 0x80;
+    now[2] &= 0x7F;
+
+    uint32_t fields[6];
+    for (int i = 0; i < 6; i++) {
+        fields[i] = (status & RTC_BINARY) ? now[i] : bcd_to_binary(now[i]);
+    }
+    if (!(status & RTC_24_HOUR)) {
+        fields[2] = fields[2] % 12 + (pm ? 12 : 0);
+    }
+
+    // No reliable century register, assume 1970-2069
+    uint32_t year = fields[5] + (fields[5] < 70 ? 2000 : 1900);
+    uint32_t days = clock_days_from_civil(year, fields[4], fields[3]);
+    return days * 86400 + fields[2] * 3600 + fields[1] * 60 + fields[0];
+}
+
+// Calibrate the TSC and read the wall clock, called once at boot
+void time_init(void) {
+    clock_boot_unix = clock_read_rtc();
+
+    if (cpu_has_feature_edx(CPUID_EDX_TSC)) {
+        // The shortest run is the one least disturbed by SMIs or a
+        // hypervisor
+        uint32_t count = PIT_FREQUENCY * CLOCK_CALIBRATE_MS / 1000;
+        uint64_t ticks = 0;
+        for (int run = 0; run < CLOCK_CALIBRATE_RUNS; run++) {
+            uint64_t measured = clock_measure_tsc(count);
+            if (measured != 0 && (ticks == 0 || measured < ticks)) ticks = measured;
+        }
+
+        uint64_t hz = clock_div64(ticks * PIT_FREQUENCY, count);
+        if (hz >= 1000000 && (hz >> 32) == 0) {
+            // Largest shift whose multiplier still fits in 32 bits
+            uint32_t shift = 32;
+            uint64_t mult = clock_div64((uint64_t)NS_PER_SECOND << shift, hz);
+            while ((mult >> 32) != 0) {
+                shift--;
+                mult = clock_div64((uint64_t)NS_PER_SECOND << shift, hz);
+            }
+            clock_tsc_khz = (uint32_t)hz / 1000;
+            clock_shift = shift;
+            clock_mult = (uint32_t)mult;
+            clock_tsc_base = cpu_rdtsc();
+        }
+    }
+    clock_ready = true;
+}
+
+// Nanoseconds since time_init at a TSC reading, 0 without the TSC clock
+static uint64_t clock_tsc_to_ns(uint64_t tsc) {
+    if (clock_mult == 0 || tsc < clock_tsc_base) return 0;
+    return clock_scale(tsc - clock_tsc_base, clock_mult, clock_shift);
+}
+
+// Monotonic nanoseconds since time_init
 uint64_t time_get_current(void) {
-    // TODO: Implement system time
-    return 0;
+    if (clock_mult != 0) {
+        return clock_tsc_to_ns(cpu_rdtsc());
+    }
+    if (!clock_ready) return 0;
+    return (uint64_t)(clock_read_rtc() - clock_boot_unix) * NS_PER_SECOND;
+}
+
+uint32_t time_ns_to_ms(uint64_t ns) {
+    return (uint32_t)clock_div64(ns, 1000000);
+}
+
+// Calibrated TSC frequency, 0 when the clock does not use the TSC
+uint32_t time_get_tsc_khz(void) {
+    return clock_tsc_khz;
 }
 
+// Wall-clock seconds since the Unix epoch
+uint32_t time_get_unix(void) {
+    return clock_boot_unix + (uint32_t)clock_div64(time_get_current(), NS_PER_SECOND);
+}
+
+// A process sleeps on the scheduler. Elsewhere the CPU halts between
+// timer interrupts, and only spins without the timer or with interrupts
+// off.
 void time_sleep(uint64_t milliseconds) {
-    // TODO: Implement sleep
+    uint64_t deadline = time_get_current() + milliseconds * 1000000;
+    while (time_get_current() < deadline) {
+        if (process_sleep_until(deadline)) continue;
+
+        uint32_t flags = cpu_interrupts_save();
+        bool halted = (flags & EFLAGS_IF) && timer_idle(deadline);
+        cpu_interrupts_restore(flags);
+        if (!halted) __asm__ volatile("pause");
+    }
 }
 
 void time_get_date_time(date_time_t* date_time) {
     if (date_time == NULL) return;
 
-    // TODO: Implement date/time getting
-    date_time->year = 0;
-    date_time->month = 0;
-    date_time->day = 0;
-    date_time->hour = 0;
-    date_time->minute = 0;
-    date_time->second = 0;
+    uint32_t seconds = time_get_unix();
+    uint32_t days = seconds / 86400;
+    seconds %= 86400;
+
+    // Inverse of clock_days_from_civil
+    uint32_t shifted = days + 719468;
+    uint32_t era = shifted / 146097;
+    uint32_t day_of_era = shifted - era * 146097;
+    uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    uint32_t month_index = (5 * day_of_year + 2) / 153;
+    uint32_t month = month_index < 10 ? month_index + 3 : month_index - 9;
+
+    date_time->year = year_of_era + era * 400 + (month <= 2);
+    date_time->month = month;
+    date_time->day = day_of_year - (153 * month_index + 2) / 5 + 1;
+    date_time->hour = seconds / 3600;
+    date_time->minute = seconds / 60 % 60;
+    date_time->second = seconds % 60;
+}
+
+// Random number functions. The kernel runs on one CPU, so the per-CPU
+// state is a single instance; it needs no lock because nothing else
+// touches it.
+static random_state_t random_cpu_state = { { 0x9E3779B9, 0x243F6A88, 0xB7E15162, 0x6A09E667 } };
+
+static inline uint32_t random_rotl(uint32_t value, uint32_t count) {
+    return (value << count) | (value >> (32 - count));
+}
+
+// Expand a 32-bit seed into a full state, splitmix style, so that close
+// seeds still give unrelated sequences
+void random_seed(random_state_t* state, uint32_t seed) {
+    uint32_t nonzero = 0;
+    for (int i = 0; i < 4; i++) {
+        seed += 0x9E3779B9;
+        state->s[i] = hash_mix32(seed);
+        nonzero |= state->s[i];
+    }
+    // The all-zero state is a fixed point
+    if (nonzero == 0) state->s[0] = 1;
+}
+
+uint32_t random_next(random_state_t* state) {
+    uint32_t* s = state->s;
+    uint32_t result = random_rotl(s[1] * 5, 7) * 9;
+    uint32_t shifted = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= shifted;
+    s[3] = random_rotl(s[3], 11);
+    return result;
+}
+
+// Uniform value in [0, bound) by multiply-and-reject: the high half of
+// value * bound is the result, and the rare draws that would bias it are
+// retried. Returns 0 for a zero bound.
+uint32_t random_next_bounded(random_state_t* state, uint32_t bound) {
+    uint64_t product = (uint64_t)random_next(state) * bound;
+    uint32_t low = (uint32_t)product;
+    if (low < bound) {
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            product = (uint64_t)random_next(state) * bound;
+            low = (uint32_t)product;
+        }
+    }
+    return product >> 32;
+}
+
+// 32 bits of boot-time entropy, fresh on every call. RDSEED and RDRAND
+// may fail transiently, so each is retried a few times; without either,
+// the timing jitter of a short loop is folded into a hash of TSC deltas.
+// Returns 0 when the CPU offers no source at all.
+static uint32_t random_entropy(void) {
+    uint32_t value;
+    if (cpu_has_feature_7_ebx(CPUID_7_EBX_RDSEED)) {
+        for (int retry = 0; retry < 16; retry++) {
+            if (cpu_rdseed(&value)) return value;
+        }
+    }
+    if (cpu_has_feature_ecx(CPUID_ECX_RDRAND)) {
+        for (int retry = 0; retry < 16; retry++) {
+            if (cpu_rdrand(&value)) return value;
+        }
+    }
+    if (!cpu_has_feature_edx(CPUID_EDX_TSC)) return 0;
+
+    value = 0;
+    for (int sample = 0; sample < 64; sample++) {
+        uint32_t start = (uint32_t)cpu_rdtsc();
+        for (volatile int spin = 0; spin < (sample & 7) + 8; spin++) {
+        }
+        value = hash_mix32(value ^ ((uint32_t)cpu_rdtsc() - start)) + sample;
+    }
+    return value;
 }
 
-// Random number functions
+// Seed the kernel generator. Every state word takes its own entropy
+// draw, so the state holds up to 128 bits of it rather than 32, and the
+// expansion of the caller's seed is mixed into each word on top.
 void random_init(uint32_t seed) {
-    // TODO: Implement random number initialization
+    random_state_t expanded;
+    random_seed(&expanded, seed);
+
+    uint32_t nonzero = 0;
+    for (int i = 0; i < 4; i++) {
+        random_cpu_state.s[i] = random_entropy() ^ expanded.s[i];
+        nonzero |= random_cpu_state.s[i];
+    }
+    if (nonzero == 0) random_cpu_state.s[0] = 1;
 }
 
 uint32_t random_get(void) {
-    // TODO: Implement random number generation
-    return 0;
+    return random_next(&random_cpu_state);
+}
+
+uint32_t random_get_bounded(uint32_t bound) {
+    return random_next_bounded(&random_cpu_state, bound);
 }
 
+// Uniform value in [min, max]
 uint32_t random_get_range(uint32_t min, uint32_t max) {
     if (min >= max) return min;
-    return min + (random_get() % (max - min + 1));
+
+    uint32_t span = max - min + 1;
+    if (span == 0) return random_get();
+    return min + random_get_bounded(span);
 }
 
 // Math functions
@@ -137,25 +452,284 @@ bool bit_test(uint32_t value, uint32_t bit) {
 }
 
 uint32_t bit_count(uint32_t value) {
+    return bit_popcount(value);
+}
+
+// Serial port, COM1 polled with its interrupt left off
+#define SERIAL_PORT           0x3F8
+#define SERIAL_LINE_STATUS    (SERIAL_PORT + 5)
+#define SERIAL_TRANSMIT_EMPTY 0x20
+#define SERIAL_SPIN_LIMIT     100000
+
+static bool serial_present = false;
+
+static void serial_init(void) {
+    cpu_outb(SERIAL_PORT + 1, 0x00);  // No interrupts
+    cpu_outb(SERIAL_PORT + 3, 0x80);  // Divisor latch access
+    cpu_outb(SERIAL_PORT + 0, 0x01);  // 115200 baud
+    cpu_outb(SERIAL_PORT + 1, 0x00);
+    cpu_outb(SERIAL_PORT + 3, 0x03);  // 8 bits, no parity, one stop bit
+    cpu_outb(SERIAL_PORT + 2, 0xC7);  // FIFOs on and cleared
+    cpu_outb(SERIAL_PORT + 4, 0x03);  // DTR and RTS
+
+    // Without a UART the bus floats and reads back all ones
+    serial_present = cpu_inb(SERIAL_LINE_STATUS) != 0xFF;
+}
+
+static void serial_putchar(char c) {
+    for (uint32_t spin = 0; !(cpu_inb(SERIAL_LINE_STATUS) & SERIAL_TRANSMIT_EMPTY); spin++) {
+        if (spin == SERIAL_SPIN_LIMIT) return;
+    }
+    cpu_outb(SERIAL_PORT, c);
+}
+
+static void serial_write(const char* data) {
+    if (!serial_present) return;
+    for (; *data != '\0'; data++) {
+        if (*data == '\n') serial_putchar('\r');
+        serial_putchar(*data);
+    }
+}
+
+// Formatting of pre-collected 32-bit arguments, shared by the log
+// readers and debug_print
+static inline bool format_is_conversion(char c) {
+    switch (c) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'p': case 'c': case 's':
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Number of arguments a format consumes, capped at LOG_MAX_ARGS
+static uint32_t format_count_args(const char* format) {
     uint32_t count = 0;
-    while (value) {
-        count += value & 1;
-        value >>= 1;
+    while (*format != '\0') {
+        if (*format++ != '%') continue;
+        while (*format == 'l' || (*format >= '0' && *format <= '9')) format++;
+        if (*format == '\0') break;
+        if (format_is_conversion(*format)) count++;
+        format++;
+    }
+    return count < LOG_MAX_ARGS ? count : LOG_MAX_ARGS;
+}
+
+static inline void format_put(char* buffer, size_t size, size_t* length, char c) {
+    if (*length + 1 < size) buffer[(*length)++] = c;
+}
+
+// Digits of value, most significant first; returns the count
+static size_t format_number(char* digits, uint32_t value, uint32_t base, bool upper) {
+    const char* symbols = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char reversed[12];
+    size_t count = 0;
+    do {
+        reversed[count++] = symbols[value % base];
+        value /= base;
+    } while (value != 0);
+
+    for (size_t i = 0; i < count; i++) {
+        digits[i] = reversed[count - 1 - i];
     }
     return count;
 }
 
-// Logging functions
+// Format into buffer, always NUL-terminated. Returns the length written.
+static size_t format_args(char* buffer, size_t size, const char* format, const uint32_t* args, uint32_t count) {
+    if (buffer == NULL || size == 0) return 0;
+
+    size_t length = 0;
+    uint32_t used = 0;
+    for (; *format != '\0'; format++) {
+        if (*format != '%') {
+            format_put(buffer, size, &length, *format);
+            continue;
+        }
+
+        format++;
+        bool zero = *format == '0';
+        uint32_t width = 0;
+        while (*format >= '0' && *format <= '9') {
+            width = width * 10 + (*format++ - '0');
+        }
+        while (*format == 'l') format++;
+
+        char conversion = *format;
+        if (conversion == '\0') break;
+        if (!format_is_conversion(conversion)) {
+            format_put(buffer, size, &length, '%');
+            if (conversion != '%') format_put(buffer, size, &length, conversion);
+            continue;
+        }
+
+        uint32_t value = used < count ? args[used++] : 0;
+        char digits[12];
+        const char* text = digits;
+        size_t text_length;
+        bool negative = false;
+        switch (conversion) {
+            case 'd':
+            case 'i':
+                negative = (int32_t)value < 0;
+                text_length = format_number(digits, negative ? -value : value, 10, false);
+                break;
+            case 'u':
+                text_length = format_number(digits, value, 10, false);
+                break;
+            case 'p':
+                format_put(buffer, size, &length, '0');
+                format_put(buffer, size, &length, 'x');
+                zero = true;
+                width = 8;
+                /* fall through */
+            case 'x':
+            case 'X':
+                text_length = format_number(digits, value, 16, conversion == 'X');
+                break;
+            case 'c':
+                digits[0] = (char)value;
+                text_length = 1;
+                break;
+            default:
+                text = value != 0 ? (const char*)value : "(null)";
+                text_length = strlen(text);
+                break;
+        }
+
+        size_t padding = width > text_length + negative ? width - text_length - negative : 0;
+        if (negative && zero) format_put(buffer, size, &length, '-');
+        while (padding-- > 0) format_put(buffer, size, &length, zero ? '0' : ' ');
+        if (negative && !zero) format_put(buffer, size, &length, '-');
+        for (size_t i = 0; i < text_length; i++) {
+            format_put(buffer, size, &length, text[i]);
+        }
+    }
+
+    buffer[length] = '\0';
+    return length;
+}
+
+// Logging functions. The ring is lock-free: a writer claims a slot with
+// one atomic increment of the head, so interrupt handlers can log while
+// the code they interrupted is halfway through a record. A record is
+// published by storing its sequence last; readers copy a record and
+// check the sequence again to detect that it was overwritten meanwhile.
+// There is a single CPU, so the per-CPU ring is one instance.
+#define LOG_LINE_LENGTH 160
+
+static log_record_t log_ring[LOG_RING_SIZE];
+static uint32_t log_head = 0;
+static log_level_t log_min_level = LOG_INFO;
+static bool log_has_tsc = false;
+static log_cursor_t log_serial_cursor;
+
+static const char* const log_level_names[] = { "debug", "info", "warning", "error" };
+
+// After time_init: records are only stamped when the clock runs on the TSC
 void log_init(void) {
-    // TODO: Implement logging initialization
+    log_has_tsc = time_get_tsc_khz() != 0;
+    serial_init();
 }
 
 void log_write(log_level_t level, const char* format, ...) {
-    // TODO: Implement logging
+    if (level < log_min_level || format == NULL) return;
+
+    uint32_t index = __atomic_fetch_add(&log_head, 1, __ATOMIC_RELAXED);
+    log_record_t* record = &log_ring[index & (LOG_RING_SIZE - 1)];
+
+    // Mark the slot busy first, so a reader copying the record it held
+    // one lap ago sees the sequence change
+    __atomic_store_n(&record->sequence, index - LOG_RING_SIZE, __ATOMIC_RELAXED);
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+    record->timestamp = log_has_tsc ? cpu_rdtsc() : 0;
+    record->format = format;
+    record->level = level;
+    record->arg_count = format_count_args(format);
+
+    va_list args;
+    va_start(args, format);
+    for (uint32_t i = 0; i < record->arg_count; i++) {
+        record->args[i] = va_arg(args, uint32_t);
+    }
+    va_end(args);
+
+    __atomic_store_n(&record->sequence, index + 1, __ATOMIC_RELEASE);
 }
 
+// Drop records below level, LOG_INFO and up are kept by default
 void log_set_level(log_level_t level) {
-    // TODO: Implement log level setting
+    log_min_level = level;
+}
+
+// Start a cursor at the oldest record still in the ring
+void log_cursor_init(log_cursor_t* cursor) {
+    uint32_t head = __atomic_load_n(&log_head, __ATOMIC_ACQUIRE);
+    cursor->next = head > LOG_RING_SIZE ? head - LOG_RING_SIZE : 0;
+    cursor->lost = 0;
+}
+
+// Copy out the next record. Returns false when the reader has caught up
+// or the next record is still being written.
+bool log_read(log_cursor_t* cursor, log_record_t* record) {
+    for (;;) {
+        uint32_t head = __atomic_load_n(&log_head, __ATOMIC_ACQUIRE);
+        if (cursor->next == head) return false;
+
+        // Skip what the writers have already lapped
+        if (head - cursor->next > LOG_RING_SIZE) {
+            cursor->lost += head - cursor->next - LOG_RING_SIZE;
+            cursor->next = head - LOG_RING_SIZE;
+        }
+
+        const log_record_t* slot = &log_ring[cursor->next & (LOG_RING_SIZE - 1)];
+        uint32_t expected = cursor->next + 1;
+        int32_t distance = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - expected);
+        if (distance < 0) return false;
+
+        if (distance == 0) {
+            *record = *slot;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == expected) {
+                cursor->next++;
+                return true;
+            }
+        }
+
+        // Overwritten before or while we copied it
+        cursor->lost++;
+        cursor->next++;
+    }
+}
+
+// Format a record as one line without a newline, prefixed with the
+// seconds since boot, or with the sequence number for unstamped records
+size_t log_format(const log_record_t* record, char* buffer, size_t size) {
+    const char* level = log_level_names[record->level & 3];
+    size_t length;
+    if (record->timestamp != 0) {
+        uint32_t ms = time_ns_to_ms(clock_tsc_to_ns(record->timestamp));
+        uint32_t prefix[3] = { ms / 1000, ms % 1000, (uint32_t)level };
+        length = format_args(buffer, size, "[%5u.%03u] %s: ", prefix, 3);
+    } else {
+        uint32_t prefix[2] = { record->sequence - 1, (uint32_t)level };
+        length = format_args(buffer, size, "[%8u] %s: ", prefix, 2);
+    }
+    return length + format_args(buffer + length, size - length, record->format,
+                                record->args, record->arg_count);
+}
+
+// Write out every record the serial port has not seen yet
+void log_flush_serial(void) {
+    log_record_t record;
+    char line[LOG_LINE_LENGTH];
+    while (log_read(&log_serial_cursor, &record)) {
+        size_t length = log_format(&record, line, sizeof(line) - 1);
+        line[length] = '\n';
+        line[length + 1] = '\0';
+        serial_write(line);
+    }
 }
 
 // Debug functions
@@ -163,8 +737,23 @@ void debug_break(void) {
     // TODO: Implement debug break
 }
 
+// Format immediately and write straight to the serial port, for when
+// the log ring may never be drained
 void debug_print(const char* format, ...) {
-    // TODO: Implement debug printing
+    if (format == NULL) return;
+
+    uint32_t args[LOG_MAX_ARGS];
+    uint32_t count = format_count_args(format);
+    va_list list;
+    va_start(list, format);
+    for (uint32_t i = 0; i < count; i++) {
+        args[i] = va_arg(list, uint32_t);
+    }
+    va_end(list);
+
+    char line[LOG_LINE_LENGTH];
+    format_args(line, sizeof(line), format, args, count);
+    serial_write(line);
 }
 
 void debug_dump_memory(const void* ptr, size_t size) {
@@ -172,16 +761,16 @@ void debug_dump_memory(const void* ptr, size_t size) {
 }
 
 // Error handling functions
-void error_set(error_code_t code, const char* message) {
+void error_set(error_t code, const char* message) {
     // TODO: Implement error setting
 }
 
-error_code_t error_get(void) {
+error_t error_get(void) {
     // TODO: Implement error getting
-    return ERROR_NONE;
+    return ERR_NONE;
 }
 
-const char* error_get_message(error_code_t code) {
+const char* error_get_message(error_t code) {
     // TODO: Implement error message getting
     return "Unknown error";
 }
@@ -191,48 +780,619 @@ void assert_fail(const char* file, int line, const char* function, const char* m
     // TODO: Implement assertion failure
 }
 
-// CRC functions
+// CRC functions. CRC32 (IEEE 802.3) and CRC32C (Castagnoli) are
+// reflected and use slicing-by-8: eight 256-entry tables let the main
+// loop fold 8 input bytes per step. Tables are built on first use.
+// All *_update functions take the previous result (0 to start) so data
+// can be checksummed in chunks.
+#define CRC32_POLYNOMIAL  0xEDB88320
+#define CRC32C_POLYNOMIAL 0x82F63B78
+#define CRC16_POLYNOMIAL  0xA001
+
+typedef uint32_t crc_word_t __attribute__((may_alias));
+
+static uint32_t crc32_table[8][256];
+static uint32_t crc32c_table[8][256];
+static uint16_t crc16_table[256];
+static bool crc_tables_ready = false;
+static bool crc32c_hardware = false;
+
+static void crc_build_slices(uint32_t table[8][256], uint32_t polynomial) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (polynomial & -(crc & 1));
+        }
+        table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int slice = 1; slice < 8; slice++) {
+            uint32_t previous = table[slice - 1][i];
+            table[slice][i] = (previous >> 8) ^ table[0][previous & 0xFF];
+        }
+    }
+}
+
+static void crc_init(void) {
+    crc_build_slices(crc32_table, CRC32_POLYNOMIAL);
+    crc_build_slices(crc32c_table, CRC32C_POLYNOMIAL);
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC16_POLYNOMIAL & -(crc & 1));
+        }
+        crc16_table[i] = crc;
+    }
+
+    crc32c_hardware = cpu_has_feature_ecx(CPUID_ECX_SSE4_2);
+    crc_tables_ready = true;
+}
+
+static uint32_t crc_slice_by_8(uint32_t table[8][256], uint32_t crc, const uint8_t* p, size_t size) {
+    crc = ~crc;
+    while (size > 0 && ((uint32_t)p & 3)) {
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        size--;
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t one = *(const crc_word_t*)p ^ crc;
+        uint32_t two = *(const crc_word_t*)(p + 4);
+        crc = table[7][one & 0xFF] ^ table[6][(one >> 8) & 0xFF] ^
+              table[5][(one >> 16) & 0xFF] ^ table[4][one >> 24] ^
+              table[3][two & 0xFF] ^ table[2][(two >> 8) & 0xFF] ^
+              table[1][(two >> 16) & 0xFF] ^ table[0][two >> 24];
+    }
+    while (size-- > 0) {
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// CRC32C with the SSE4.2 crc32 instruction, 4 bytes per step
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* p, size_t size) {
+    crc = ~crc;
+    while (size > 0 && ((uint32_t)p & 3)) {
+        __asm__("crc32b %1, %0" : "+r"(crc) : "rm"(*p));
+        p++;
+        size--;
+    }
+    for (; size >= 4; size -= 4, p += 4) {
+        __asm__("crc32l %1, %0" : "+r"(crc) : "rm"(*(const crc_word_t*)p));
+    }
+    while (size-- > 0) {
+        __asm__("crc32b %1, %0" : "+r"(crc) : "rm"(*p));
+        p++;
+    }
+    return ~crc;
+}
+
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size) {
+    if (data == NULL) return crc;
+    if (!crc_tables_ready) crc_init();
+    return crc_slice_by_8(crc32_table, crc, data, size);
+}
+
 uint32_t crc32(const void* data, size_t size) {
-    // TODO: Implement CRC32
-    return 0;
+    return crc32_update(0, data, size);
+}
+
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t size) {
+    if (data == NULL) return crc;
+    if (!crc_tables_ready) crc_init();
+    if (crc32c_hardware) return crc32c_sse42(crc, data, size);
+    return crc_slice_by_8(crc32c_table, crc, data, size);
+}
+
+uint32_t crc32c(const void* data, size_t size) {
+    return crc32c_update(0, data, size);
+}
+
+// CRC-16/ARC: reflected polynomial 0x8005, initial value 0
+uint16_t crc16_update(uint16_t crc, const void* data, size_t size) {
+    if (data == NULL) return crc;
+    if (!crc_tables_ready) crc_init();
+
+    const uint8_t* p = data;
+    while (size-- > 0) {
+        crc = crc16_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
 }
 
 uint16_t crc16(const void* data, size_t size) {
-    // TODO: Implement CRC16
-    return 0;
+    return crc16_update(0, data, size);
+}
+
+// Hash functions. Both have an incremental form so a key can be hashed
+// in pieces; the one-shot versions use a zero seed.
+#define FNV1A_OFFSET_BASIS 0x811C9DC5
+#define FNV1A_PRIME        0x01000193
+
+uint32_t hash_fnv1a_update(uint32_t hash, const void* data, size_t size) {
+    const uint8_t* p = data;
+    while (size-- > 0) {
+        hash = (hash ^ *p++) * FNV1A_PRIME;
+    }
+    return hash;
 }
 
-// Hash functions
 uint32_t hash_fnv1a(const void* data, size_t size) {
-    // TODO: Implement FNV-1a hash
-    return 0;
+    if (data == NULL) return FNV1A_OFFSET_BASIS;
+    return hash_fnv1a_update(FNV1A_OFFSET_BASIS, data, size);
+}
+
+#define MURMUR3_C1 0xCC9E2D51
+#define MURMUR3_C2 0x1B873593
+
+static inline uint32_t murmur3_rotl(uint32_t x, uint32_t r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t murmur3_mix_block(uint32_t k) {
+    k *= MURMUR3_C1;
+    k = murmur3_rotl(k, 15);
+    return k * MURMUR3_C2;
+}
+
+void hash_murmur3_init(murmur3_state_t* state, uint32_t seed) {
+    state->hash = seed;
+    state->tail = 0;
+    state->tail_length = 0;
+    state->total_length = 0;
+}
+
+// MurmurHash3 x86_32 over data arriving in arbitrary chunks
+void hash_murmur3_update(murmur3_state_t* state, const void* data, size_t size) {
+    const uint8_t* p = data;
+    state->total_length += size;
+
+    // Complete a block left over from the previous chunk
+    while (size > 0 && state->tail_length > 0) {
+        state->tail |= (uint32_t)*p++ << (8 * state->tail_length);
+        size--;
+        if (++state->tail_length == 4) {
+            state->hash ^= murmur3_mix_block(state->tail);
+            state->hash = murmur3_rotl(state->hash, 13) * 5 + 0xE6546B64;
+            state->tail = 0;
+            state->tail_length = 0;
+        }
+    }
+
+    for (; size >= 4; size -= 4, p += 4) {
+        uint32_t k = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        state->hash ^= murmur3_mix_block(k);
+        state->hash = murmur3_rotl(state->hash, 13) * 5 + 0xE6546B64;
+    }
+
+    while (size-- > 0) {
+        state->tail |= (uint32_t)*p++ << (8 * state->tail_length++);
+    }
+}
+
+uint32_t hash_murmur3_final(const murmur3_state_t* state) {
+    uint32_t hash = state->hash;
+    if (state->tail_length > 0) {
+        hash ^= murmur3_mix_block(state->tail);
+    }
+    hash ^= state->total_length;
+    return hash_mix32(hash);
 }
 
 uint32_t hash_murmur3(const void* data, size_t size) {
-    // TODO: Implement MurmurHash3
-    return 0;
+    murmur3_state_t state;
+    hash_murmur3_init(&state, 0);
+    if (data != NULL) hash_murmur3_update(&state, data, size);
+    return hash_murmur3_final(&state);
+}
+
+// Base64 (RFC 4648) and hex codecs. Bulk data goes through SSSE3 when the
+// CPU has it and SSE is enabled: pshufb serves as a 16-entry lookup table,
+// so 12 bytes are encoded, or 16 base64 characters decoded and validated,
+// per step. The scalar loops handle the remainder and older CPUs, and
+// report errors precisely when a vector block is rejected.
+typedef char v16qi __attribute__((vector_size(16)));
+typedef uint8_t v16qu __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef uint16_t v8hu __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+typedef char v16qi_u __attribute__((vector_size(16), aligned(1), may_alias));
+typedef uint32_t codec_u32 __attribute__((aligned(1), may_alias));
+
+static const char base64_alphabet[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char hex_digits[16] = "0123456789abcdef";
+
+static int8_t base64_values[256];  // -1 for characters outside the alphabet
+static bool codec_ready = false;
+static bool codec_ssse3 = false;
+
+static void codec_init(void) {
+    memset(base64_values, -1, sizeof(base64_values));
+    for (int i = 0; i < 64; i++) {
+        base64_values[(uint8_t)base64_alphabet[i]] = i;
+    }
+
+    codec_ssse3 = cpu_has_feature_ecx(CPUID_ECX_SSSE3) && cpu_sse_enabled();
+    codec_ready = true;
+}
+
+static inline bool codec_use_ssse3(void) {
+    return codec_ssse3 && !interrupt_in_handler();
+}
+
+// Turn the SSSE3 paths off, or back on where the CPU has them. Returns
+// whether they are in use.
+bool codec_set_ssse3(bool enable) {
+    if (!codec_ready) codec_init();
+    codec_ssse3 = enable && cpu_has_feature_ecx(CPUID_ECX_SSSE3) && cpu_sse_enabled();
+    return codec_ssse3;
+}
+
+// Encode 12 bytes per step. Each step loads 16, so the loop stops while
+// 16 bytes are still readable. Returns the number of bytes consumed.
+__attribute__((target("ssse3")))
+static size_t base64_encode_ssse3(const uint8_t* in, size_t size, char* out) {
+    const v16qi spread = { 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 };
+    const v16qi offsets = { 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                            '+' - 62, '/' - 63, 'A', 0, 0 };
+    size_t done = 0;
+    for (; size - done >= 16; done += 12, out += 16) {
+        // Split each 3-byte group into four 6-bit indices, one per byte
+        v4si bytes = (v4si)__builtin_ia32_pshufb128(*(const v16qi_u*)(in + done), spread);
+        v8hi high = __builtin_ia32_pmulhuw128((v8hi)(bytes & 0x0FC0FC00), (v8hi)(v4si){
+            0x04000040, 0x04000040, 0x04000040, 0x04000040 });
+        v8hi low = (v8hi)(bytes & 0x003F03F0) * (v8hi)(v4si){
+            0x01000010, 0x01000010, 0x01000010, 0x01000010 };
+        v16qi indices = (v16qi)(high | low);
+
+        // Map 0-25, 26-51, 52-61, 62 and 63 to the offset that turns
+        // an index into its character
+        v16qi range = (v16qi)(indices > 51) & (indices - 51);
+        range |= (v16qi)(indices < 26) & 13;
+        *(v16qi_u*)out = __builtin_ia32_pshufb128(offsets, range) + indices;
+    }
+    return done;
+}
+
+// Decode and validate 16 characters per step. Stops at the first block
+// holding a character outside the alphabet, padding included. Returns
+// the number of characters consumed.
+__attribute__((target("ssse3")))
+static size_t base64_decode_ssse3(const char* in, size_t length, uint8_t* out) {
+    const v16qi valid_low = { 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                              0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A };
+    const v16qi valid_high = { 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 };
+    const v16qi offsets = { 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 };
+    const v16qi gather = { 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 };
+    const v16qi zero = { 0 };
+    size_t done = 0;
+    for (; length - done >= 16; done += 16, out += 12) {
+        v16qi chars = *(const v16qi_u*)(in + done);
+        v16qi high_nibbles = (v16qi)((v8hu)chars >> 4) & 0x0F;
+        v16qi low_nibbles = chars & 0x0F;
+
+        // A character is valid when the class bits of its two nibbles
+        // do not intersect
+        v16qi invalid = __builtin_ia32_pshufb128(valid_low, low_nibbles) &
+                        __builtin_ia32_pshufb128(valid_high, high_nibbles);
+        if (__builtin_ia32_pmovmskb128((v16qi)(invalid == zero)) != 0xFFFF) break;
+
+        // '/' shares its high nibble with '+' and needs its own offset
+        v16qi slash = (v16qi)(chars == '/');
+        v16qi values = chars + __builtin_ia32_pshufb128(offsets, high_nibbles + slash);
+
+        // Merge 6-bit values into 12-bit pairs, then 24-bit groups
+        v8hi pairs = __builtin_ia32_pmaddubsw128(values, (v16qi)(v4si){
+            0x01400140, 0x01400140, 0x01400140, 0x01400140 });
+        v4si groups = __builtin_ia32_pmaddwd128(pairs, (v8hi)(v4si){
+            0x00011000, 0x00011000, 0x00011000, 0x00011000 });
+        v4si bytes = (v4si)__builtin_ia32_pshufb128((v16qi)groups, gather);
+
+        codec_u32* words = (codec_u32*)out;
+        words[0] = bytes[0];
+        words[1] = bytes[1];
+        words[2] = bytes[2];
+    }
+    return done;
+}
+
+// Hex encode 16 bytes per step, returns the number consumed
+__attribute__((target("ssse3")))
+static size_t hex_encode_ssse3(const uint8_t* in, size_t size, char* out) {
+    const v16qi digits = *(const v16qi_u*)hex_digits;
+    size_t done = 0;
+    for (; size - done >= 16; done += 16, out += 32) {
+        v16qi bytes = *(const v16qi_u*)(in + done);
+        v16qi high = __builtin_ia32_pshufb128(digits, (v16qi)((v8hu)bytes >> 4) & 0x0F);
+        v16qi low = __builtin_ia32_pshufb128(digits, bytes & 0x0F);
+        *(v16qi_u*)out = __builtin_shuffle(high, low,
+            (v16qi){ 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23 });
+        *(v16qi_u*)(out + 16) = __builtin_shuffle(high, low,
+            (v16qi){ 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31 });
+    }
+    return done;
+}
+
+// Nibble values of 16 hex digits; returns false if any is not a digit
+__attribute__((target("ssse3")))
+static inline bool hex_nibbles_ssse3(const char* in, v16qi* nibbles) {
+    v16qu chars = (v16qu)*(const v16qi_u*)in;
+    v16qu digit = chars - '0';
+    v16qu letter = (chars | 0x20) - 'a';
+    v16qi is_digit = (v16qi)(digit < 10);
+    v16qi is_letter = (v16qi)(letter < 6);
+
+    if (__builtin_ia32_pmovmskb128(is_digit | is_letter) != 0xFFFF) return false;
+    *nibbles = (is_digit & (v16qi)digit) | (is_letter & (v16qi)(letter + 10));
+    return true;
+}
+
+// Hex decode 16 bytes per step, stopping at a block with a bad digit.
+// Returns the number of bytes produced.
+__attribute__((target("ssse3")))
+static size_t hex_decode_ssse3(const char* in, size_t size, uint8_t* out) {
+    const v16qi weights = { 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1 };
+    size_t done = 0;
+    for (; size - done >= 16; done += 16, in += 32) {
+        v16qi first, second;
+        if (!hex_nibbles_ssse3(in, &first) || !hex_nibbles_ssse3(in + 16, &second)) break;
+
+        v8hi low = __builtin_ia32_pmaddubsw128(first, weights);
+        v8hi high = __builtin_ia32_pmaddubsw128(second, weights);
+        *(v16qi_u*)(out + done) = __builtin_ia32_packuswb128(low, high);
+    }
+    return done;
+}
+
+static inline void base64_encode_group(const uint8_t* in, char* out) {
+    uint32_t group = (uint32_t)in[0] << 16 | (uint32_t)in[1] << 8 | in[2];
+    out[0] = base64_alphabet[group >> 18];
+    out[1] = base64_alphabet[(group >> 12) & 0x3F];
+    out[2] = base64_alphabet[(group >> 6) & 0x3F];
+    out[3] = base64_alphabet[group & 0x3F];
+}
+
+// Encode whole 3-byte groups, returns the number of characters written
+static size_t base64_encode_groups(const uint8_t* in, size_t groups, char* out) {
+    size_t size = groups * 3;
+    size_t done = codec_use_ssse3() ? base64_encode_ssse3(in, size, out) : 0;
+    for (; done < size; done += 3) {
+        base64_encode_group(in + done, out + done / 3 * 4);
+    }
+    return groups * 4;
+}
+
+// Decode whole groups that carry no padding
+static size_t base64_decode_groups(const char* in, size_t groups, uint8_t* out) {
+    size_t length = groups * 4;
+    size_t done = codec_use_ssse3() ? base64_decode_ssse3(in, length, out) : 0;
+    for (; done < length; done += 4) {
+        const uint8_t* chars = (const uint8_t*)in + done;
+        int32_t a = base64_values[chars[0]];
+        int32_t b = base64_values[chars[1]];
+        int32_t c = base64_values[chars[2]];
+        int32_t d = base64_values[chars[3]];
+        if ((a | b | c | d) < 0) return CODEC_ERROR;
+
+        uint32_t group = a << 18 | b << 12 | c << 6 | d;
+        uint8_t* bytes = out + done / 4 * 3;
+        bytes[0] = group >> 16;
+        bytes[1] = group >> 8;
+        bytes[2] = group;
+    }
+    return groups * 3;
+}
+
+// Decode a group that may end in padding, returns 1 to 3 bytes
+static size_t base64_decode_last(const char* in, uint8_t* out) {
+    if (in[3] != '=') return base64_decode_groups(in, 1, out);
+
+    int32_t a = base64_values[(uint8_t)in[0]];
+    int32_t b = base64_values[(uint8_t)in[1]];
+    if ((a | b) < 0) return CODEC_ERROR;
+
+    if (in[2] == '=') {
+        if (b & 0x0F) return CODEC_ERROR;
+        out[0] = a << 2 | b >> 4;
+        return 1;
+    }
+
+    int32_t c = base64_values[(uint8_t)in[2]];
+    if (c < 0 || (c & 0x03)) return CODEC_ERROR;
+    out[0] = a << 2 | b >> 4;
+    out[1] = b << 4 | c >> 2;
+    return 2;
+}
+
+void base64_encoder_init(base64_encoder_t* encoder) {
+    encoder->pending_length = 0;
+}
+
+// Encode a chunk, returns the number of characters written
+size_t base64_encode_update(base64_encoder_t* encoder, const void* data, size_t size, char* output) {
+    if (data == NULL || output == NULL) return 0;
+    if (!codec_ready) codec_init();
+
+    const uint8_t* in = data;
+    size_t written = 0;
+
+    // Complete a group started by the previous chunk
+    if (encoder->pending_length > 0) {
+        uint8_t group[3] = { encoder->pending[0], encoder->pending[1], 0 };
+        uint32_t have = encoder->pending_length;
+        while (have < 3 && size > 0) {
+            group[have++] = *in++;
+            size--;
+        }
+        if (have < 3) {
+            encoder->pending[1] = group[1];
+            encoder->pending_length = have;
+            return 0;
+        }
+        base64_encode_group(group, output);
+        encoder->pending_length = 0;
+        written = 4;
+    }
+
+    size_t groups = size / 3;
+    written += base64_encode_groups(in, groups, output + written);
+    in += groups * 3;
+    size -= groups * 3;
+
+    for (uint32_t i = 0; i < size; i++) {
+        encoder->pending[i] = in[i];
+    }
+    encoder->pending_length = size;
+    return written;
+}
+
+// Flush the last partial group with padding and NUL-terminate
+size_t base64_encode_final(base64_encoder_t* encoder, char* output) {
+    if (output == NULL) return 0;
+
+    size_t written = 0;
+    if (encoder->pending_length > 0) {
+        uint8_t a = encoder->pending[0];
+        uint8_t b = encoder->pending_length > 1 ? encoder->pending[1] : 0;
+        output[0] = base64_alphabet[a >> 2];
+        output[1] = base64_alphabet[((a & 0x03) << 4) | (b >> 4)];
+        output[2] = encoder->pending_length > 1 ? base64_alphabet[(b & 0x0F) << 2] : '=';
+        output[3] = '=';
+        written = 4;
+    }
+    output[written] = '\0';
+    encoder->pending_length = 0;
+    return written;
 }
 
-// Base64 functions
 size_t base64_encode(const void* data, size_t size, char* output) {
-    // TODO: Implement Base64 encoding
-    return 0;
+    if (output == NULL) return 0;
+
+    base64_encoder_t encoder;
+    base64_encoder_init(&encoder);
+    size_t written = base64_encode_update(&encoder, data, size, output);
+    return written + base64_encode_final(&encoder, output + written);
+}
+
+void base64_decoder_init(base64_decoder_t* decoder) {
+    decoder->pending_length = 0;
+    decoder->finished = false;
+    decoder->failed = false;
+}
+
+// Decode a chunk, returns the number of bytes written or CODEC_ERROR.
+// Once an error is reported the decoder stays failed.
+size_t base64_decode_update(base64_decoder_t* decoder, const char* input, size_t length, void* output) {
+    if (decoder->failed || input == NULL || output == NULL) return CODEC_ERROR;
+    if (length == 0) return 0;
+    if (decoder->finished) goto fail;
+    if (!codec_ready) codec_init();
+
+    uint8_t* out = output;
+    size_t written = 0;
+    size_t result;
+
+    // Complete a group started by the previous chunk
+    if (decoder->pending_length > 0) {
+        while (decoder->pending_length < 4 && length > 0) {
+            decoder->pending[decoder->pending_length++] = *input++;
+            length--;
+        }
+        if (decoder->pending_length < 4) return 0;
+
+        decoder->pending_length = 0;
+        result = base64_decode_last(decoder->pending, out);
+        if (result == CODEC_ERROR) goto fail;
+        written = result;
+        if (result < 3) goto padded;
+    }
+
+    // Only the last whole group of a chunk may carry padding
+    size_t groups = length / 4;
+    if (groups > 0) {
+        if (base64_decode_groups(input, groups - 1, out + written) == CODEC_ERROR) goto fail;
+        written += (groups - 1) * 3;
+
+        result = base64_decode_last(input + (groups - 1) * 4, out + written);
+        if (result == CODEC_ERROR) goto fail;
+        written += result;
+        input += groups * 4;
+        length -= groups * 4;
+        if (result < 3) goto padded;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        decoder->pending[i] = input[i];
+    }
+    decoder->pending_length = length;
+    return written;
+
+padded:
+    decoder->finished = true;
+    if (length == 0) return written;
+fail:
+    decoder->failed = true;
+    return CODEC_ERROR;
+}
+
+// Check that the input ended on a group boundary without errors
+bool base64_decode_final(const base64_decoder_t* decoder) {
+    return !decoder->failed && decoder->pending_length == 0;
 }
 
 size_t base64_decode(const char* input, void* output) {
-    // TODO: Implement Base64 decoding
-    return 0;
+    if (input == NULL || output == NULL) return CODEC_ERROR;
+
+    base64_decoder_t decoder;
+    base64_decoder_init(&decoder);
+    size_t written = base64_decode_update(&decoder, input, strlen(input), output);
+    if (!base64_decode_final(&decoder)) return CODEC_ERROR;
+    return written;
 }
 
-// Hex functions
+// Lowercase hex
 size_t hex_encode(const void* data, size_t size, char* output) {
-    // TODO: Implement hex encoding
-    return 0;
+    if (output == NULL || (data == NULL && size > 0)) return 0;
+    if (!codec_ready) codec_init();
+
+    const uint8_t* in = data;
+    size_t done = codec_use_ssse3() ? hex_encode_ssse3(in, size, output) : 0;
+    for (; done < size; done++) {
+        output[done * 2] = hex_digits[in[done] >> 4];
+        output[done * 2 + 1] = hex_digits[in[done] & 0x0F];
+    }
+    output[size * 2] = '\0';
+    return size * 2;
+}
+
+static inline int32_t hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
 }
 
+// Accepts either case, the input length must be even
 size_t hex_decode(const char* input, void* output) {
-    // TODO: Implement hex decoding
-    return 0;
+    if (input == NULL || output == NULL) return CODEC_ERROR;
+    if (!codec_ready) codec_init();
+
+    size_t length = strlen(input);
+    if (length & 1) return CODEC_ERROR;
+
+    uint8_t* out = output;
+    size_t size = length / 2;
+    size_t done = codec_use_ssse3() ? hex_decode_ssse3(input, size, out) : 0;
+    for (; done < size; done++) {
+        int32_t high = hex_value(input[done * 2]);
+        int32_t low = hex_value(input[done * 2 + 1]);
+        if ((high | low) < 0) return CODEC_ERROR;
+        out[done] = high << 4 | low;
+    }
+    return size;
 }
 
 // Path functions
@@ -278,49 +1438,244 @@ bool path_join(char* dest, size_t size, const char* path1, const char* path2) {
     return true;
 }
 
-// Command line parsing functions
-bool parse_command_line(int argc, char** argv, command_line_option_t* options, int option_count) {
-    // TODO: Implement command line parsing
-    return true;
+// Configuration functions. Each key owns one entry for the lifetime of
+// the store, so the entry address returned by config_intern never moves
+// and hot paths can read a tunable through it without hashing the key.
+// The name index is a hash_map_t keyed by the entry's own copy of the key.
+#define CONFIG_SNAPSHOT_MAGIC  0x31474643  // "CFG1"
+#define CONFIG_SNAPSHOT_HEADER 12
+#define CONFIG_SNAPSHOT_MAX    (CONFIG_SNAPSHOT_HEADER + \
+                                CONFIG_MAX_ENTRIES * (3 + CONFIG_MAX_KEY + CONFIG_MAX_STRING))
+
+static config_entry_t config_entries[CONFIG_MAX_ENTRIES];
+static uint32_t config_entry_count = 0;
+static hash_map_entry_t config_index_entries[HASH_MAP_CAPACITY(CONFIG_MAX_ENTRIES)];
+static hash_map_t config_index;
+static bool config_ready = false;
+static uint8_t config_snapshot[CONFIG_SNAPSHOT_MAX];
+
+static inline void config_init(void) {
+    hash_map_init(&config_index, config_index_entries, HASH_MAP_CAPACITY(CONFIG_MAX_ENTRIES),
+                  hash_map_hash_string, hash_map_equals_string);
+    config_ready = true;
 }
 
-// Configuration functions
-bool config_load(const char* filename) {
-    // TODO: Implement configuration loading
-    return true;
+static config_entry_t* config_find(const char* key) {
+    if (key == NULL) return NULL;
+    if (!config_ready) config_init();
+    return hash_map_get(&config_index, key);
 }
 
-bool config_save(const char* filename) {
-    // TODO: Implement configuration saving
-    return true;
+// Entry of key, created without a value if it does not exist yet.
+// Returns NULL when the key is too long or the store is full.
+config_entry_t* config_intern(const char* key) {
+    config_entry_t* entry = config_find(key);
+    if (entry != NULL) return entry;
+
+    size_t length = strlen(key);
+    if (length == 0 || length > CONFIG_MAX_KEY || config_entry_count == CONFIG_MAX_ENTRIES) {
+        return NULL;
+    }
+
+    entry = &config_entries[config_entry_count++];
+    memcpy(entry->key, key, length + 1);
+    entry->type = CONFIG_NONE;
+    hash_map_put(&config_index, entry->key, entry);
+    return entry;
+}
+
+// Entries in creation order, for listing the store
+const config_entry_t* config_get_entry(uint32_t index) {
+    return index < config_entry_count ? &config_entries[index] : NULL;
 }
 
 const char* config_get_string(const char* key) {
-    // TODO: Implement string configuration getting
-    return NULL;
+    const config_entry_t* entry = config_find(key);
+    return entry != NULL && entry->type == CONFIG_STRING ? entry->value.string : NULL;
 }
 
 int config_get_int(const char* key) {
-    // TODO: Implement integer configuration getting
-    return 0;
+    return config_entry_int(config_find(key), 0);
 }
 
 bool config_get_bool(const char* key) {
-    // TODO: Implement boolean configuration getting
-    return false;
+    return config_entry_bool(config_find(key), false);
 }
 
 bool config_set_string(const char* key, const char* value) {
-    // TODO: Implement string configuration setting
+    if (value == NULL) return false;
+    size_t length = strlen(value);
+    if (length > CONFIG_MAX_STRING) return false;
+
+    config_entry_t* entry = config_intern(key);
+    if (entry == NULL) return false;
+    memcpy(entry->value.string, value, length + 1);
+    entry->type = CONFIG_STRING;
     return true;
 }
 
 bool config_set_int(const char* key, int value) {
-    // TODO: Implement integer configuration setting
+    config_entry_t* entry = config_intern(key);
+    if (entry == NULL) return false;
+    entry->value.number = value;
+    entry->type = CONFIG_INT;
     return true;
 }
 
 bool config_set_bool(const char* key, bool value) {
-    // TODO: Implement boolean configuration setting
+    config_entry_t* entry = config_intern(key);
+    if (entry == NULL) return false;
+    entry->value.flag = value;
+    entry->type = CONFIG_BOOL;
     return true;
-} 
\ No newline at end of file
+}
+
+static inline void config_put_u32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static inline uint32_t config_get_u32(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Serialize every entry that has a value. The snapshot is a header of
+// magic, entry count and CRC32 of the body, then per entry its type, key
+// length and value length bytes followed by the key and the value; ints
+// are 4 bytes little-endian, bools 1 byte, strings unterminated. Returns
+// the snapshot size, or 0 if it does not fit.
+size_t config_save_buffer(void* buffer, size_t size) {
+    if (buffer == NULL || size < CONFIG_SNAPSHOT_HEADER) return 0;
+
+    uint8_t* out = buffer;
+    size_t length = CONFIG_SNAPSHOT_HEADER;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < config_entry_count; i++) {
+        const config_entry_t* entry = &config_entries[i];
+        if (entry->type == CONFIG_NONE) continue;
+
+        uint8_t value[4];
+        const void* data = value;
+        size_t key_length = strlen(entry->key);
+        size_t value_length;
+        switch (entry->type) {
+            case CONFIG_INT:
+                config_put_u32(value, (uint32_t)entry->value.number);
+                value_length = 4;
+                break;
+            case CONFIG_BOOL:
+                value[0] = entry->value.flag;
+                value_length = 1;
+                break;
+            default:
+                data = entry->value.string;
+                value_length = strlen(entry->value.string);
+                break;
+        }
+
+        if (length + 3 + key_length + value_length > size) return 0;
+        out[length++] = entry->type;
+        out[length++] = key_length;
+        out[length++] = value_length;
+        memcpy(out + length, entry->key, key_length);
+        length += key_length;
+        memcpy(out + length, data, value_length);
+        length += value_length;
+        count++;
+    }
+
+    config_put_u32(out, CONFIG_SNAPSHOT_MAGIC);
+    config_put_u32(out + 4, count);
+    config_put_u32(out + 8, crc32(out + CONFIG_SNAPSHOT_HEADER, length - CONFIG_SNAPSHOT_HEADER));
+    return length;
+}
+
+// Walk the entries of a snapshot body. Without apply it only checks that
+// every record is well formed and that the new keys fit in the store.
+static bool config_walk_snapshot(const uint8_t* data, size_t size, uint32_t count, bool apply) {
+    uint32_t new_keys = 0;
+    size_t offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (size - offset < 3) return false;
+        uint8_t type = data[offset];
+        uint8_t key_length = data[offset + 1];
+        uint8_t value_length = data[offset + 2];
+        offset += 3;
+
+        if (key_length == 0 || key_length > CONFIG_MAX_KEY) return false;
+        if (size - offset < (size_t)key_length + value_length) return false;
+        if ((type == CONFIG_INT && value_length != 4) || (type == CONFIG_BOOL && value_length != 1) ||
+            (type == CONFIG_STRING && value_length > CONFIG_MAX_STRING) ||
+            (type != CONFIG_INT && type != CONFIG_BOOL && type != CONFIG_STRING)) {
+            return false;
+        }
+
+        char key[CONFIG_MAX_KEY + 1];
+        memcpy(key, data + offset, key_length);
+        key[key_length] = '\0';
+        const uint8_t* value = data + offset + key_length;
+        offset += key_length + value_length;
+
+        if (!apply) {
+            if (strlen(key) != key_length) return false;
+            if (config_find(key) == NULL) new_keys++;
+            continue;
+        }
+
+        if (type == CONFIG_INT) {
+            config_set_int(key, (int)config_get_u32(value));
+        } else if (type == CONFIG_BOOL) {
+            config_set_bool(key, value[0] != 0);
+        } else {
+            char string[CONFIG_MAX_STRING + 1];
+            memcpy(string, value, value_length);
+            string[value_length] = '\0';
+            config_set_string(key, string);
+        }
+    }
+
+    // Duplicate keys in the snapshot only make this more conservative
+    return offset == size && (apply || config_entry_count + new_keys <= CONFIG_MAX_ENTRIES);
+}
+
+// Merge a snapshot into the store. Nothing is changed unless the whole
+// snapshot is valid.
+bool config_load_buffer(const void* buffer, size_t size) {
+    if (buffer == NULL || size < CONFIG_SNAPSHOT_HEADER) return false;
+
+    const uint8_t* in = buffer;
+    const uint8_t* body = in + CONFIG_SNAPSHOT_HEADER;
+    size_t body_size = size - CONFIG_SNAPSHOT_HEADER;
+    uint32_t count = config_get_u32(in + 4);
+    if (config_get_u32(in) != CONFIG_SNAPSHOT_MAGIC || count > CONFIG_MAX_ENTRIES) return false;
+    if (config_get_u32(in + 8) != crc32(body, body_size)) return false;
+
+    if (!config_walk_snapshot(body, body_size, count, false)) return false;
+    return config_walk_snapshot(body, body_size, count, true);
+}
+
+bool config_load(const char* filename) {
+    if (filename == NULL) return false;
+
+    error_t fd = file_open(filename, 0);
+    if (fd < 0) return false;
+    error_t size = file_read(fd, config_snapshot, sizeof(config_snapshot));
+    file_close(fd);
+
+    return size > 0 && config_load_buffer(config_snapshot, size);
+}
+
+bool config_save(const char* filename) {
+    if (filename == NULL) return false;
+
+    size_t size = config_save_buffer(config_snapshot, sizeof(config_snapshot));
+    if (size == 0) return false;
+
+    error_t fd = file_open(filename, 0);
+    if (fd < 0) return false;
+    error_t written = file_write(fd, config_snapshot, size);
+    file_close(fd);
+    return written == (error_t)size;
+}
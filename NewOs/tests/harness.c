@@ -0,0 +1,252 @@
+// Host side of the test build: the only file compiled against the host C
+// library. It maps the kernel heap, emulates the few I/O ports the
+// libraries touch, keeps the bench baseline file and hands over to the
+// freestanding runner.
+//
+//   host test [filter]
+//   host bench [--save] [--baseline file] [filter]
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "host.h"
+
+#define HEAP_START 0xC0000000UL   // KERNEL_HEAP_START
+#define HEAP_SIZE  0x00400000UL   // KERNEL_HEAP_END - KERNEL_HEAP_START
+
+#define BASELINE_MAX  128
+#define BASELINE_NAME 32
+
+void host_print(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+// The C library's string functions. The kernel's definitions interpose
+// them for every caller in this binary, so the originals are looked up
+// past the executable.
+static void* host_reference(const char* name) {
+    void* fn = dlsym(RTLD_NEXT, name);
+    if (fn == NULL) {
+        fprintf(stderr, "host: no reference %s in the C library\n", name);
+        exit(1);
+    }
+    return fn;
+}
+
+void* host_ref_memcpy(void* dest, const void* src, size_t n) {
+    static void* (*fn)(void*, const void*, size_t) = NULL;
+    if (fn == NULL) fn = host_reference("memcpy");
+    return fn(dest, src, n);
+}
+
+size_t host_ref_strlen(const char* s) {
+    static size_t (*fn)(const char*) = NULL;
+    if (fn == NULL) fn = host_reference("strlen");
+    return fn(s);
+}
+
+int host_ref_strcmp(const char* s1, const char* s2) {
+    static int (*fn)(const char*, const char*) = NULL;
+    if (fn == NULL) fn = host_reference("strcmp");
+    return fn(s1, s2);
+}
+
+char* host_ref_strstr(const char* haystack, const char* needle) {
+    static char* (*fn)(const char*, const char*) = NULL;
+    if (fn == NULL) fn = host_reference("strstr");
+    return fn(haystack, needle);
+}
+
+char* host_ref_strtok_r(char* str, const char* delim, char** saveptr) {
+    static char* (*fn)(char*, const char*, char**) = NULL;
+    if (fn == NULL) fn = host_reference("strtok_r");
+    return fn(str, delim, saveptr);
+}
+
+// A readable page followed by an inaccessible one, to catch reads past
+// the end of a string that ends on a page boundary
+char* host_guard_page(void) {
+    static char* page = NULL;
+    if (page != NULL) return page;
+
+    char* pages = mmap(NULL, 2 * HOST_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED || mprotect(pages + HOST_PAGE_SIZE, HOST_PAGE_SIZE, PROT_NONE) != 0) {
+        fprintf(stderr, "host: cannot map a guard page\n");
+        exit(1);
+    }
+    page = pages;
+    return page;
+}
+
+static uint64_t host_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+// I/O ports. PIT channel 2 counts down in real time so time_init can
+// calibrate the TSC, the CMOS clock reads the host's UTC time, and
+// everything else floats high like an empty bus, so no serial port.
+#define PIT_FREQUENCY 1193182
+#define PIT_CHANNEL2  0x42
+#define PIT_COMMAND   0x43
+#define PIT_GATE      0x61
+#define PIT_OUTPUT    0x20
+#define CMOS_ADDRESS  0x70
+#define CMOS_DATA     0x71
+
+static uint8_t pit_gate = 0;
+static uint32_t pit_count = 0;
+static uint32_t pit_bytes = 0;
+static uint64_t pit_start = 0;
+static uint8_t cmos_register = 0;
+
+static uint8_t host_cmos_read(uint8_t reg) {
+    time_t now = time(NULL);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+
+    switch (reg) {
+        case 0x00: return utc.tm_sec;
+        case 0x02: return utc.tm_min;
+        case 0x04: return utc.tm_hour;
+        case 0x07: return utc.tm_mday;
+        case 0x08: return utc.tm_mon + 1;
+        case 0x09: return utc.tm_year % 100;
+        case 0x0B: return 0x06;   // Binary, 24 hour
+        default: return 0;
+    }
+}
+
+void host_outb(uint16_t port, uint8_t value) {
+    switch (port) {
+        case PIT_COMMAND:
+            pit_bytes = 0;
+            break;
+        case PIT_CHANNEL2:
+            pit_count = pit_bytes == 0 ? value : pit_count | value << 8;
+            if (++pit_bytes == 2) pit_start = host_now_ns();
+            break;
+        case PIT_GATE:
+            pit_gate = value;
+            break;
+        case CMOS_ADDRESS:
+            cmos_register = value & 0x7F;
+            break;
+    }
+}
+
+uint8_t host_inb(uint16_t port) {
+    switch (port) {
+        case PIT_GATE: {
+            uint64_t elapsed = host_now_ns() - pit_start;
+            bool expired = pit_bytes == 2 && elapsed * PIT_FREQUENCY >= (uint64_t)pit_count * 1000000000u;
+            return (pit_gate & ~PIT_OUTPUT) | (expired ? PIT_OUTPUT : 0);
+        }
+        case CMOS_DATA:
+            return host_cmos_read(cmos_register);
+        default:
+            return 0xFF;
+    }
+}
+
+// Bench baseline: one "name median" line per benchmark
+static struct {
+    char name[BASELINE_NAME];
+    uint32_t median;
+} baseline[BASELINE_MAX];
+static uint32_t baseline_count = 0;
+
+uint32_t host_baseline_get(const char* name) {
+    for (uint32_t i = 0; i < baseline_count; i++) {
+        if (strcmp(baseline[i].name, name) == 0) return baseline[i].median;
+    }
+    return 0;
+}
+
+void host_baseline_set(const char* name, uint32_t median) {
+    uint32_t i = 0;
+    while (i < baseline_count && strcmp(baseline[i].name, name) != 0) i++;
+    if (i == BASELINE_MAX) return;
+    if (i == baseline_count) baseline_count++;
+    snprintf(baseline[i].name, BASELINE_NAME, "%s", name);
+    baseline[i].median = median;
+}
+
+static void baseline_load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return;
+
+    char name[BASELINE_NAME];
+    unsigned median;
+    while (baseline_count < BASELINE_MAX && fscanf(file, "%31s %u", name, &median) == 2) {
+        host_baseline_set(name, median);
+    }
+    fclose(file);
+}
+
+static bool baseline_save(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return false;
+    for (uint32_t i = 0; i < baseline_count; i++) {
+        fprintf(file, "%s %u\n", baseline[i].name, baseline[i].median);
+    }
+    return fclose(file) == 0;
+}
+
+static int usage(void) {
+    fprintf(stderr, "usage: host test [filter]\n"
+                    "       host bench [--save] [--baseline file] [filter]\n");
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) return usage();
+
+    bool bench = strcmp(argv[1], "bench") == 0;
+    if (!bench && strcmp(argv[1], "test") != 0) return usage();
+
+    bool save = false;
+    const char* baseline_path = "tests/bench.baseline";
+    const char* filter = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--save") == 0) {
+            save = true;
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (filter == NULL && argv[i][0] != '-') {
+            filter = argv[i];
+        } else {
+            return usage();
+        }
+    }
+
+    // The allocator keeps block addresses in 32 bits, so the heap has to
+    // sit where the kernel puts it
+    void* heap = mmap((void*)HEAP_START, HEAP_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (heap != (void*)HEAP_START) {
+        fprintf(stderr, "host: cannot map the kernel heap at %#lx\n", HEAP_START);
+        return 1;
+    }
+    host_kernel_init();
+
+    if (!bench) return host_run_tests(filter) == 0 ? 0 : 1;
+
+    baseline_load(baseline_path);
+    uint32_t failures = host_run_benches(filter);
+    if (save && !baseline_save(baseline_path)) {
+        fprintf(stderr, "host: cannot write %s\n", baseline_path);
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
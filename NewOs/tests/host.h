@@ -0,0 +1,85 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Host build of the kernel libraries. The kernel sources, runner.c and
+// the test files are compiled freestanding against tests/shim and
+// include/, harness.c against the host C library; this header is shared
+// by both sides and only uses the fixed-width types both agree on.
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} host_test_t;
+
+// A benchmark timed with bench_measure. bytes is the data handled per
+// call, used to report throughput, 0 when that makes no sense.
+typedef struct {
+    const char* name;
+    void (*fn)(void);
+    uint32_t bytes;
+} host_bench_t;
+
+// Suites end with an entry whose name is NULL
+extern const host_test_t host_memory_tests[];
+extern const host_test_t host_fs_tests[];
+extern const host_test_t host_hashmap_tests[];
+extern const host_test_t host_bitops_tests[];
+extern const host_test_t host_string_tests[];
+extern const host_test_t host_crc_tests[];
+extern const host_test_t host_hash_tests[];
+extern const host_test_t host_codec_tests[];
+extern const host_test_t host_random_tests[];
+extern const host_test_t host_log_tests[];
+extern const host_test_t host_config_tests[];
+
+extern const host_bench_t host_memory_benches[];
+extern const host_bench_t host_string_benches[];
+extern const host_bench_t host_crc_benches[];
+
+// Reports print a table of their own at the end of a bench run, for
+// results with more than one number per line
+extern const host_test_t host_memory_reports[];
+extern const host_test_t host_string_reports[];
+
+// Runner, in runner.c: both return the number of failures
+void host_kernel_init(void);
+uint32_t host_run_tests(const char* filter);
+uint32_t host_run_benches(const char* filter);
+
+// Rates from the cycles per call of a bench median: calls per second in
+// tenths of millions, and bytes per second in tenths of GB
+uint32_t host_rate(uint32_t cycles);
+uint32_t host_bandwidth(uint32_t bytes, uint32_t cycles);
+
+void host_check(bool ok, const char* expression, const char* file, int line);
+void host_check_equal(uint64_t actual, uint64_t expected, const char* expression,
+                      const char* file, int line);
+
+#define CHECK(expression) \
+    host_check((expression) != 0, #expression, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) \
+    host_check_equal((uint64_t)(actual), (uint64_t)(expected), #actual " == " #expected, __FILE__, __LINE__)
+
+// Services of the host C library, in harness.c
+void host_print(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// Reference string functions of the host C library
+void* host_ref_memcpy(void* dest, const void* src, size_t n);
+size_t host_ref_strlen(const char* s);
+int host_ref_strcmp(const char* s1, const char* s2);
+char* host_ref_strstr(const char* haystack, const char* needle);
+char* host_ref_strtok_r(char* str, const char* delim, char** saveptr);
+
+// HOST_PAGE_SIZE readable bytes directly followed by an unmapped page
+#define HOST_PAGE_SIZE 4096
+char* host_guard_page(void);
+
+// Saved bench medians, in cycles; 0 when there is none for name
+uint32_t host_baseline_get(const char* name);
+void host_baseline_set(const char* name, uint32_t median);
+
+#endif
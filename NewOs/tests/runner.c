@@ -0,0 +1,156 @@
+#include "../include/kernel.h"
+#include <bench.h>
+#include <bitops.h>
+#include <fs.h>
+#include <memory.h>
+#include <string.h>
+#include <utils.h>
+#include "host.h"
+
+// Freestanding side of the host build: brings the libraries up in boot
+// order and runs the suites and benchmarks.
+
+static const host_test_t* const host_test_suites[] = {
+    host_memory_tests,
+    host_fs_tests,
+    host_hashmap_tests,
+    host_bitops_tests,
+    host_string_tests,
+    host_crc_tests,
+    host_hash_tests,
+    host_codec_tests,
+    host_random_tests,
+    host_log_tests,
+    host_config_tests,         // Last, leaves the store full
+};
+
+static const host_test_t* const host_report_suites[] = {
+    host_memory_reports,
+    host_string_reports,
+};
+
+static const host_bench_t* const host_bench_suites[] = {
+    host_memory_benches,
+    host_string_benches,
+    host_crc_benches,
+};
+
+#define SUITE_COUNT(suites) (sizeof(suites) / sizeof(suites[0]))
+
+static uint32_t host_failures = 0;
+
+void host_kernel_init(void) {
+    string_init();
+    bitops_init();
+    memory_init();
+    fs_init();
+    time_init();
+    log_init();
+    random_init(time_get_current());
+}
+
+void host_check(bool ok, const char* expression, const char* file, int line) {
+    if (ok) return;
+    host_print("    %s:%d: CHECK(%s) failed\n", file, line, expression);
+    host_failures++;
+}
+
+void host_check_equal(uint64_t actual, uint64_t expected, const char* expression,
+                      const char* file, int line) {
+    if (actual == expected) return;
+    host_print("    %s:%d: %s failed, got %#llx, expected %#llx\n",
+               file, line, expression, actual, expected);
+    host_failures++;
+}
+
+static bool host_selected(const char* name, const char* filter) {
+    return filter == NULL || strstr(name, filter) != NULL;
+}
+
+uint32_t host_run_tests(const char* filter) {
+    uint32_t run = 0;
+    uint32_t failed = 0;
+    for (uint32_t suite = 0; suite < SUITE_COUNT(host_test_suites); suite++) {
+        for (const host_test_t* test = host_test_suites[suite]; test->name != NULL; test++) {
+            if (!host_selected(test->name, filter)) continue;
+
+            uint32_t before = host_failures;
+            test->run();
+            bool ok = host_failures == before;
+            host_print("%s %s\n", ok ? "ok  " : "FAIL", test->name);
+            run++;
+            if (!ok) failed++;
+        }
+    }
+
+    host_print("%u tests, %u failed\n", run, failed);
+    return failed;
+}
+
+uint32_t host_rate(uint32_t cycles) {
+    return cycles != 0 ? (uint64_t)time_get_tsc_khz() * 1000 / cycles / 100000 : 0;
+}
+
+uint32_t host_bandwidth(uint32_t bytes, uint32_t cycles) {
+    return cycles != 0 ? (uint64_t)bytes * time_get_tsc_khz() / cycles / 100000 : 0;
+}
+
+// One result line: cycles per call, throughput when bytes is known, and
+// the median against the saved baseline, which is then updated
+static void host_report(const char* name, const bench_result_t* result, uint32_t bytes) {
+    host_print("%-16s %9u %9u %9u", name, result->min, result->median, result->p99);
+
+    uint32_t khz = time_get_tsc_khz();
+    if (bytes != 0 && khz != 0 && result->median != 0) {
+        host_print(" %9llu", (uint64_t)bytes * khz / result->median / 1000);
+    } else {
+        host_print(" %9s", "-");
+    }
+
+    uint32_t baseline = host_baseline_get(name);
+    if (baseline != 0) {
+        int32_t change = (int32_t)(((int64_t)result->median - baseline) * 100 / baseline);
+        host_print(" %9u %+6d%%\n", baseline, change);
+    } else {
+        host_print(" %9s\n", "-");
+    }
+    host_baseline_set(name, result->median);
+}
+
+uint32_t host_run_benches(const char* filter) {
+    uint32_t failed = 0;
+    host_print("%-16s %9s %9s %9s %9s %9s\n", "cycles/call", "min", "median", "p99", "MB/s", "baseline");
+
+    // The kernel's own table first, then the host-only benchmarks; the
+    // entries that need processes or paging are skipped here
+    bench_result_t result;
+    for (uint32_t i = 0; i < bench_count(); i++) {
+        if (!host_selected(bench_name(i), filter)) continue;
+        if (bench_run(i, &result)) {
+            host_report(bench_name(i), &result, bench_bytes(i));
+        } else {
+            host_print("%-16s skipped\n", bench_name(i));
+        }
+    }
+
+    for (uint32_t suite = 0; suite < SUITE_COUNT(host_bench_suites); suite++) {
+        for (const host_bench_t* bench = host_bench_suites[suite]; bench->name != NULL; bench++) {
+            if (!host_selected(bench->name, filter)) continue;
+            if (bench_measure(bench->fn, &result)) {
+                host_report(bench->name, &result, bench->bytes);
+            } else {
+                host_print("%-16s failed\n", bench->name);
+                failed++;
+            }
+        }
+    }
+
+    for (uint32_t suite = 0; suite < SUITE_COUNT(host_report_suites); suite++) {
+        for (const host_test_t* report = host_report_suites[suite]; report->name != NULL; report++) {
+            if (!host_selected(report->name, filter)) continue;
+            host_print("\n%s\n", report->name);
+            report->run();
+        }
+    }
+    return failed;
+}
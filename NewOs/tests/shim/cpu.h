@@ -0,0 +1,201 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host stand-in for include/cpu.h. Unprivileged instructions (cpuid,
+// rdtsc, rdrand, fxsave) run for real; control registers read back a
+// protected-mode CPU with paging and SSE on, interrupt and TLB control
+// do nothing, and port I/O goes to the devices emulated by harness.c.
+
+// CR0 bits
+#define CR0_MP 0x00000002
+#define CR0_EM 0x00000004
+#define CR0_TS 0x00000008
+#define CR0_WP 0x00010000
+#define CR0_PG 0x80000000
+
+// CR4 bits
+#define CR4_PSE        0x00000010
+#define CR4_OSFXSR     0x00000200
+#define CR4_OSXMMEXCPT 0x00000400
+
+// CPUID leaf 1 feature bits
+#define CPUID_EDX_PSE  0x00000008
+#define CPUID_EDX_TSC  0x00000010
+#define CPUID_EDX_FXSR 0x01000000
+#define CPUID_EDX_SSE  0x02000000
+#define CPUID_EDX_SSE2 0x04000000
+
+// CPUID leaf 1 ECX feature bits
+#define CPUID_ECX_SSE3   0x00000001
+#define CPUID_ECX_SSSE3  0x00000200
+#define CPUID_ECX_SSE4_2 0x00100000
+#define CPUID_ECX_POPCNT 0x00800000
+#define CPUID_ECX_RDRAND 0x40000000
+
+// CPUID leaf 7 EBX feature bits
+#define CPUID_7_EBX_RDSEED 0x00040000
+
+#define EFLAGS_IF 0x00000200
+#define EFLAGS_ID 0x00200000
+
+// Emulated port I/O, in harness.c
+void host_outb(uint16_t port, uint8_t value);
+uint8_t host_inb(uint16_t port);
+
+// Control registers
+static inline uint32_t cpu_read_cr0(void) {
+    return CR0_PG | CR0_WP | CR0_MP;
+}
+
+static inline void cpu_write_cr0(uint32_t value) {
+    (void)value;
+}
+
+static inline uint32_t cpu_read_cr2(void) {
+    return 0;
+}
+
+static inline uint32_t cpu_read_cr3(void) {
+    return 0;
+}
+
+static inline void cpu_write_cr3(uint32_t value) {
+    (void)value;
+}
+
+static inline uint32_t cpu_read_cr4(void) {
+    return CR4_PSE | CR4_OSFXSR | CR4_OSXMMEXCPT;
+}
+
+static inline void cpu_write_cr4(uint32_t value) {
+    (void)value;
+}
+
+// CPU identification, every x86-64 CPU has CPUID
+static inline bool cpu_has_cpuid(void) {
+    return true;
+}
+
+static inline void cpu_cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(0));
+}
+
+static inline bool cpu_has_feature_edx(uint32_t mask) {
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+    return (edx & mask) == mask;
+}
+
+static inline bool cpu_has_feature_ecx(uint32_t mask) {
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+    return (ecx & mask) == mask;
+}
+
+static inline bool cpu_has_feature_7_ebx(uint32_t mask) {
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 7) return false;
+    cpu_cpuid(7, &eax, &ebx, &ecx, &edx);
+    return (ebx & mask) == mask;
+}
+
+// Time stamp counter
+static inline uint64_t cpu_rdtsc(void) {
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return (uint64_t)high << 32 | low;
+}
+
+// A host process never takes kernel interrupts, report them as off
+static inline uint32_t cpu_interrupts_save(void) {
+    return 0;
+}
+
+static inline void cpu_interrupts_restore(uint32_t flags) {
+    (void)flags;
+}
+
+static inline void cpu_interrupts_enable(void) {
+}
+
+static inline void cpu_interrupts_disable(void) {
+}
+
+static inline void cpu_idle(void) {
+    __asm__ volatile("pause" : : : "memory");
+}
+
+// Hardware random numbers
+static inline bool cpu_rdrand(uint32_t* value) {
+    uint8_t ok;
+    __asm__ volatile("rdrand %0; setc %1" : "=r"(*value), "=qm"(ok) : : "cc");
+    return ok;
+}
+
+static inline bool cpu_rdseed(uint32_t* value) {
+    uint8_t ok;
+    __asm__ volatile("rdseed %0; setc %1" : "=r"(*value), "=qm"(ok) : : "cc");
+    return ok;
+}
+
+// The host OS has SSE enabled already
+static inline void cpu_enable_sse(void) {
+}
+
+static inline bool cpu_sse_enabled(void) {
+    return true;
+}
+
+static inline void cpu_clts(void) {
+}
+
+static inline void cpu_set_ts(void) {
+}
+
+// FPU state save and restore
+static inline void cpu_fxsave(void* area) {
+    __asm__ volatile("fxsave (%0)" : : "r"(area) : "memory");
+}
+
+static inline void cpu_fxrstor(const void* area) {
+    __asm__ volatile("fxrstor (%0)" : : "r"(area) : "memory");
+}
+
+static inline void cpu_fnsave(void* area) {
+    __asm__ volatile("fnsave (%0)" : : "r"(area) : "memory");
+}
+
+static inline void cpu_frstor(const void* area) {
+    __asm__ volatile("frstor (%0)" : : "r"(area) : "memory");
+}
+
+static inline void cpu_fpu_reset(bool sse) {
+    uint32_t mxcsr = 0x1F80;
+    __asm__ volatile("fninit");
+    if (sse) __asm__ volatile("ldmxcsr %0" : : "m"(mxcsr));
+}
+
+// Port I/O
+static inline void cpu_outb(uint16_t port, uint8_t value) {
+    host_outb(port, value);
+}
+
+static inline uint8_t cpu_inb(uint16_t port) {
+    return host_inb(port);
+}
+
+// TLB maintenance
+static inline void cpu_invlpg(uint32_t address) {
+    (void)address;
+}
+
+static inline void cpu_flush_tlb(void) {
+}
+
+#endif /* CPU_H */
@@ -0,0 +1,84 @@
+#include "../include/kernel.h"
+#include <interrupt.h>
+#include <memory.h>
+#include <process.h>
+#include <timer.h>
+
+// Kernel services the host build links against but does not run. There
+// is no page table or frame allocator: the heap is premapped by
+// harness.c and mapping anything else fails. Lazy reservations fall
+// back to the heap, there is a single thread and no timer.
+
+volatile uint32_t interrupt_depth = 0;
+volatile uint32_t preempt_count = 0;
+volatile bool preempt_pending = false;
+
+uint32_t frame_alloc(uint32_t order) {
+    return 0;
+}
+
+void frame_free(uint32_t address, uint32_t order) {
+}
+
+bool paging_map_range(uint32_t virt, uint32_t phys, uint32_t count, uint32_t flags) {
+    return false;
+}
+
+bool paging_unmap_range(uint32_t virt, uint32_t count) {
+    return false;
+}
+
+bool paging_protect_range(uint32_t virt, uint32_t count, uint32_t flags) {
+    return false;
+}
+
+uint32_t paging_get_physical(uint32_t virt) {
+    return 0;
+}
+
+void* vm_reserve(size_t size, uint32_t flags) {
+    return memory_alloc(size);
+}
+
+bool vm_release(void* addr) {
+    memory_free(addr);
+    return true;
+}
+
+void process_preempt(void) {
+    preempt_pending = false;
+}
+
+error_t process_create(const char* name, void* entry_point, uint32_t priority) {
+    return ERR_INVALID_OPERATION;
+}
+
+void process_schedule(void) {
+}
+
+process_t* process_pick_next(void) {
+    return NULL;
+}
+
+process_t* process_get_current(void) {
+    return NULL;
+}
+
+bool process_set_break(process_t* process, uint32_t address) {
+    return false;
+}
+
+error_t process_fork(process_t* parent, uint32_t* child_pid) {
+    return ERR_INVALID_OPERATION;
+}
+
+void process_exit(uint32_t exit_code) {
+}
+
+bool process_sleep_until(uint64_t deadline) {
+    return false;
+}
+
+bool timer_idle(uint64_t deadline) {
+    return false;
+}
@@ -0,0 +1,84 @@
+#include "../include/kernel.h"
+#include <bitops.h>
+#include <utils.h>
+#include "host.h"
+
+#define BITOPS_TEST_BITS 300
+
+static void test_word_scans(void) {
+    CHECK_EQUAL(bit_first_set(0), 32);
+    CHECK_EQUAL(bit_last_set(0), 32);
+    CHECK_EQUAL(bit_first_set(0x80000000), 31);
+    CHECK_EQUAL(bit_last_set(1), 0);
+    CHECK_EQUAL(bit_last_set(0x00F00F00), 23);
+    CHECK_EQUAL(bit_first_zero(0xFFFFFFFF), 32);
+    CHECK_EQUAL(bit_first_zero(0x0000FFFF), 16);
+
+    // POPCNT and the SWAR fallback agree
+    random_state_t random;
+    random_seed(&random, 7);
+    for (uint32_t i = 0; i < 10000; i++) {
+        uint32_t value = random_next(&random);
+        uint32_t expected = 0;
+        for (uint32_t bit = 0; bit < 32; bit++) expected += (value >> bit) & 1;
+        CHECK_EQUAL(bit_popcount_soft(value), expected);
+        CHECK_EQUAL(bit_popcount(value), expected);
+    }
+}
+
+// Ranges and scans against one bool per bit
+static void test_bitmap_ranges(void) {
+    uint32_t map[BITMAP_WORDS(BITOPS_TEST_BITS)] = { 0 };
+    bool bits[BITOPS_TEST_BITS] = { false };
+    random_state_t random;
+    random_seed(&random, 9);
+
+    for (uint32_t round = 0; round < 2000; round++) {
+        uint32_t start = random_next_bounded(&random, BITOPS_TEST_BITS);
+        uint32_t count = random_next_bounded(&random, BITOPS_TEST_BITS - start + 1);
+        bool set = random_next(&random) & 1;
+        if (set) bitmap_set_range(map, start, count);
+        else bitmap_clear_range(map, start, count);
+        for (uint32_t i = start; i < start + count; i++) bits[i] = set;
+
+        uint32_t from = random_next_bounded(&random, BITOPS_TEST_BITS);
+        uint32_t next_set = from;
+        while (next_set < BITOPS_TEST_BITS && !bits[next_set]) next_set++;
+        uint32_t next_zero = from;
+        while (next_zero < BITOPS_TEST_BITS && bits[next_zero]) next_zero++;
+        CHECK_EQUAL(bitmap_find_next_set(map, BITOPS_TEST_BITS, from), next_set);
+        CHECK_EQUAL(bitmap_find_next_zero(map, BITOPS_TEST_BITS, from), next_zero);
+
+        uint32_t expected = 0;
+        for (uint32_t i = 0; i < BITOPS_TEST_BITS; i++) {
+            expected += bits[i];
+            if (bitmap_test(map, i) != bits[i]) {
+                CHECK_EQUAL(bitmap_test(map, i), bits[i]);
+                return;
+            }
+        }
+        CHECK_EQUAL(bitmap_count(map, BITOPS_TEST_BITS), expected);
+    }
+}
+
+// Bits past the size in the last word never match a scan
+static void test_bitmap_tail(void) {
+    uint32_t map[BITMAP_WORDS(40)] = { 0 };
+    map[1] = 0xFFFFFF00;
+    CHECK_EQUAL(bitmap_find_first_set(map, 40), 40);
+    CHECK_EQUAL(bitmap_count(map, 40), 0);
+    CHECK_EQUAL(bitmap_find_next_zero(map, 40, 40), 40);
+
+    bitmap_set_range(map, 0, 40);
+    CHECK_EQUAL(bitmap_find_first_zero(map, 40), 40);
+    CHECK(bitmap_test_and_clear_atomic(map, 33));
+    CHECK(!bitmap_test_and_set_atomic(map, 33));
+    CHECK_EQUAL(bitmap_count(map, 40), 40);
+}
+
+const host_test_t host_bitops_tests[] = {
+    { "bitops-word-scans", test_word_scans },
+    { "bitops-bitmap-ranges", test_bitmap_ranges },
+    { "bitops-bitmap-tail", test_bitmap_tail },
+    { NULL, NULL },
+};
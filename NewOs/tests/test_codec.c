@@ -0,0 +1,154 @@
+#include "../include/kernel.h"
+#include <string.h>
+#include <utils.h>
+#include "host.h"
+
+// The SSSE3 codec paths against the scalar loops, which codec_set_ssse3
+// selects. Sizes run past several vector blocks so both the blocks and
+// the scalar remainder are covered.
+#define CODEC_TEST_SIZE 400
+
+static uint8_t codec_data[CODEC_TEST_SIZE + 16];
+static uint8_t codec_decoded[CODEC_TEST_SIZE + 16];
+static char codec_text[2][BASE64_ENCODED_SIZE(CODEC_TEST_SIZE) + CODEC_TEST_SIZE * 2 + 16];
+
+// Both modes, the SSSE3 one first; a single pass without SSSE3
+static uint32_t codec_modes(void) {
+    static bool warned = false;
+    bool ssse3 = codec_set_ssse3(true);
+    if (!ssse3 && !warned) {
+        host_print("    no SSSE3, only the scalar loops are tested\n");
+        warned = true;
+    }
+    return ssse3 ? 2 : 1;
+}
+
+static void codec_fill(random_state_t* random, size_t size) {
+    for (size_t i = 0; i < size; i++) codec_data[i] = (uint8_t)random_next(random);
+}
+
+static bool codec_is_base64(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+           c == '+' || c == '/';
+}
+
+static bool codec_is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Encode and decode every size in both modes, the two encodings must be
+// identical and decode back to the data
+static void test_round_trip(void) {
+    random_state_t random;
+    random_seed(&random, 31);
+    uint32_t modes = codec_modes();
+
+    for (size_t size = 0; size <= CODEC_TEST_SIZE; size++) {
+        size_t offset = size % 7;
+        codec_fill(&random, size + offset);
+        const uint8_t* data = codec_data + offset;
+
+        for (uint32_t mode = 0; mode < modes; mode++) {
+            codec_set_ssse3(mode == 0);
+            CHECK_EQUAL(base64_encode(data, size, codec_text[mode]), BASE64_ENCODED_SIZE(size) - 1);
+            CHECK_EQUAL(base64_decode(codec_text[mode], codec_decoded), size);
+            CHECK(memcmp(codec_decoded, data, size) == 0);
+        }
+        CHECK(modes == 1 || strcmp(codec_text[0], codec_text[1]) == 0);
+
+        for (uint32_t mode = 0; mode < modes; mode++) {
+            codec_set_ssse3(mode == 0);
+            CHECK_EQUAL(hex_encode(data, size, codec_text[mode]), size * 2);
+            CHECK_EQUAL(hex_decode(codec_text[mode], codec_decoded), size);
+            CHECK(memcmp(codec_decoded, data, size) == 0);
+        }
+        CHECK(modes == 1 || strcmp(codec_text[0], codec_text[1]) == 0);
+
+        // Uppercase digits decode the same
+        for (size_t i = 0; i < size * 2; i++) {
+            if (codec_text[0][i] >= 'a') codec_text[0][i] -= 'a' - 'A';
+        }
+        for (uint32_t mode = 0; mode < modes; mode++) {
+            codec_set_ssse3(mode == 0);
+            CHECK_EQUAL(hex_decode(codec_text[0], codec_decoded), size);
+            CHECK(memcmp(codec_decoded, data, size) == 0);
+        }
+    }
+    codec_set_ssse3(true);
+}
+
+// Every byte value at every position of the first vector blocks: the
+// decoders reject exactly the characters outside their alphabet
+static void test_every_character(void) {
+    uint32_t modes = codec_modes();
+    for (uint32_t c = 1; c < 256; c++) {
+        for (size_t at = 0; at < 48; at += 5) {
+            for (uint32_t mode = 0; mode < modes; mode++) {
+                codec_set_ssse3(mode == 0);
+
+                memset(codec_text[0], 'Q', 64);
+                codec_text[0][64] = '\0';
+                codec_text[0][at] = (char)c;
+                size_t result = base64_decode(codec_text[0], codec_decoded);
+                if ((result != CODEC_ERROR) != codec_is_base64((char)c)) {
+                    host_print("    base64 character %#x at %zu, ssse3 %d\n", c, at, mode == 0);
+                    CHECK(false);
+                    codec_set_ssse3(true);
+                    return;
+                }
+
+                memset(codec_text[0], '7', 64);
+                codec_text[0][at] = (char)c;
+                result = hex_decode(codec_text[0], codec_decoded);
+                if ((result != CODEC_ERROR) != codec_is_hex((char)c)) {
+                    host_print("    hex character %#x at %zu, ssse3 %d\n", c, at, mode == 0);
+                    CHECK(false);
+                    codec_set_ssse3(true);
+                    return;
+                }
+            }
+        }
+    }
+    codec_set_ssse3(true);
+}
+
+// Random corruption of valid encodings: both modes agree, and a byte
+// outside the alphabet always fails
+static void test_corruption(void) {
+    random_state_t random;
+    random_seed(&random, 32);
+    uint32_t modes = codec_modes();
+
+    for (uint32_t round = 0; round < 20000; round++) {
+        size_t size = 1 + random_next_bounded(&random, CODEC_TEST_SIZE);
+        codec_fill(&random, size);
+        bool hex = round & 1;
+        size_t length = hex ? hex_encode(codec_data, size, codec_text[0])
+                            : base64_encode(codec_data, size, codec_text[0]);
+
+        size_t at = random_next_bounded(&random, length);
+        char c = (char)(1 + random_next_bounded(&random, 255));
+        codec_text[0][at] = c;
+        bool valid = hex ? codec_is_hex(c) : codec_is_base64(c) || (c == '=' && at >= length - 2);
+
+        size_t results[2];
+        for (uint32_t mode = 0; mode < modes; mode++) {
+            codec_set_ssse3(mode == 0);
+            results[mode] = hex ? hex_decode(codec_text[0], codec_decoded)
+                                : base64_decode(codec_text[0], codec_decoded);
+        }
+        if ((!valid && results[0] != CODEC_ERROR) || (modes == 2 && results[0] != results[1])) {
+            host_print("    %s size %zu, %#x at %zu\n", hex ? "hex" : "base64", size, (uint8_t)c, at);
+            CHECK(false);
+            break;
+        }
+    }
+    codec_set_ssse3(true);
+}
+
+const host_test_t host_codec_tests[] = {
+    { "codec-round-trip", test_round_trip },
+    { "codec-every-character", test_every_character },
+    { "codec-corruption", test_corruption },
+    { NULL, NULL },
+};
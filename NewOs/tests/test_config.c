@@ -0,0 +1,182 @@
+#include "../include/kernel.h"
+#include <string.h>
+#include <utils.h>
+#include "host.h"
+
+// Snapshot layout from utils.c: magic "CFG1", entry count and CRC32 of
+// the body, then type, key length, value length, key and value per entry
+#define CONFIG_TEST_MAGIC  0x31474643
+#define CONFIG_TEST_HEADER 12
+#define CONFIG_TEST_IMAGE  4096
+
+static uint8_t config_image[CONFIG_TEST_IMAGE];
+static uint8_t config_before[CONFIG_TEST_IMAGE];
+static uint8_t config_after[CONFIG_TEST_IMAGE];
+
+static void config_put_u32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+// Rewrite the header of an image with a body of body_size bytes, so only
+// the records themselves can be at fault
+static size_t config_seal(uint8_t* image, size_t body_size, uint32_t count) {
+    config_put_u32(image, CONFIG_TEST_MAGIC);
+    config_put_u32(image + 4, count);
+    config_put_u32(image + 8, crc32(image + CONFIG_TEST_HEADER, body_size));
+    return CONFIG_TEST_HEADER + body_size;
+}
+
+// Append one record to the body at offset, returns the new offset
+static size_t config_record(uint8_t* image, size_t offset, config_type_t type, const char* key,
+                            const void* value, size_t value_length) {
+    uint8_t* p = image + CONFIG_TEST_HEADER + offset;
+    size_t key_length = strlen(key);
+    p[0] = type;
+    p[1] = key_length;
+    p[2] = value_length;
+    memcpy(p + 3, key, key_length);
+    memcpy(p + 3 + key_length, value, value_length);
+    return offset + 3 + key_length + value_length;
+}
+
+// A load that fails must leave the store exactly as it was
+static void config_check_rejected(const uint8_t* image, size_t size) {
+    size_t before = config_save_buffer(config_before, sizeof(config_before));
+    CHECK(!config_load_buffer(image, size));
+    size_t after = config_save_buffer(config_after, sizeof(config_after));
+    CHECK_EQUAL(after, before);
+    CHECK(memcmp(config_after, config_before, before) == 0);
+}
+
+// Values of every type come back after being overwritten
+static void test_round_trip(void) {
+    char longest[CONFIG_MAX_STRING + 1];
+    memset(longest, 'x', CONFIG_MAX_STRING);
+    longest[CONFIG_MAX_STRING] = '\0';
+
+    CHECK(config_set_string("test.name", "conio"));
+    CHECK(config_set_string("test.longest", longest));
+    CHECK(config_set_string("test.empty", ""));
+    CHECK(config_set_int("test.count", -123456));
+    CHECK(config_set_bool("test.flag", true));
+    CHECK(config_intern("test.unset") != NULL);
+
+    size_t size = config_save_buffer(config_image, sizeof(config_image));
+    CHECK(size > CONFIG_TEST_HEADER);
+    CHECK_EQUAL(config_save_buffer(config_image, size - 1), 0);
+
+    CHECK(config_set_string("test.name", "changed"));
+    CHECK(config_set_string("test.longest", "short"));
+    CHECK(config_set_string("test.empty", "full"));
+    CHECK(config_set_int("test.count", 7));
+    CHECK(config_set_bool("test.flag", false));
+
+    CHECK(config_load_buffer(config_image, size));
+    CHECK(strcmp(config_get_string("test.name"), "conio") == 0);
+    CHECK(strcmp(config_get_string("test.longest"), longest) == 0);
+    CHECK(strcmp(config_get_string("test.empty"), "") == 0);
+    CHECK(config_get_int("test.count") == -123456);
+    CHECK(config_get_bool("test.flag"));
+    CHECK(config_get_string("test.unset") == NULL);
+
+    // Saving again gives the same image
+    CHECK_EQUAL(config_save_buffer(config_after, sizeof(config_after)), size);
+    CHECK(memcmp(config_after, config_image, size) == 0);
+}
+
+// Damage anywhere in a saved image is caught by the magic or the CRC
+static void test_corrupt(void) {
+    CHECK(config_set_int("test.count", 99));
+    size_t size = config_save_buffer(config_image, sizeof(config_image));
+    CHECK(config_set_int("test.count", 100));
+
+    for (size_t byte = 0; byte < size; byte++) {
+        if (byte >= 4 && byte < 8) continue;  // The count, checked below
+        config_image[byte] ^= 0x10;
+        config_check_rejected(config_image, size);
+        config_image[byte] ^= 0x10;
+    }
+    CHECK_EQUAL(config_get_int("test.count"), 100);
+
+    config_check_rejected(config_image, size - 1);
+    config_check_rejected(config_image, CONFIG_TEST_HEADER - 1);
+    CHECK(!config_load_buffer(NULL, size));
+    CHECK(config_load_buffer(config_image, size));
+    CHECK_EQUAL(config_get_int("test.count"), 99);
+}
+
+// Images with a valid CRC but malformed records are refused whole, even
+// when earlier records are fine
+static void test_bad_records(void) {
+    int32_t number = 5;
+    uint8_t flag = 1;
+    CHECK(config_set_int("test.count", 1));
+    size_t good = config_record(config_image, 0, CONFIG_INT, "test.count", &number, 4);
+
+    // Value lengths that do not match the type
+    size_t body = config_record(config_image, good, CONFIG_INT, "test.bad", &number, 3);
+    config_check_rejected(config_image, config_seal(config_image, body, 2));
+    body = config_record(config_image, good, CONFIG_BOOL, "test.bad", &number, 2);
+    config_check_rejected(config_image, config_seal(config_image, body, 2));
+
+    // A value running past the end, and a body with bytes left over
+    body = config_record(config_image, good, CONFIG_BOOL, "test.bad", &flag, 1);
+    config_check_rejected(config_image, config_seal(config_image, body - 1, 2));
+    config_check_rejected(config_image, config_seal(config_image, body, 1));
+
+    // More records announced than present, an unknown type, an empty key
+    config_check_rejected(config_image, config_seal(config_image, body, 3));
+    body = config_record(config_image, good, CONFIG_NONE, "test.bad", &flag, 1);
+    config_check_rejected(config_image, config_seal(config_image, body, 2));
+    body = config_record(config_image, good, CONFIG_BOOL, "", &flag, 1);
+    config_check_rejected(config_image, config_seal(config_image, body, 2));
+
+    // A key with a NUL inside
+    body = config_record(config_image, good, CONFIG_BOOL, "test.bad", &flag, 1);
+    config_image[CONFIG_TEST_HEADER + good + 3 + 4] = '\0';
+    config_check_rejected(config_image, config_seal(config_image, body, 2));
+
+    CHECK_EQUAL(config_get_int("test.count"), 1);
+    body = config_record(config_image, good, CONFIG_BOOL, "test.good", &flag, 1);
+    CHECK(config_load_buffer(config_image, config_seal(config_image, body, 2)));
+    CHECK_EQUAL(config_get_int("test.count"), 5);
+    CHECK(config_get_bool("test.good"));
+}
+
+// With the store full an image bringing a new key is refused, one that
+// only updates existing keys still loads. Leaves the store full, so this
+// suite runs last.
+static void test_full_store(void) {
+    char key[CONFIG_MAX_KEY + 1];
+    uint32_t index = 0;
+    while (true) {
+        strcpy(key, "test.fill.");
+        key[10] = 'a' + index / 26;
+        key[11] = 'a' + index % 26;
+        key[12] = '\0';
+        index++;
+        if (!config_set_int(key, index)) break;
+    }
+    CHECK(config_get_entry(CONFIG_MAX_ENTRIES - 1) != NULL);
+
+    int32_t number = 42;
+    size_t body = config_record(config_image, 0, CONFIG_INT, "test.count", &number, 4);
+    body = config_record(config_image, body, CONFIG_INT, "test.new", &number, 4);
+    config_check_rejected(config_image, config_seal(config_image, body, 2));
+    CHECK(config_get_entry(CONFIG_MAX_ENTRIES) == NULL);
+
+    body = config_record(config_image, 0, CONFIG_INT, "test.count", &number, 4);
+    CHECK(config_load_buffer(config_image, config_seal(config_image, body, 1)));
+    CHECK_EQUAL(config_get_int("test.count"), 42);
+}
+
+const host_test_t host_config_tests[] = {
+    { "config-round-trip", test_round_trip },
+    { "config-corrupt", test_corrupt },
+    { "config-bad-records", test_bad_records },
+    { "config-full-store", test_full_store },
+    { NULL, NULL },
+};
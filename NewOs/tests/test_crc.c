@@ -0,0 +1,172 @@
+#include "../include/kernel.h"
+#include <string.h>
+#include <utils.h>
+#include "host.h"
+
+// The classic one-table bytewise loop, built bit by bit: the reference
+// for the sliced and SSE4.2 paths, and their baseline in the benchmarks
+#define CRC_TEST_SIZE 4096
+#define CRC_BENCH_SIZE 65536
+
+typedef struct {
+    uint32_t table[256];
+    bool ready;
+} crc_reference_t;
+
+static crc_reference_t crc32_reference;
+static crc_reference_t crc32c_reference;
+static crc_reference_t crc16_reference;
+
+static const crc_reference_t* crc_reference_init(crc_reference_t* reference, uint32_t polynomial) {
+    if (reference->ready) return reference;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+        }
+        reference->table[i] = crc;
+    }
+    reference->ready = true;
+    return reference;
+}
+
+static uint32_t crc_bytewise(const crc_reference_t* reference, uint32_t crc, const uint8_t* p, size_t size) {
+    while (size-- > 0) {
+        crc = reference->table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t crc32_bytewise(const void* data, size_t size) {
+    return ~crc_bytewise(crc_reference_init(&crc32_reference, 0xEDB88320), 0xFFFFFFFF, data, size);
+}
+
+static uint32_t crc32c_bytewise(const void* data, size_t size) {
+    return ~crc_bytewise(crc_reference_init(&crc32c_reference, 0x82F63B78), 0xFFFFFFFF, data, size);
+}
+
+static uint16_t crc16_bytewise(const void* data, size_t size) {
+    return crc_bytewise(crc_reference_init(&crc16_reference, 0xA001), 0, data, size);
+}
+
+static uint8_t crc_data[CRC_BENCH_SIZE + 8] __attribute__((aligned(16)));
+
+static void crc_fill(uint32_t seed) {
+    random_state_t random;
+    random_seed(&random, seed);
+    for (size_t i = 0; i < sizeof(crc_data); i++) crc_data[i] = (uint8_t)random_next(&random);
+}
+
+// Check values of the catalogued CRCs over "123456789"
+static void test_known_answers(void) {
+    static const char check[] = "123456789";
+    CHECK_EQUAL(crc32(check, 9), 0xCBF43926);
+    CHECK_EQUAL(crc32c(check, 9), 0xE3069283);
+    CHECK_EQUAL(crc16(check, 9), 0xBB3D);
+
+    CHECK_EQUAL(crc32("", 0), 0);
+    CHECK_EQUAL(crc32c("", 0), 0);
+    CHECK_EQUAL(crc32(NULL, 5), 0);
+    CHECK_EQUAL(crc32("a", 1), 0xE8B7BE43);
+    CHECK_EQUAL(crc32c("a", 1), 0xC1D04330);
+}
+
+// Every size and alignment against the bytewise loop, across the
+// sliced paths' head, body and tail
+static void test_against_bytewise(void) {
+    crc_fill(21);
+    for (size_t size = 0; size < 80; size++) {
+        for (size_t offset = 0; offset < 8; offset++) {
+            const uint8_t* p = crc_data + offset;
+            if (crc32(p, size) != crc32_bytewise(p, size) ||
+                crc32c(p, size) != crc32c_bytewise(p, size) ||
+                crc16(p, size) != crc16_bytewise(p, size)) {
+                host_print("    size %zu, offset %zu\n", size, offset);
+                CHECK(false);
+                return;
+            }
+        }
+    }
+    CHECK_EQUAL(crc32(crc_data, CRC_TEST_SIZE), crc32_bytewise(crc_data, CRC_TEST_SIZE));
+    CHECK_EQUAL(crc32c(crc_data, CRC_TEST_SIZE), crc32c_bytewise(crc_data, CRC_TEST_SIZE));
+}
+
+// Any split into chunks through the *_update functions gives the
+// one-shot result
+static void test_chunked(void) {
+    crc_fill(22);
+    uint32_t expected32 = crc32(crc_data, CRC_TEST_SIZE);
+    uint32_t expected32c = crc32c(crc_data, CRC_TEST_SIZE);
+    uint16_t expected16 = crc16(crc_data, CRC_TEST_SIZE);
+
+    random_state_t random;
+    random_seed(&random, 23);
+    for (uint32_t round = 0; round < 200; round++) {
+        uint32_t crc32_value = 0;
+        uint32_t crc32c_value = 0;
+        uint16_t crc16_value = 0;
+        for (size_t done = 0; done < CRC_TEST_SIZE;) {
+            size_t chunk = 1 + random_next_bounded(&random, round % 2 ? 17 : 700);
+            if (chunk > CRC_TEST_SIZE - done) chunk = CRC_TEST_SIZE - done;
+            crc32_value = crc32_update(crc32_value, crc_data + done, chunk);
+            crc32c_value = crc32c_update(crc32c_value, crc_data + done, chunk);
+            crc16_value = crc16_update(crc16_value, crc_data + done, chunk);
+            done += chunk;
+        }
+        CHECK_EQUAL(crc32_value, expected32);
+        CHECK_EQUAL(crc32c_value, expected32c);
+        CHECK_EQUAL(crc16_value, expected16);
+    }
+}
+
+// A single flipped bit always changes the CRC
+static void test_bit_flips(void) {
+    crc_fill(24);
+    uint32_t expected32 = crc32(crc_data, 256);
+    uint32_t expected32c = crc32c(crc_data, 256);
+    uint16_t expected16 = crc16(crc_data, 256);
+    for (uint32_t bit = 0; bit < 256 * 8; bit++) {
+        crc_data[bit / 8] ^= 1 << (bit % 8);
+        CHECK(crc32(crc_data, 256) != expected32);
+        CHECK(crc32c(crc_data, 256) != expected32c);
+        CHECK(crc16(crc_data, 256) != expected16);
+        crc_data[bit / 8] ^= 1 << (bit % 8);
+    }
+}
+
+const host_test_t host_crc_tests[] = {
+    { "crc-known-answers", test_known_answers },
+    { "crc-against-bytewise", test_against_bytewise },
+    { "crc-chunked", test_chunked },
+    { "crc-bit-flips", test_bit_flips },
+    { NULL, NULL },
+};
+
+static void bench_crc32(void) {
+    crc32(crc_data, CRC_BENCH_SIZE);
+}
+
+static void bench_crc32_bytewise(void) {
+    crc32_bytewise(crc_data, CRC_BENCH_SIZE);
+}
+
+static void bench_crc32c(void) {
+    crc32c(crc_data, CRC_BENCH_SIZE);
+}
+
+static void bench_crc32c_bytewise(void) {
+    crc32c_bytewise(crc_data, CRC_BENCH_SIZE);
+}
+
+static void bench_crc16(void) {
+    crc16(crc_data, CRC_BENCH_SIZE);
+}
+
+const host_bench_t host_crc_benches[] = {
+    { "crc32-64k", bench_crc32, CRC_BENCH_SIZE },
+    { "crc32-64k-byte", bench_crc32_bytewise, CRC_BENCH_SIZE },
+    { "crc32c-64k", bench_crc32c, CRC_BENCH_SIZE },
+    { "crc32c-64k-byte", bench_crc32c_bytewise, CRC_BENCH_SIZE },
+    { "crc16-64k", bench_crc16, CRC_BENCH_SIZE },
+    { NULL, NULL, 0 },
+};
@@ -0,0 +1,143 @@
+#include "../include/kernel.h"
+#include <fs.h>
+#include <memory.h>
+#include <string.h>
+#include "host.h"
+
+#define FS_TEST_LARGE (FILE_LAZY_THRESHOLD * 2 + 123)
+#define FS_TEST_CLOSE_SIZE 1000
+
+// Writes extend the file, reads stop at its end and advance the position
+static void test_read_write(void) {
+    int32_t fd = file_open("notes.txt", 0644);
+    CHECK(fd > 0);
+
+    CHECK_EQUAL(file_write(fd, "hello ", 6), 6);
+    CHECK_EQUAL(file_write(fd, "world", 5), 5);
+
+    // file_open's descriptors have no seek, a fresh read starts at the end
+    char buffer[32];
+    CHECK_EQUAL(file_read(fd, buffer, sizeof(buffer)), 0);
+    CHECK_EQUAL(file_close(fd), ERR_NONE);
+    CHECK_EQUAL(file_close(fd), ERR_INVALID_ARGUMENT);
+    CHECK_EQUAL(file_read(fd, buffer, sizeof(buffer)), ERR_INVALID_ARGUMENT);
+
+    // Closing releases the data, more rounds leave the heap as it was
+    size_t total, used_before, used_after, free;
+    memory_stats(&total, &used_before, &free);
+    static char data[FS_TEST_CLOSE_SIZE];
+    for (uint32_t round = 0; round < 64; round++) {
+        fd = file_open("notes.txt", 0644);
+        CHECK_EQUAL(file_write(fd, data, sizeof(data)), sizeof(data));
+        CHECK_EQUAL(file_close(fd), ERR_NONE);
+    }
+    memory_stats(&total, &used_after, &free);
+    CHECK_EQUAL(used_after, used_before);
+}
+
+// Seeking within a created file, reads clamp to the size
+static void test_seek(void) {
+    file_t* file = file_create("seek.bin", FILE_TYPE_REGULAR);
+    CHECK(file != NULL);
+    if (file == NULL) return;
+
+    CHECK_EQUAL(file_write(file->fd, "0123456789", 10), 10);
+    CHECK(file_seek(file, 2, FILE_SEEK_SET));
+
+    char buffer[16];
+    CHECK_EQUAL(file_read(file->fd, buffer, 3), 3);
+    CHECK(memcmp(buffer, "234", 3) == 0);
+
+    CHECK(file_seek(file, -4, FILE_SEEK_END));
+    CHECK_EQUAL(file_read(file->fd, buffer, sizeof(buffer)), 4);
+    CHECK(memcmp(buffer, "6789", 4) == 0);
+
+    CHECK(!file_seek(file, 1, FILE_SEEK_END));
+    CHECK(!file_seek(file, -11, FILE_SEEK_END));
+    CHECK(file_seek(file, -10, FILE_SEEK_CUR));
+    CHECK_EQUAL(file->position, 0);
+
+    // Overwriting in the middle keeps the size
+    CHECK(file_seek(file, 5, FILE_SEEK_SET));
+    CHECK_EQUAL(file_write(file->fd, "ab", 2), 2);
+    CHECK_EQUAL(file->size, 10);
+    CHECK(file_seek(file, 0, FILE_SEEK_SET));
+    CHECK_EQUAL(file_read(file->fd, buffer, sizeof(buffer)), 10);
+    CHECK(memcmp(buffer, "01234ab789", 10) == 0);
+
+    CHECK(file_delete("seek.bin"));
+    CHECK(!file_delete("seek.bin"));
+}
+
+// Growing past FILE_LAZY_THRESHOLD moves the data to a reservation and
+// keeps what was written before
+static void test_large_file(void) {
+    file_t* file = file_create("large.bin", FILE_TYPE_REGULAR);
+    CHECK(file != NULL);
+    if (file == NULL) return;
+
+    uint8_t chunk[1000];
+    for (uint32_t written = 0; written < FS_TEST_LARGE; written += sizeof(chunk)) {
+        for (uint32_t i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)((written + i) * 7);
+        uint32_t size = FS_TEST_LARGE - written < sizeof(chunk) ? FS_TEST_LARGE - written : sizeof(chunk);
+        CHECK_EQUAL(file_write(file->fd, chunk, size), size);
+    }
+    CHECK_EQUAL(file->size, FS_TEST_LARGE);
+    CHECK(file->capacity >= FS_TEST_LARGE);
+
+    CHECK(file_seek(file, 0, FILE_SEEK_SET));
+    for (uint32_t read = 0; read < FS_TEST_LARGE; read += sizeof(chunk)) {
+        int32_t size = file_read(file->fd, chunk, sizeof(chunk));
+        CHECK(size > 0);
+        for (int32_t i = 0; i < size; i++) {
+            if (chunk[i] != (uint8_t)((read + i) * 7)) {
+                CHECK_EQUAL(chunk[i], (uint8_t)((read + i) * 7));
+                break;
+            }
+        }
+    }
+    CHECK(file_delete("large.bin"));
+}
+
+// Info reports what was set
+static void test_info(void) {
+    file_t* file = file_create("info.txt", FILE_TYPE_REGULAR);
+    CHECK(file != NULL);
+    if (file == NULL) return;
+
+    CHECK(file_set_permissions(file, 0600));
+    CHECK_EQUAL(file_write(file->fd, "x", 1), 1);
+
+    file_info_t info;
+    file_get_info(file, &info);
+    CHECK(strcmp(info.name, "info.txt") == 0);
+    CHECK_EQUAL(info.size, 1);
+    CHECK_EQUAL(info.permissions, 0600);
+    CHECK_EQUAL(info.type, FILE_TYPE_REGULAR);
+    CHECK(info.modification_time >= info.creation_time);
+    CHECK(file_delete("info.txt"));
+}
+
+static void test_directories(void) {
+    directory_t* root = directory_create("root", NULL);
+    CHECK(root != NULL);
+    if (root == NULL) return;
+    CHECK(directory_create("bin", root) != NULL);
+    CHECK(directory_create("etc", root) != NULL);
+
+    directory_entry_t entries[4];
+    int count = -1;
+    directory_list(root, entries, &count);
+    CHECK_EQUAL(count, 2);
+    CHECK(strcmp(entries[0].name, "etc") == 0);
+    CHECK(strcmp(entries[1].name, "bin") == 0);
+}
+
+const host_test_t host_fs_tests[] = {
+    { "fs-read-write", test_read_write },
+    { "fs-seek", test_seek },
+    { "fs-large-file", test_large_file },
+    { "fs-info", test_info },
+    { "fs-directories", test_directories },
+    { NULL, NULL },
+};
@@ -0,0 +1,78 @@
+#include "../include/kernel.h"
+#include <string.h>
+#include <utils.h>
+#include "host.h"
+
+#define HASH_TEST_SIZE 1024
+
+static uint8_t hash_data[HASH_TEST_SIZE];
+
+// Published FNV-1a 32 and MurmurHash3 x86_32 values
+static void test_known_answers(void) {
+    CHECK_EQUAL(hash_fnv1a("", 0), 0x811C9DC5);
+    CHECK_EQUAL(hash_fnv1a(NULL, 4), 0x811C9DC5);
+    CHECK_EQUAL(hash_fnv1a("a", 1), 0xE40C292C);
+    CHECK_EQUAL(hash_fnv1a("foobar", 6), 0xBF9CF968);
+    CHECK_EQUAL(hash_fnv1a_update(hash_fnv1a("foo", 3), "bar", 3), 0xBF9CF968);
+
+    CHECK_EQUAL(hash_murmur3("", 0), 0);
+    CHECK_EQUAL(hash_murmur3(NULL, 4), 0);
+    CHECK_EQUAL(hash_murmur3("abc", 3), 0xB3DD93FA);
+    CHECK_EQUAL(hash_murmur3("test", 4), 0xBA6BD213);
+    CHECK_EQUAL(hash_murmur3("Hello, world!", 13), 0xC0363E43);
+    CHECK_EQUAL(hash_murmur3("The quick brown fox jumps over the lazy dog", 43), 0x2E4FF723);
+
+    // Seeded, through the incremental interface
+    static const struct {
+        const char* text;
+        uint32_t seed;
+        uint32_t hash;
+    } seeded[] = {
+        { "", 1, 0x514E28B7 },
+        { "", 0xFFFFFFFF, 0x81F16F39 },
+        { "aaaa", 0x9747B28C, 0x5A97808A },
+        { "Hello, world!", 0x9747B28C, 0x24884CBA },
+    };
+    for (uint32_t i = 0; i < sizeof(seeded) / sizeof(seeded[0]); i++) {
+        murmur3_state_t state;
+        hash_murmur3_init(&state, seeded[i].seed);
+        hash_murmur3_update(&state, seeded[i].text, strlen(seeded[i].text));
+        CHECK_EQUAL(hash_murmur3_final(&state), seeded[i].hash);
+    }
+}
+
+// Any split into chunks, empty ones included, gives the one-shot result;
+// murmur3 has to carry partial blocks across chunk boundaries
+static void test_chunked(void) {
+    random_state_t random;
+    random_seed(&random, 41);
+    for (size_t i = 0; i < sizeof(hash_data); i++) hash_data[i] = (uint8_t)random_next(&random);
+
+    for (uint32_t round = 0; round < 500; round++) {
+        size_t size = random_next_bounded(&random, HASH_TEST_SIZE + 1);
+        uint32_t expected_fnv = hash_fnv1a(hash_data, size);
+        uint32_t expected_murmur = hash_murmur3(hash_data, size);
+
+        uint32_t fnv = hash_fnv1a(NULL, 0);
+        murmur3_state_t murmur;
+        hash_murmur3_init(&murmur, 0);
+        for (size_t done = 0; done < size;) {
+            size_t chunk = random_next_bounded(&random, round % 2 ? 7 : 90);
+            if (chunk > size - done) chunk = size - done;
+            fnv = hash_fnv1a_update(fnv, hash_data + done, chunk);
+            hash_murmur3_update(&murmur, hash_data + done, chunk);
+            done += chunk;
+        }
+        CHECK_EQUAL(fnv, expected_fnv);
+        CHECK_EQUAL(hash_murmur3_final(&murmur), expected_murmur);
+
+        // Finishing does not consume the state
+        CHECK_EQUAL(hash_murmur3_final(&murmur), expected_murmur);
+    }
+}
+
+const host_test_t host_hash_tests[] = {
+    { "hash-known-answers", test_known_answers },
+    { "hash-chunked", test_chunked },
+    { NULL, NULL },
+};
@@ -0,0 +1,94 @@
+#include "../include/kernel.h"
+#include <hashmap.h>
+#include <utils.h>
+#include "host.h"
+
+#define HASHMAP_TEST_KEYS 192
+
+static hash_map_entry_t hashmap_entries[HASH_MAP_CAPACITY(HASHMAP_TEST_KEYS)];
+
+static void test_string_keys(void) {
+    hash_map_t map;
+    hash_map_init(&map, hashmap_entries, HASH_MAP_CAPACITY(HASHMAP_TEST_KEYS),
+                  hash_map_hash_string, hash_map_equals_string);
+
+    char key[] = "sched.quantum_ms";
+    CHECK(hash_map_put(&map, "sched.quantum_ms", (void*)1));
+    CHECK(hash_map_put(&map, "log.level", (void*)2));
+    CHECK(hash_map_get(&map, key) == (void*)1);
+    CHECK(hash_map_get(&map, "log.levels") == NULL);
+
+    // Replacing keeps the count
+    CHECK(hash_map_put(&map, key, (void*)3));
+    CHECK_EQUAL(map.count, 2);
+    CHECK(hash_map_get(&map, "sched.quantum_ms") == (void*)3);
+
+    CHECK(hash_map_remove(&map, "log.level") == (void*)2);
+    CHECK(hash_map_remove(&map, "log.level") == NULL);
+    CHECK_EQUAL(map.count, 1);
+}
+
+// Ids that all land in one cluster, then removals from its middle: the
+// backward shift must keep every remaining key reachable
+static void test_collisions(void) {
+    hash_map_t map;
+    hash_map_init(&map, hashmap_entries, 16, hash_map_hash_id, hash_map_equals_id);
+
+    uint32_t ids[12];
+    uint32_t count = 0;
+    for (uint32_t id = 1; count < 12; id++) {
+        if ((hash_map_hash_id(HASH_MAP_ID(id)) & 15) < 3) ids[count++] = id;
+    }
+    for (uint32_t i = 0; i < 12; i++) {
+        CHECK(hash_map_put(&map, HASH_MAP_ID(ids[i]), (void*)(uintptr_t)(i + 1)));
+    }
+
+    // At most three quarters full
+    CHECK(!hash_map_put(&map, HASH_MAP_ID(0xFFFFFFFF), (void*)1));
+
+    for (uint32_t i = 0; i < 12; i += 3) {
+        CHECK(hash_map_remove(&map, HASH_MAP_ID(ids[i])) == (void*)(uintptr_t)(i + 1));
+    }
+    for (uint32_t i = 0; i < 12; i++) {
+        void* expected = i % 3 == 0 ? NULL : (void*)(uintptr_t)(i + 1);
+        CHECK(hash_map_get(&map, HASH_MAP_ID(ids[i])) == expected);
+    }
+}
+
+// Random puts and removes against a plain array of what should be there
+static void test_random_ids(void) {
+    hash_map_t map;
+    hash_map_init(&map, hashmap_entries, HASH_MAP_CAPACITY(HASHMAP_TEST_KEYS),
+                  hash_map_hash_id, hash_map_equals_id);
+
+    static uint32_t values[HASHMAP_TEST_KEYS];
+    uint32_t present = 0;
+    random_state_t random;
+    random_seed(&random, 0x5EED);
+    for (uint32_t i = 0; i < HASHMAP_TEST_KEYS; i++) values[i] = 0;
+
+    for (uint32_t round = 0; round < 50000; round++) {
+        uint32_t id = random_next_bounded(&random, HASHMAP_TEST_KEYS);
+        if (values[id] != 0) {
+            CHECK(hash_map_remove(&map, HASH_MAP_ID(id)) == (void*)(uintptr_t)values[id]);
+            values[id] = 0;
+            present--;
+        } else {
+            values[id] = round + 1;
+            CHECK(hash_map_put(&map, HASH_MAP_ID(id), (void*)(uintptr_t)values[id]));
+            present++;
+        }
+    }
+
+    CHECK_EQUAL(map.count, present);
+    for (uint32_t id = 0; id < HASHMAP_TEST_KEYS; id++) {
+        CHECK(hash_map_get(&map, HASH_MAP_ID(id)) == (void*)(uintptr_t)values[id]);
+    }
+}
+
+const host_test_t host_hashmap_tests[] = {
+    { "hashmap-string-keys", test_string_keys },
+    { "hashmap-collisions", test_collisions },
+    { "hashmap-random-ids", test_random_ids },
+    { NULL, NULL },
+};
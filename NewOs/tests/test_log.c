@@ -0,0 +1,94 @@
+#include "../include/kernel.h"
+#include <string.h>
+#include <utils.h>
+#include "host.h"
+
+// A cursor past everything already in the ring
+static void log_cursor_at_end(log_cursor_t* cursor) {
+    log_record_t record;
+    log_cursor_init(cursor);
+    while (log_read(cursor, &record)) {
+    }
+    cursor->lost = 0;
+}
+
+// Records come back in order with their arguments, and format to the
+// level and message after the time prefix
+static void test_write_read(void) {
+    log_cursor_t cursor;
+    log_record_t record;
+    char line[160];
+    log_cursor_at_end(&cursor);
+
+    uint32_t before = time_ns_to_ms(time_get_current());
+    log_write(LOG_WARNING, "value %u and %s", 42, "text");
+    log_write(LOG_ERROR, "%04x", 0xAB);
+    uint32_t after = time_ns_to_ms(time_get_current());
+
+    CHECK(log_read(&cursor, &record));
+    CHECK_EQUAL(record.level, LOG_WARNING);
+    CHECK_EQUAL(record.arg_count, 2);
+    log_format(&record, line, sizeof(line));
+    const char* message = strstr(line, "] warning: value 42 and text");
+    CHECK(message != NULL && message[28] == '\0');
+
+    // Seconds and milliseconds since boot, or the sequence without a TSC
+    CHECK(line[0] == '[');
+    if (time_get_tsc_khz() != 0 && message != NULL) {
+        CHECK(message - line == 10 && line[6] == '.');
+        uint32_t ms = 0;
+        for (const char* p = line + 1; p < message; p++) {
+            if (*p >= '0' && *p <= '9') ms = ms * 10 + (*p - '0');
+        }
+        CHECK(ms >= before && ms <= after);
+    }
+
+    CHECK(log_read(&cursor, &record));
+    log_format(&record, line, sizeof(line));
+    CHECK(strstr(line, "] error: 00ab") != NULL);
+    CHECK(!log_read(&cursor, &record));
+    CHECK_EQUAL(cursor.lost, 0);
+}
+
+// Records below the level are dropped at the source
+static void test_level(void) {
+    log_cursor_t cursor;
+    log_record_t record;
+    log_cursor_at_end(&cursor);
+
+    log_write(LOG_DEBUG, "hidden");
+    CHECK(!log_read(&cursor, &record));
+    log_set_level(LOG_DEBUG);
+    log_write(LOG_DEBUG, "shown");
+    log_set_level(LOG_INFO);
+    CHECK(log_read(&cursor, &record));
+    CHECK(strcmp(record.format, "shown") == 0);
+}
+
+// A reader lapped by the writers skips to the oldest record left and
+// counts what it missed
+static void test_overrun(void) {
+    log_cursor_t cursor;
+    log_record_t record;
+    log_cursor_at_end(&cursor);
+
+    for (uint32_t i = 0; i < LOG_RING_SIZE + 10; i++) log_write(LOG_INFO, "record %u", i);
+
+    uint32_t expected = 10;
+    while (log_read(&cursor, &record)) {
+        if (record.args[0] != expected) {
+            CHECK_EQUAL(record.args[0], expected);
+            return;
+        }
+        expected++;
+    }
+    CHECK_EQUAL(expected, LOG_RING_SIZE + 10);
+    CHECK_EQUAL(cursor.lost, 10);
+}
+
+const host_test_t host_log_tests[] = {
+    { "log-write-read", test_write_read },
+    { "log-level", test_level },
+    { "log-overrun", test_overrun },
+    { NULL, NULL },
+};
@@ -0,0 +1,291 @@
+#include "../include/kernel.h"
+#include <bench.h>
+#include <memory.h>
+#include <string.h>
+#include <utils.h>
+#include "host.h"
+
+#define MEMORY_TEST_BLOCKS 64
+
+static size_t memory_free_bytes(void) {
+    size_t total, used, free;
+    memory_stats(&total, &used, &free);
+    return free;
+}
+
+// Every size class hands out distinct, 16-byte aligned objects that
+// hold their full size
+static void test_size_classes(void) {
+    static const size_t sizes[] = { 1, 15, 16, 17, 31, 64, 100, 255, 512, 1000, 1024 };
+    uint8_t* objects[sizeof(sizes) / sizeof(sizes[0])][4];
+
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (uint32_t j = 0; j < 4; j++) {
+            objects[i][j] = memory_alloc(sizes[i]);
+            CHECK(objects[i][j] != NULL);
+            CHECK_EQUAL((uintptr_t)objects[i][j] & 15, 0);
+            memset(objects[i][j], i * 4 + j, sizes[i]);
+        }
+    }
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (uint32_t j = 0; j < 4; j++) {
+            for (size_t k = 0; k < sizes[i]; k++) {
+                if (objects[i][j][k] != i * 4 + j) {
+                    CHECK_EQUAL(objects[i][j][k], i * 4 + j);
+                    break;
+                }
+            }
+            memory_free(objects[i][j]);
+        }
+    }
+}
+
+// A freed object is the next one handed out for its class
+static void test_size_class_reuse(void) {
+    void* first = memory_alloc(48);
+    memory_free(first);
+    void* second = memory_alloc(40);
+    CHECK(first == second);
+    memory_free(second);
+
+    CHECK(memory_alloc(0) == NULL);
+}
+
+// Large blocks are page-aligned headers plus payload and merge back
+// with their neighbours, whatever order they are freed in
+static void test_large_blocks(void) {
+    size_t before = memory_free_bytes();
+
+    uint8_t* blocks[3];
+    blocks[0] = memory_alloc(5000);
+    blocks[1] = memory_alloc(64 * 1024);
+    blocks[2] = memory_alloc(2000);
+    for (uint32_t i = 0; i < 3; i++) {
+        CHECK(blocks[i] != NULL);
+    }
+    memset(blocks[0], 0xA5, 5000);
+    memset(blocks[1], 0x5A, 64 * 1024);
+    CHECK_EQUAL(blocks[0][4999], 0xA5);
+    CHECK_EQUAL(blocks[1][0], 0x5A);
+    CHECK(memory_free_bytes() < before);
+
+    memory_free(blocks[1]);
+    memory_free(blocks[0]);
+    memory_free(blocks[2]);
+    CHECK_EQUAL(memory_free_bytes(), before);
+}
+
+// Exhausting the heap fails cleanly, and freeing everything gives all
+// of it back
+static void test_exhaustion(void) {
+    size_t before = memory_free_bytes();
+    void* blocks[MEMORY_TEST_BLOCKS];
+    uint32_t count = 0;
+    while (count < MEMORY_TEST_BLOCKS) {
+        void* block = memory_alloc(256 * 1024);
+        if (block == NULL) break;
+        blocks[count++] = block;
+    }
+    CHECK(count > 0 && count < MEMORY_TEST_BLOCKS);
+
+    // Free every other block first so the merges run in both directions
+    for (uint32_t i = 0; i < count; i += 2) memory_free(blocks[i]);
+    CHECK(count < 4 || memory_fragmentation() > 0);
+    for (uint32_t i = 1; i < count; i += 2) memory_free(blocks[i]);
+    CHECK_EQUAL(memory_free_bytes(), before);
+}
+
+// Pages come back page-aligned and only memory_free_page releases them
+static void test_pages(void) {
+    uint8_t* page = memory_alloc_page();
+    CHECK(page != NULL);
+    CHECK_EQUAL((uintptr_t)page & (PAGE_SIZE - 1), sizeof(memory_block_t));
+    memset(page, 0xFF, MEMORY_PAGE_USABLE);
+
+    memory_free(page);
+    CHECK_EQUAL(page[0], 0xFF);
+    memory_free_page(page);
+}
+
+// Random allocations and frees, every block keeps its contents
+static void test_random_churn(void) {
+    size_t before = memory_free_bytes();
+    uint8_t* blocks[MEMORY_TEST_BLOCKS] = { NULL };
+    size_t sizes[MEMORY_TEST_BLOCKS];
+    random_state_t random;
+    random_seed(&random, 22);
+
+    for (uint32_t round = 0; round < 20000; round++) {
+        uint32_t slot = random_next_bounded(&random, MEMORY_TEST_BLOCKS);
+        if (blocks[slot] != NULL) {
+            for (size_t k = 0; k < sizes[slot]; k += 7) {
+                if (blocks[slot][k] != (uint8_t)(slot + k)) {
+                    CHECK_EQUAL(blocks[slot][k], (uint8_t)(slot + k));
+                    return;
+                }
+            }
+            memory_free(blocks[slot]);
+            blocks[slot] = NULL;
+        } else {
+            sizes[slot] = 1 + random_next_bounded(&random, random_next(&random) & 1 ? 1024 : 16384);
+            blocks[slot] = memory_alloc(sizes[slot]);
+            CHECK(blocks[slot] != NULL);
+            if (blocks[slot] == NULL) return;
+            for (size_t k = 0; k < sizes[slot]; k += 7) {
+                blocks[slot][k] = (uint8_t)(slot + k);
+            }
+        }
+    }
+
+    for (uint32_t slot = 0; slot < MEMORY_TEST_BLOCKS; slot++) {
+        memory_free(blocks[slot]);
+    }
+
+    // Each of the seven size classes may hold on to one empty page
+    CHECK(memory_free_bytes() + 7 * (PAGE_SIZE + sizeof(memory_block_t)) >= before);
+    CHECK(memory_free_bytes() <= before);
+}
+
+const host_test_t host_memory_tests[] = {
+    { "memory-size-classes", test_size_classes },
+    { "memory-size-class-reuse", test_size_class_reuse },
+    { "memory-large-blocks", test_large_blocks },
+    { "memory-exhaustion", test_exhaustion },
+    { "memory-pages", test_pages },
+    { "memory-random-churn", test_random_churn },
+    { NULL, NULL },
+};
+
+static void bench_alloc_16(void) {
+    memory_free(memory_alloc(16));
+}
+
+static void bench_alloc_1k(void) {
+    memory_free(memory_alloc(1024));
+}
+
+static void bench_alloc_8k(void) {
+    memory_free(memory_alloc(8192));
+}
+
+static void bench_alloc_page(void) {
+    memory_free_page(memory_alloc_page());
+}
+
+const host_bench_t host_memory_benches[] = {
+    { "alloc-16", bench_alloc_16, 0 },
+    { "alloc-1k", bench_alloc_1k, 0 },
+    { "alloc-8k", bench_alloc_8k, 0 },
+    { "alloc-page", bench_alloc_page, 0 },
+    { NULL, NULL, 0 },
+};
+
+// The allocator memory_alloc replaced, kept as the reference for the
+// report: first fit over a single block list, every request rounded up
+// to whole pages, and a free that only merges with the next block
+#define MEMORY_REFERENCE_HEAP (1024 * 1024)
+
+typedef struct reference_block {
+    uintptr_t start;
+    size_t size;
+    bool is_free;
+    struct reference_block* next;
+} reference_block_t;
+
+static uint8_t reference_heap[MEMORY_REFERENCE_HEAP] __attribute__((aligned(16)));
+static reference_block_t* reference_start = (reference_block_t*)reference_heap;
+
+static void reference_init(void) {
+    reference_start->start = (uintptr_t)reference_start + sizeof(reference_block_t);
+    reference_start->size = MEMORY_REFERENCE_HEAP - sizeof(reference_block_t);
+    reference_start->is_free = true;
+    reference_start->next = NULL;
+}
+
+static void* reference_alloc(size_t size) {
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    for (reference_block_t* current = reference_start; current != NULL; current = current->next) {
+        if (!current->is_free || current->size < size) continue;
+        if (current->size > size + sizeof(reference_block_t) + PAGE_SIZE) {
+            reference_block_t* block = (reference_block_t*)(current->start + size);
+            block->start = (uintptr_t)block + sizeof(reference_block_t);
+            block->size = current->size - size - sizeof(reference_block_t);
+            block->is_free = true;
+            block->next = current->next;
+            current->next = block;
+            current->size = size;
+        }
+        current->is_free = false;
+        return (void*)current->start;
+    }
+    return NULL;
+}
+
+static void reference_free(void* ptr) {
+    for (reference_block_t* current = reference_start; current != NULL; current = current->next) {
+        if (current->start != (uintptr_t)ptr) continue;
+        current->is_free = true;
+        reference_block_t* next = current->next;
+        if (next != NULL && next->is_free) {
+            current->size += next->size + sizeof(reference_block_t);
+            current->next = next->next;
+        }
+        return;
+    }
+}
+
+// Heap bytes each object of a size takes, against the page a request
+// cost under the reference allocator, and alloc/free pairs per second
+// for both with MEMORY_REPORT_LIVE objects of the size already live
+#define MEMORY_REPORT_OBJECTS 1024
+#define MEMORY_REPORT_LIVE    64
+
+static size_t memory_report_size = 0;
+
+static void bench_alloc_size(void) {
+    memory_free(memory_alloc(memory_report_size));
+}
+
+static void bench_reference_alloc_size(void) {
+    reference_free(reference_alloc(memory_report_size));
+}
+
+static uint32_t report_alloc_rate(void* (*alloc)(size_t), void (*release)(void*), bench_fn_t fn) {
+    static void* live[MEMORY_REPORT_LIVE];
+    uint32_t count = 0;
+    while (count < MEMORY_REPORT_LIVE && (live[count] = alloc(memory_report_size)) != NULL) count++;
+
+    bench_result_t result;
+    uint32_t rate = bench_measure(fn, &result) ? host_rate(result.median) : 0;
+    while (count > 0) release(live[--count]);
+    return rate;
+}
+
+static void report_alloc_waste(void) {
+    static const size_t sizes[] = { 16, 24, 48, 100, 256, 500, 1024, 2000, 4000, 8192 };
+    static void* objects[MEMORY_REPORT_OBJECTS];
+
+    host_print("%8s %10s %10s %12s %10s %10s\n", "size", "per object", "waste", "paged waste",
+               "M/s", "paged M/s");
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t size = sizes[i];
+        size_t before = memory_free_bytes();
+        uint32_t count = 0;
+        while (count < MEMORY_REPORT_OBJECTS && (objects[count] = memory_alloc(size)) != NULL) count++;
+        size_t per_object = count != 0 ? (before - memory_free_bytes()) / count : 0;
+        while (count > 0) memory_free(objects[--count]);
+
+        size_t paged = ((size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) + sizeof(memory_block_t);
+        memory_report_size = size;
+        uint32_t rate = report_alloc_rate(memory_alloc, memory_free, bench_alloc_size);
+        reference_init();
+        uint32_t reference = report_alloc_rate(reference_alloc, reference_free, bench_reference_alloc_size);
+        host_print("%8zu %10zu %10zu %12zu %8u.%u %8u.%u\n", size, per_object, per_object - size,
+                   paged - size, rate / 10, rate % 10, reference / 10, reference % 10);
+    }
+}
+
+const host_test_t host_memory_reports[] = {
+    { "alloc-waste", report_alloc_waste },
+    { NULL, NULL },
+};
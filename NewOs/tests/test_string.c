@@ -0,0 +1,496 @@
+#include "../include/kernel.h"
+#include <bench.h>
+#include <string.h>
+#include <utils.h>
+#include "host.h"
+
+// Sizes around every strategy switch in string.c: bytes, words, rep and
+// SSE2 blocks
+static const size_t string_sizes[] = {
+    0, 1, 3, 4, 7, 15, 16, 17, 31, 63, 64, 127, 128, 129, 255,
+    1023, 1024, 1025, 1088, 4095, 4096, 4097 + 64,
+};
+
+#define STRING_SIZE_COUNT (sizeof(string_sizes) / sizeof(string_sizes[0]))
+#define STRING_BUFFER     (4096 + 64 + 1 + 64)
+
+static uint8_t string_source[STRING_BUFFER] __attribute__((aligned(64)));
+static uint8_t string_target[STRING_BUFFER] __attribute__((aligned(64)));
+static uint8_t string_expected[STRING_BUFFER] __attribute__((aligned(64)));
+
+static void string_fill(uint8_t* buffer, size_t size, uint32_t seed) {
+    random_state_t random;
+    random_seed(&random, seed);
+    for (size_t i = 0; i < size; i++) buffer[i] = (uint8_t)random_next(&random);
+}
+
+// Compare whole buffers so writes outside the range are caught as well
+static bool string_same(const uint8_t* a, const uint8_t* b) {
+    for (size_t i = 0; i < STRING_BUFFER; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+static void test_memcpy(void) {
+    for (uint32_t size = 0; size < STRING_SIZE_COUNT; size++) {
+        for (uint32_t dest = 0; dest < 16; dest++) {
+            for (uint32_t src = 0; src < 16; src += 3) {
+                size_t n = string_sizes[size];
+                string_fill(string_source, STRING_BUFFER, size);
+                string_fill(string_target, STRING_BUFFER, ~size);
+                for (size_t i = 0; i < STRING_BUFFER; i++) string_expected[i] = string_target[i];
+                for (size_t i = 0; i < n; i++) string_expected[dest + i] = string_source[src + i];
+
+                CHECK(memcpy(string_target + dest, string_source + src, n) == string_target + dest);
+                if (!string_same(string_target, string_expected)) {
+                    host_print("    memcpy size %zu, dest +%u, src +%u\n", n, dest, src);
+                    CHECK(false);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+// Overlapping moves in both directions within one buffer
+static void test_memmove(void) {
+    static const int32_t shifts[] = { -67, -16, -5, -1, 1, 3, 4, 17, 64 };
+    for (uint32_t size = 0; size < STRING_SIZE_COUNT; size++) {
+        for (uint32_t shift = 0; shift < sizeof(shifts) / sizeof(shifts[0]); shift++) {
+            size_t n = string_sizes[size];
+            if (n + 2 * 67 > STRING_BUFFER) continue;
+            size_t src = 67;
+            size_t dest = src + shifts[shift];
+
+            string_fill(string_target, STRING_BUFFER, size);
+            for (size_t i = 0; i < STRING_BUFFER; i++) string_expected[i] = string_target[i];
+            for (size_t i = 0; i < n; i++) string_source[i] = string_target[src + i];
+            for (size_t i = 0; i < n; i++) string_expected[dest + i] = string_source[i];
+
+            CHECK(memmove(string_target + dest, string_target + src, n) == string_target + dest);
+            if (!string_same(string_target, string_expected)) {
+                host_print("    memmove size %zu, shift %d\n", n, shifts[shift]);
+                CHECK(false);
+                return;
+            }
+        }
+    }
+}
+
+static void test_memset(void) {
+    for (uint32_t size = 0; size < STRING_SIZE_COUNT; size++) {
+        for (uint32_t dest = 0; dest < 16; dest++) {
+            size_t n = string_sizes[size];
+            string_fill(string_target, STRING_BUFFER, size);
+            for (size_t i = 0; i < STRING_BUFFER; i++) string_expected[i] = string_target[i];
+            for (size_t i = 0; i < n; i++) string_expected[dest + i] = 0xC3;
+
+            CHECK(memset(string_target + dest, 0x1C3, n) == string_target + dest);
+            if (!string_same(string_target, string_expected)) {
+                host_print("    memset size %zu, dest +%u\n", n, dest);
+                CHECK(false);
+                return;
+            }
+        }
+    }
+}
+
+// Only the sign of memcmp is specified, and bytes compare unsigned
+static void test_memcmp(void) {
+    string_fill(string_source, STRING_BUFFER, 1);
+    for (size_t i = 0; i < STRING_BUFFER; i++) string_target[i] = string_source[i];
+
+    for (uint32_t size = 0; size < STRING_SIZE_COUNT; size++) {
+        size_t n = string_sizes[size];
+        CHECK(memcmp(string_source + 1, string_target + 1, n) == 0);
+        if (n == 0) continue;
+
+        for (size_t at = 0; at < n; at += n / 7 + 1) {
+            uint8_t saved = string_target[1 + at];
+            string_target[1 + at] = saved ^ 0x80;
+            int expected = string_source[1 + at] < string_target[1 + at] ? -1 : 1;
+            int result = memcmp(string_source + 1, string_target + 1, n);
+            CHECK((result < 0 ? -1 : result > 0) == expected);
+            string_target[1 + at] = saved;
+        }
+    }
+}
+
+// The string functions against the host C library. Strings come from a
+// small alphabet so matches, shared prefixes and repeated delimiters are
+// common, and high bytes check that comparisons are unsigned.
+static const char string_alphabet[] = "abab,; \x80\xff";
+
+static void string_random(char* s, size_t length, random_state_t* random, uint32_t letters) {
+    for (size_t i = 0; i < length; i++) {
+        s[i] = string_alphabet[random_next_bounded(random, letters)];
+    }
+    s[length] = '\0';
+}
+
+static void test_strlen(void) {
+    random_state_t random;
+    random_seed(&random, 12);
+    char* s = (char*)string_source;
+    for (uint32_t round = 0; round < 4000; round++) {
+        size_t offset = random_next_bounded(&random, 16);
+        size_t length = random_next_bounded(&random, 600);
+        string_random(s + offset, length, &random, sizeof(string_alphabet) - 1);
+        CHECK_EQUAL(strlen(s + offset), host_ref_strlen(s + offset));
+    }
+
+    // Strings that end on the last byte before an unmapped page
+    char* page = host_guard_page();
+    for (size_t length = 0; length < 64; length++) {
+        char* start = page + HOST_PAGE_SIZE - 1 - length;
+        memset(start, 'x', length);
+        start[length] = '\0';
+        CHECK_EQUAL(strlen(start), length);
+    }
+}
+
+static int string_sign(int value) {
+    return value < 0 ? -1 : value > 0;
+}
+
+static void test_strcmp(void) {
+    random_state_t random;
+    random_seed(&random, 13);
+    char* a = (char*)string_source;
+    char* b = (char*)string_target;
+    for (uint32_t round = 0; round < 8000; round++) {
+        size_t offset_a = random_next_bounded(&random, 8);
+        size_t offset_b = random_next_bounded(&random, 8);
+        size_t length = random_next_bounded(&random, 300);
+        string_random(a + offset_a, length, &random, sizeof(string_alphabet) - 1);
+        memcpy(b + offset_b, a + offset_a, length + 1);
+
+        // Equal, a changed byte, or one string cut short
+        uint32_t kind = random_next_bounded(&random, 3);
+        if (length > 0 && kind == 1) {
+            size_t at = random_next_bounded(&random, length);
+            b[offset_b + at] = string_alphabet[random_next_bounded(&random, sizeof(string_alphabet) - 1)];
+        } else if (kind == 2) {
+            b[offset_b + random_next_bounded(&random, length + 1)] = '\0';
+        }
+
+        int result = strcmp(a + offset_a, b + offset_b);
+        int expected = host_ref_strcmp(a + offset_a, b + offset_b);
+        if (string_sign(result) != string_sign(expected)) {
+            host_print("    strcmp length %zu, offsets %zu %zu\n", length, offset_a, offset_b);
+            CHECK_EQUAL(string_sign(result), string_sign(expected));
+            return;
+        }
+    }
+
+    // Equal strings, the second one ending just before an unmapped page
+    char* page = host_guard_page();
+    for (size_t length = 0; length < 64; length++) {
+        char* end = page + HOST_PAGE_SIZE - 1 - length;
+        memset(end, 'y', length);
+        end[length] = '\0';
+        memset(a + (length & 3), 'y', length);
+        a[(length & 3) + length] = '\0';
+        CHECK_EQUAL(strcmp(a + (length & 3), end), 0);
+    }
+}
+
+static void test_strstr(void) {
+    random_state_t random;
+    random_seed(&random, 14);
+    char* haystack = (char*)string_source;
+    char* needle = (char*)string_target;
+    for (uint32_t round = 0; round < 20000; round++) {
+        size_t n = random_next_bounded(&random, 200);
+        size_t m = random_next_bounded(&random, 12);
+        uint32_t letters = 2 + random_next_bounded(&random, 3);
+        string_random(haystack, n, &random, letters);
+
+        // Half of the needles are cut from the haystack, so they match
+        if (m <= n && random_next(&random) & 1) {
+            memcpy(needle, haystack + random_next_bounded(&random, n - m + 1), m);
+            needle[m] = '\0';
+        } else {
+            string_random(needle, m, &random, letters);
+        }
+
+        char* result = strstr(haystack, needle);
+        char* expected = host_ref_strstr(haystack, needle);
+        if (result != expected) {
+            host_print("    strstr \"%s\" in \"%s\"\n", needle, haystack);
+            CHECK(result == expected);
+            return;
+        }
+    }
+
+    // Periodic needles that need the remembered prefix of Two-Way
+    static const char* const periodic[][2] = {
+        { "aaaaaaaaaab", "aaab" },
+        { "abababababac", "ababac" },
+        { "abaabaabaababaab", "abaababaab" },
+        { "aabaabaabaab", "aabaabaabaaa" },
+    };
+    for (uint32_t i = 0; i < sizeof(periodic) / sizeof(periodic[0]); i++) {
+        CHECK(strstr(periodic[i][0], periodic[i][1]) == host_ref_strstr(periodic[i][0], periodic[i][1]));
+    }
+}
+
+// Token boundaries of both implementations on copies of the same line
+static void test_strtok_r(void) {
+    static const char* const delimiters[] = { " ", ",; ", ";", "ab", "\x80" };
+    random_state_t random;
+    random_seed(&random, 15);
+    char* line = (char*)string_source;
+    char* copy = (char*)string_target;
+    for (uint32_t round = 0; round < 5000; round++) {
+        size_t length = random_next_bounded(&random, 80);
+        string_random(line, length, &random, sizeof(string_alphabet) - 1);
+        memcpy(copy, line, length + 1);
+        const char* delim = delimiters[random_next_bounded(&random, sizeof(delimiters) / sizeof(delimiters[0]))];
+
+        char* save = NULL;
+        char* save_copy = NULL;
+        char* token = strtok_r(line, delim, &save);
+        char* expected = host_ref_strtok_r(copy, delim, &save_copy);
+        while (token != NULL && expected != NULL) {
+            if (token - line != expected - copy || strcmp(token, expected) != 0) break;
+            token = strtok_r(NULL, delim, &save);
+            expected = host_ref_strtok_r(NULL, delim, &save_copy);
+        }
+        if (token != NULL || expected != NULL) {
+            host_print("    strtok_r round %u, delimiters \"%s\"\n", round, delim);
+            CHECK(false);
+            return;
+        }
+    }
+}
+
+// Command lines against the arguments the shell should see
+#define STRING_SPLIT_MAX 6
+
+static void test_split_args(void) {
+    static const struct {
+        const char* line;
+        int max_args;
+        int argc;
+        const char* args[STRING_SPLIT_MAX];
+    } cases[] = {
+        { "", STRING_SPLIT_MAX, 0, { NULL } },
+        { " \t ", STRING_SPLIT_MAX, 0, { NULL } },
+        { "  ls   -l\tdir  ", STRING_SPLIT_MAX, 3, { "ls", "-l", "dir" } },
+        { "echo \"a b\" 'c  d'", STRING_SPLIT_MAX, 3, { "echo", "a b", "c  d" } },
+        { "pre\"fix\"post 'x'\"y\"", STRING_SPLIT_MAX, 2, { "prefixpost", "xy" } },
+        { "a \"\" '' b", STRING_SPLIT_MAX, 4, { "a", "", "", "b" } },
+        { "a\\ b \\\"q\\\" \\\\", STRING_SPLIT_MAX, 3, { "a b", "\"q\"", "\\" } },
+        { "\"say \\\"hi\\\"\" 'no \\ escape'", STRING_SPLIT_MAX, 2, { "say \"hi\"", "no \\ escape" } },
+        { "\"it's\" 'say \"x\"'", STRING_SPLIT_MAX, 2, { "it's", "say \"x\"" } },
+        { "echo \"abc def", STRING_SPLIT_MAX, 2, { "echo", "abc def" } },
+        { "echo 'abc \"def", STRING_SPLIT_MAX, 2, { "echo", "abc \"def" } },
+        { "tail\\", STRING_SPLIT_MAX, 1, { "tail\\" } },
+        { "a b c d", 2, 2, { "a", "b" } },
+        { "a \"b c\" d", 0, 0, { NULL } },
+    };
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char line[64];
+        char* argv[STRING_SPLIT_MAX];
+        strcpy(line, cases[i].line);
+        int argc = string_split_args(line, argv, cases[i].max_args);
+        CHECK_EQUAL(argc, cases[i].argc);
+        for (int arg = 0; arg < argc && arg < cases[i].argc; arg++) {
+            if (strcmp(argv[arg], cases[i].args[arg]) != 0) {
+                host_print("    line %u argument %d: \"%s\", expected \"%s\"\n",
+                           i, arg, argv[arg], cases[i].args[arg]);
+                CHECK(false);
+            }
+        }
+    }
+}
+
+// Tokens point into the input; one fully quoted section comes back
+// without its quotes, anything else with quotes or escapes is flagged
+static void test_tokenizer(void) {
+    static const char input[] = "plain \"quoted\" mixed\"q\" es\\c ''";
+    string_tokenizer_t tokenizer;
+    string_token_t token;
+    string_tokenizer_init(&tokenizer, input);
+
+    CHECK(string_tokenizer_next(&tokenizer, &token));
+    CHECK(token.start == input && token.length == 5 && !token.needs_unescape);
+    CHECK(string_tokenizer_next(&tokenizer, &token));
+    CHECK(token.start == input + 7 && token.length == 6 && !token.needs_unescape);
+    CHECK(string_tokenizer_next(&tokenizer, &token));
+    CHECK(token.start == input + 15 && token.length == 8 && token.needs_unescape);
+
+    char unescaped[16];
+    CHECK_EQUAL(string_token_unescape(&token, unescaped), 6);
+    CHECK(memcmp(unescaped, "mixedq", 6) == 0);
+
+    CHECK(string_tokenizer_next(&tokenizer, &token));
+    CHECK(token.length == 4 && token.needs_unescape);
+    CHECK_EQUAL(string_token_unescape(&token, unescaped), 3);
+    CHECK(memcmp(unescaped, "esc", 3) == 0);
+
+    CHECK(string_tokenizer_next(&tokenizer, &token));
+    CHECK(token.start == input + 30 && token.length == 0 && !token.needs_unescape);
+    CHECK(!string_tokenizer_next(&tokenizer, &token));
+    CHECK(!string_tokenizer_next(&tokenizer, &token));
+}
+
+const host_test_t host_string_tests[] = {
+    { "string-memcpy", test_memcpy },
+    { "string-memmove", test_memmove },
+    { "string-memset", test_memset },
+    { "string-memcmp", test_memcmp },
+    { "string-strlen", test_strlen },
+    { "string-strcmp", test_strcmp },
+    { "string-strstr", test_strstr },
+    { "string-strtok-r", test_strtok_r },
+    { "string-tokenizer", test_tokenizer },
+    { "string-split-args", test_split_args },
+    { NULL, NULL },
+};
+
+// Kernel against C library on the same 1 KiB inputs; a strstr needle
+// from the end of a two-letter haystack, strtok_r over a copied line
+#define STRING_BENCH_SIZE 1024
+#define STRING_BENCH_LINE 256
+
+static char string_bench_text[STRING_BENCH_SIZE + 1];
+static char string_bench_same[STRING_BENCH_SIZE + 1];
+static char string_bench_needle[17];
+static char string_bench_line[STRING_BENCH_LINE + 1];
+static char string_bench_tokens[STRING_BENCH_LINE + 1];
+static bool string_bench_ready = false;
+
+static void string_bench_setup(void) {
+    if (string_bench_ready) return;
+    random_state_t random;
+    random_seed(&random, 16);
+    string_random(string_bench_text, STRING_BENCH_SIZE, &random, 2);
+    memcpy(string_bench_same, string_bench_text, STRING_BENCH_SIZE + 1);
+    memcpy(string_bench_needle, string_bench_text + STRING_BENCH_SIZE - 20, 16);
+    string_bench_needle[16] = '\0';
+    for (uint32_t i = 0; i < STRING_BENCH_LINE; i++) {
+        string_bench_line[i] = random_next_bounded(&random, 6) == 0 ? ' ' : 'a' + i % 26;
+    }
+    string_bench_ready = true;
+}
+
+static void bench_strlen_1k(void) {
+    string_bench_setup();
+    strlen(string_bench_text);
+}
+
+static void bench_strlen_1k_libc(void) {
+    string_bench_setup();
+    host_ref_strlen(string_bench_text);
+}
+
+static void bench_strcmp_1k(void) {
+    string_bench_setup();
+    strcmp(string_bench_text, string_bench_same);
+}
+
+static void bench_strcmp_1k_libc(void) {
+    string_bench_setup();
+    host_ref_strcmp(string_bench_text, string_bench_same);
+}
+
+static void bench_strstr_1k(void) {
+    string_bench_setup();
+    strstr(string_bench_text, string_bench_needle);
+}
+
+static void bench_strstr_1k_libc(void) {
+    string_bench_setup();
+    host_ref_strstr(string_bench_text, string_bench_needle);
+}
+
+static void bench_strtok_r(void) {
+    string_bench_setup();
+    memcpy(string_bench_tokens, string_bench_line, STRING_BENCH_LINE + 1);
+    char* save;
+    for (char* token = strtok_r(string_bench_tokens, " ", &save); token != NULL;
+         token = strtok_r(NULL, " ", &save)) {
+    }
+}
+
+static void bench_strtok_r_libc(void) {
+    string_bench_setup();
+    memcpy(string_bench_tokens, string_bench_line, STRING_BENCH_LINE + 1);
+    char* save;
+    for (char* token = host_ref_strtok_r(string_bench_tokens, " ", &save); token != NULL;
+         token = host_ref_strtok_r(NULL, " ", &save)) {
+    }
+}
+
+const host_bench_t host_string_benches[] = {
+    { "strlen-1k", bench_strlen_1k, STRING_BENCH_SIZE },
+    { "strlen-1k-libc", bench_strlen_1k_libc, STRING_BENCH_SIZE },
+    { "strcmp-1k", bench_strcmp_1k, STRING_BENCH_SIZE },
+    { "strcmp-1k-libc", bench_strcmp_1k_libc, STRING_BENCH_SIZE },
+    { "strstr-1k", bench_strstr_1k, STRING_BENCH_SIZE },
+    { "strstr-1k-libc", bench_strstr_1k_libc, STRING_BENCH_SIZE },
+    { "strtok-256", bench_strtok_r, STRING_BENCH_LINE },
+    { "strtok-256-libc", bench_strtok_r_libc, STRING_BENCH_LINE },
+    { NULL, NULL, 0 },
+};
+
+// memcpy bandwidth by size and by source and destination misalignment,
+// next to the C library and the byte loop string.c used to have
+#define STRING_REPORT_SIZE (256 * 1024)
+
+static uint8_t string_report_source[STRING_REPORT_SIZE + 64] __attribute__((aligned(64)));
+static uint8_t string_report_target[STRING_REPORT_SIZE + 64] __attribute__((aligned(64)));
+static uint8_t* string_report_dest = NULL;
+static const uint8_t* string_report_src = NULL;
+static size_t string_report_size = 0;
+
+static void bench_memcpy_kernel(void) {
+    memcpy(string_report_dest, string_report_src, string_report_size);
+}
+
+static void bench_memcpy_libc(void) {
+    host_ref_memcpy(string_report_dest, string_report_src, string_report_size);
+}
+
+static void bench_memcpy_byteloop(void) {
+    uint8_t* d = string_report_dest;
+    const uint8_t* s = string_report_src;
+    for (size_t i = 0; i < string_report_size; i++) d[i] = s[i];
+}
+
+static void string_report_row(void) {
+    static const bench_fn_t fns[] = { bench_memcpy_kernel, bench_memcpy_libc, bench_memcpy_byteloop };
+    uint32_t gbs[3];
+    for (uint32_t i = 0; i < 3; i++) {
+        bench_result_t result;
+        gbs[i] = bench_measure(fns[i], &result) ? host_bandwidth(string_report_size, result.median) : 0;
+    }
+    host_print(" %11u.%u %11u.%u %11u.%u\n", gbs[0] / 10, gbs[0] % 10, gbs[1] / 10, gbs[1] % 10,
+               gbs[2] / 10, gbs[2] % 10);
+}
+
+static void report_memcpy(void) {
+    static const size_t sizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536, STRING_REPORT_SIZE };
+    static const uint32_t offsets[][2] = { { 0, 0 }, { 0, 1 }, { 3, 0 }, { 4, 12 } };
+
+    host_print("%8s %4s %4s %13s %13s %13s\n", "size", "dest", "src",
+               "kernel GB/s", "libc GB/s", "byteloop GB/s");
+    for (uint32_t size = 0; size < sizeof(sizes) / sizeof(sizes[0]); size++) {
+        for (uint32_t offset = 0; offset < sizeof(offsets) / sizeof(offsets[0]); offset++) {
+            string_report_size = sizes[size];
+            string_report_dest = string_report_target + offsets[offset][0];
+            string_report_src = string_report_source + offsets[offset][1];
+            host_print("%8zu %4u %4u", string_report_size, offsets[offset][0], offsets[offset][1]);
+            string_report_row();
+        }
+    }
+}
+
+const host_test_t host_string_reports[] = {
+    { "memcpy-sizes", report_memcpy },
+    { NULL, NULL },
+};